@@ -321,4 +321,70 @@ gand_get_series(
 	return 0;
 }
 
+int
+gand_get_series_bulk(
+	gand_ctx_t g,
+	const char *const *syms, size_t nsyms,
+	int(*qcb)(gand_res_t, void *closure), void *closure)
+{
+	char buf[256U];
+	char *bdy;
+	size_t bdz = 0U;
+	int rc = 0;
+
+	/* set up our own context first */
+	if (LIKELY(qcb != NULL)) {
+		g->_cb = qcb;
+		g->cloptr = closure;
+	}
+
+	/* symbols go in the body, one per line */
+	for (size_t i = 0U; i < nsyms; i++) {
+		bdz += strlen(syms[i]) + 1U;
+	}
+	if (UNLIKELY((bdy = malloc(bdz + 1U)) == NULL)) {
+		return -1;
+	}
+	with (char *bp = bdy) {
+		for (size_t i = 0U; i < nsyms; i++) {
+			bp = stpcpy(bp, syms[i]);
+			*bp++ = '\n';
+		}
+		*bp = '\0';
+	}
+
+	/* reuse g's BUF to write the query string */
+	with (size_t z) {
+		if (UNLIKELY(!(z = xstrlncpy(
+				       buf, sizeof(buf), g->host, g->hlen)))) {
+			rc = -1;
+			goto out;
+		}
+		if (buf[z - 1U] != '/') {
+			buf[z++] = '/';
+		}
+		z += snprintf(
+			buf + z, sizeof(buf) - z,
+			"v0/series?select=sym,d,vf,v&igncase");
+	}
+
+	/* hand-over to libcurl */
+	curl_easy_setopt(g->curl_ctx, CURLOPT_URL, buf);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_POSTFIELDS, bdy);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_POSTFIELDSIZE, (long)bdz);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_WRITEFUNCTION, _data_cb);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_WRITEDATA, g);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_NOSIGNAL, 1);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_TIMEOUT, g->timeo);
+	curl_easy_setopt(g->curl_ctx, CURLOPT_ACCEPT_ENCODING, "");
+	if (curl_easy_perform(g->curl_ctx) != CURLE_OK) {
+		rc = -1;
+	}
+	/* back to GETs for gand_get_series() */
+	curl_easy_setopt(g->curl_ctx, CURLOPT_HTTPGET, 1L);
+out:
+	free(bdy);
+	return rc;
+}
+
 /* gandapi.c ends here */
@@ -39,4 +39,14 @@ gand_get_series(
 	const char *qry,
 	int(*)(gand_res_t, void *closure), void *closure);
 
+/**
+ * Query the gandalf server for the series of NSYMS symbols SYMS in
+ * one request, the callback sees them in the server's order.
+ * Symbols the server couldn't serve are skipped. */
+extern int
+gand_get_series_bulk(
+	gand_ctx_t,
+	const char *const *syms, size_t nsyms,
+	int(*)(gand_res_t, void *closure), void *closure);
+
 #endif	/* INCLUDED_gandapi_h_ */
@@ -9,21 +9,11 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
 #include "gand-dict.h"
 #include "nifty.h"
 #include "fops.h"
-
-typedef struct {
-	const char *s;
-	size_t z;
-} word_t;
-
-struct rln_s {
-	word_t sym;
-	word_t dat;
-	word_t vrb;
-	word_t val;
-};
+#include "gand-rln.h"
 
 static char *trolfdir = "/var/scratch/freundt/trolf";
 static size_t trolfdiz = sizeof("/var/scratch/freundt/trolf") - 1U/*\nul*/;
@@ -71,57 +61,6 @@ make_lateglu_name(dict_oid_t rolf_id)
 	return f;
 }
 
-static struct rln_s
-snarf_rln(const char *ln, size_t lz)
-{
-	struct rln_s r;
-	const char *p;
-
-	/* normally first up is the rolf-id, overread him */
-	if (UNLIKELY((p = memchr(ln, '\t', lz)) == NULL)) {
-		goto b0rk;
-	}
-
-	/* snarf sym */
-	r.sym.s = ++p;
-	/* find separator between symbol and trans-id */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
-	r.sym.z = p++ - r.sym.s;
-
-	/* find separator between trans-id and date stamp */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
-
-	/* snarf date */
-	r.dat.s = ++p;
-	/* find separator between date stamp and valflav aka verb */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
-	r.dat.z = p++ - r.dat.s;
-
-	/* snarf valflav aka verb */
-	r.vrb.s = p;
-	/* find separator between date stamp and valflav aka verb */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
-	r.vrb.z = p++ - r.vrb.s;
-
-	/* snarf value */
-	r.val.s = p;
-	r.val.z = ln + lz - p;
-
-	/* that's all */
-	return r;
-
-b0rk:
-	return (struct rln_s){NULL};
-}
-
 static void
 filtshow(const char *data, const size_t dlen)
 {
@@ -129,59 +68,118 @@ filtshow(const char *data, const size_t dlen)
 	size_t tot = 0U;
 
 	/* go through the buffer generate snarf lines */
+	for (size_t i = 0U; i < dlen;) {
+		struct rln_s lns[64U];
+		size_t eol[countof(lns)];
+		size_t nln;
+
+		/* snarf a bunch of lines, v0 format, zero copy */
+		nln = snarf_rlns(lns, eol, countof(lns), data + i, dlen - i);
+		/* and pick up after the last one next time */
+		i += eol[nln - 1U];
+
+		for (size_t j = 0U; j < nln; j++) {
+			const struct rln_s ln = lns[j];
+			char *restrict bp = buf + tot;
+
+			/* apply filters */
+			;
+
+			if (UNLIKELY(ln.sym.s == NULL)) {
+				continue;
+			} else if (UNLIKELY(tot +
+					    ln.sym.z + 1U/*\t*/ +
+					    ln.dat.z + 1U/*\t*/ +
+					    ln.vrb.z + 1U/*\t*/ +
+					    ln.val.z + 1U/*\n*/ >= sizeof(buf))) {
+				/* flush */
+				write(STDOUT_FILENO, buf, tot);
+				bp = buf + (tot = 0U);
+			}
+
+			/* show results */
+			memcpy(bp, ln.sym.s, ln.sym.z);
+			bp += ln.sym.z;
+			*bp++ = '\t';
+
+			memcpy(bp, ln.dat.s, ln.dat.z);
+			bp += ln.dat.z;
+			*bp++ = '\t';
+
+			memcpy(bp, ln.vrb.s, ln.vrb.z);
+			bp += ln.vrb.z;
+			*bp++ = '\t';
+
+			memcpy(bp, ln.val.s, ln.val.z);
+			bp += ln.val.z;
+			*bp++ = '\n';
+
+			tot += bp - (buf + tot);
+		}
+	}
+	/* flush again */
+	write(STDOUT_FILENO, buf, tot);
+	return;
+}
+static size_t
+bench_rln(const char *data, const size_t dlen)
+{
+/* split line by line, return the number of field bytes seen */
+	size_t ck = 0U;
+
 	for (size_t i = 0U; i < dlen; i++) {
 		const char *const bol = data + i;
-		const size_t max = dlen - i;
-		char *restrict bp = buf + tot;
 		const char *eol;
 		struct rln_s ln;
 
-		if (UNLIKELY((eol = memchr(bol, '\n', max)) == NULL)) {
-			eol = bol + max;
+		if (UNLIKELY((eol = memchr(bol, '\n', dlen - i)) == NULL)) {
+			eol = data + dlen;
 		}
-		/* snarf the line, v0 format, zero copy */
 		ln = snarf_rln(bol, eol - bol);
+		ck += ln.sym.z + ln.dat.z + ln.vrb.z + ln.val.z + 1U;
+		i += eol - bol;
+	}
+	return ck;
+}
 
-		/* apply filters */
-		;
-
-		if (UNLIKELY(ln.sym.s == NULL)) {
-			continue;
-		} else if (UNLIKELY(tot +
-				    ln.sym.z + 1U/*\t*/ +
-				    ln.dat.z + 1U/*\t*/ +
-				    ln.vrb.z + 1U/*\t*/ +
-				    ln.val.z + 1U/*\n*/ >= sizeof(buf))) {
-			/* flush */
-			write(STDOUT_FILENO, buf, tot);
-			bp = buf + (tot = 0U);
-		}
+static size_t
+bench_rlns(const char *data, const size_t dlen)
+{
+/* split in batches, return the number of field bytes seen */
+	size_t ck = 0U;
 
-		/* show results */
-		memcpy(bp, ln.sym.s, ln.sym.z);
-		bp += ln.sym.z;
-		*bp++ = '\t';
+	for (size_t i = 0U; i < dlen;) {
+		struct rln_s lns[64U];
+		size_t eol[countof(lns)];
+		size_t nln;
 
-		memcpy(bp, ln.dat.s, ln.dat.z);
-		bp += ln.dat.z;
-		*bp++ = '\t';
+		nln = snarf_rlns(lns, eol, countof(lns), data + i, dlen - i);
+		for (size_t j = 0U; j < nln; j++) {
+			const struct rln_s ln = lns[j];
 
-		memcpy(bp, ln.vrb.s, ln.vrb.z);
-		bp += ln.vrb.z;
-		*bp++ = '\t';
+			ck += ln.sym.z + ln.dat.z + ln.vrb.z + ln.val.z + 1U;
+		}
+		i += eol[nln - 1U];
+	}
+	return ck;
+}
 
-		memcpy(bp, ln.val.s, ln.val.z);
-		bp += ln.val.z;
-		*bp++ = '\n';
+static double
+tv_diff(struct timespec beg, struct timespec end)
+{
+	return (double)(end.tv_sec - beg.tv_sec) +
+		(double)(end.tv_nsec - beg.tv_nsec) / 1000000000;
+}
 
-		tot += bp - (buf + tot);
-		i += eol - bol;
-	}
-	/* flush again */
-	write(STDOUT_FILENO, buf, tot);
-	return;
+static int
+dblcmp(const void *x, const void *y)
+{
+	const double a = *(const double*)x;
+	const double b = *(const double*)y;
+	return (a > b) - (a < b);
 }
 
+
 
 #include "clidalf.yucc"
 
@@ -194,7 +192,11 @@ cmd_show(const struct yuck_cmd_show_s argi[static 1U])
 		const char *fn;
 		gandfn_t fb;
 
-		if (!(rid = dict_get_sym(gsymdb, sym))) {
+		if (UNLIKELY((rid = dict_get_sym(gsymdb, sym)) == ERR_OID)) {
+			errno = 0;
+			error("Error: cannot look up symbol: %s\n", sym);
+			continue;
+		} else if (!rid) {
 			errno = 0;
 			error("symbol not found: %s\n", sym);
 			continue;
@@ -217,6 +219,149 @@ Error: cannot access lateglu file: %s  (%08u)\n", sym, rid);
 	return 0;
 }
 
+static int
+cmd_bench(const struct yuck_cmd_bench_s argi[static 1U])
+{
+	unsigned long int nrep = 10U;
+	int rc = 0;
+
+	if (argi->repeat_arg && !(nrep = strtoul(argi->repeat_arg, NULL, 10))) {
+		errno = 0;
+		error("Error: invalid repeat count `%s'", argi->repeat_arg);
+		return 1;
+	}
+
+	for (size_t i = 0U; i < argi->nargs; i++) {
+		const char *fn = argi->args[i];
+		struct timespec t0, t1, t2;
+		size_t ck1 = 0U, ck2 = 0U;
+		double mb;
+		gandfn_t fb;
+
+		if (UNLIKELY((fb = mmap_fn(fn, O_RDONLY)).fd < 0)) {
+			error("Error: cannot access series file `%s'", fn);
+			rc = 1;
+			continue;
+		}
+
+		/* warm up the page cache */
+		(void)bench_rln(fb.fb.d, fb.fb.z);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (unsigned long int j = 0U; j < nrep; j++) {
+			ck1 += bench_rln(fb.fb.d, fb.fb.z);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		for (unsigned long int j = 0U; j < nrep; j++) {
+			ck2 += bench_rlns(fb.fb.d, fb.fb.z);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+
+		mb = (double)fb.fb.z * (double)nrep / 1048576;
+		printf("%s\t%zu bytes\tsnarf_rln %.1f MB/s\tsnarf_rlns %.1f MB/s\n",
+		       fn, fb.fb.z, mb / tv_diff(t0, t1), mb / tv_diff(t1, t2));
+		if (UNLIKELY(ck1 != ck2)) {
+			errno = 0;
+			error("Error: splits of `%s' differ", fn);
+			rc = 1;
+		}
+
+		munmap_fn(fb);
+	}
+	return rc;
+}
+
+static int
+cmd_lookup(const struct yuck_cmd_lookup_s argi[static 1U])
+{
+	const char *dictf = argi->database_arg ?: DICT_DEFAULT;
+	unsigned long int nrep = 10U;
+	char **syms = NULL;
+	size_t nsyms = 0U;
+	char *line = NULL;
+	double *lat = NULL;
+	size_t nlat = 0U;
+	size_t nfnd = 0U;
+	dict_t d;
+	int rc = 0;
+
+	if (argi->repeat_arg && !(nrep = strtoul(argi->repeat_arg, NULL, 10))) {
+		errno = 0;
+		error("Error: invalid repeat count `%s'", argi->repeat_arg);
+		return 1;
+	}
+
+	if (argi->nargs) {
+		syms = argi->args;
+		nsyms = argi->nargs;
+	} else {
+		/* get symlist from stdin */
+		size_t llen = 0UL;
+		size_t zsyms = 0U;
+
+		for (ssize_t nrd; (nrd = getline(&line, &llen, stdin)) > 0;) {
+			if (line[nrd - 1] == '\n') {
+				line[--nrd] = '\0';
+			}
+			if (!nrd) {
+				continue;
+			} else if (nsyms >= zsyms) {
+				zsyms = zsyms ? 2U * zsyms : 256U;
+				syms = realloc(syms, zsyms * sizeof(*syms));
+			}
+			syms[nsyms++] = strdup(line);
+		}
+	}
+	if (!nsyms) {
+		errno = 0;
+		error("Error: no symbols to look up");
+		rc = 1;
+		goto out;
+	} else if ((d = open_dict(dictf, O_RDONLY)) == NULL) {
+		error("Error: cannot open symbol index `%s'", dictf);
+		rc = 1;
+		goto out;
+	} else if ((lat = malloc(nsyms * nrep * sizeof(*lat))) == NULL) {
+		error("Error: cannot allocate latency table");
+		close_dict(d);
+		rc = 1;
+		goto out;
+	}
+
+	for (unsigned long int j = 0U; j < nrep; j++) {
+		for (size_t i = 0U; i < nsyms; i++) {
+			struct timespec t0, t1;
+			dict_oid_t rid;
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			rid = dict_get_sym(d, syms[i]);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+
+			lat[nlat++] = tv_diff(t0, t1) * 1000000;
+			nfnd += rid != NUL_OID && rid != ERR_OID;
+		}
+	}
+	close_dict(d);
+
+	qsort(lat, nlat, sizeof(*lat), dblcmp);
+	printf("\
+%zu lookups\t%zu found\tmin %.1f us\tmedian %.1f us\t\
+p99 %.1f us\tmax %.1f us\n",
+	       nlat, nfnd, lat[0U], lat[nlat / 2U],
+	       lat[nlat * 99U / 100U], lat[nlat - 1U]);
+
+out:
+	if (!argi->nargs) {
+		for (size_t i = 0U; i < nsyms; i++) {
+			free(syms[i]);
+		}
+		free(syms);
+	}
+	free(line);
+	free(lat);
+	return rc;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -229,13 +374,24 @@ main(int argc, char *argv[])
 		goto out0;
 	}
 
+	/* the benchmark needs no symbols */
+	if (argi->cmd == CLIDALF_CMD_BENCH) {
+		rc = cmd_bench((const void*)argi);
+		goto out0;
+	}
+	/* and this one brings its own */
+	if (argi->cmd == CLIDALF_CMD_LOOKUP) {
+		rc = cmd_lookup((const void*)argi);
+		goto out0;
+	}
+
 	/* get trolfdir or use default */
 	if (argi->trolfdir_arg) {
 		trolfdir = argi->trolfdir_arg;
 		trolfdiz = strlen(trolfdir);
 	}
 
-	if ((gsymdb = open_dict("gand_idx2sym.tcb", O_RDONLY)) == NULL) {
+	if ((gsymdb = open_dict(DICT_DEFAULT, O_RDONLY)) == NULL) {
 		error("cannot open symbol index file");
 		rc = 1;
 		goto out0;
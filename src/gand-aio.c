@@ -0,0 +1,455 @@
+/*** gand-aio.c -- read files into the page cache in the background
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Series files are mmap()ed and filtered on the event loop, after a
+ * rolf rebuild that means a page fault per page, each one waiting for
+ * the disk with the whole loop.  Instead we have cold slices read into the
+ * page cache first, here, and have the stream resume once that's done.
+ *
+ * The slices are read for real, chunk by chunk into a sink nobody looks
+ * at, advice alone would only queue readahead and leave the faults to
+ * the loop.  Reads go through an io_uring whose completions are reaped
+ * by a thread of its own, the reaper submits a request's next chunk as
+ * the previous one comes in.  Without io_uring, when the kernel doesn't
+ * know the read op, when the ring is full or when a read fails, what's
+ * left is read on the pool's threads instead. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#if HAVE_DECL_IORING_OP_READ
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+#endif	/* HAVE_DECL_IORING_OP_READ */
+#include "gand-aio.h"
+#include "logger.h"
+#include "nifty.h"
+
+/* reads are issued in chunks of this size */
+#define AIO_CHUNKZ	(1048576U)
+
+struct gand_aio_req_s {
+	int fd;
+	/* what's still to be read */
+	off_t off;
+	size_t len;
+	void(*cb)(void*);
+	void *clo;
+};
+
+static gand_pool_t aio_pool;
+static bool aio_up;
+/* where the data goes, nobody reads it, so it's shared */
+static char aio_sink[AIO_CHUNKZ];
+
+static size_t
+req_chunk(const struct gand_aio_req_s *r)
+{
+	return r->len < AIO_CHUNKZ ? r->len : AIO_CHUNKZ;
+}
+
+static void
+req_done(struct gand_aio_req_s *r)
+{
+	close(r->fd);
+	r->cb(r->clo);
+	free(r);
+	return;
+}
+
+static void
+pool_warm(void *clo)
+{
+/* read what's left of R, blocking, on a pool thread */
+	struct gand_aio_req_s *r = clo;
+
+	while (r->len) {
+		const ssize_t nrd = pread(r->fd, aio_sink, req_chunk(r), r->off);
+
+		if (nrd < 0 && errno == EINTR) {
+			continue;
+		} else if (nrd <= 0) {
+			/* end of file or failed, done either way */
+			break;
+		}
+		r->off += nrd;
+		r->len -= nrd;
+	}
+	req_done(r);
+	return;
+}
+
+#if HAVE_DECL_IORING_OP_READ
+#define AIO_NSQE	(64U)
+
+static struct {
+	int fd;
+	/* submission ring, guarded by MTX */
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int nsqe;
+	/* completion ring, the reaper's business */
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned int ncqe;
+	/* requests submitted but not reaped */
+	size_t nflt;
+	/* set when the kernel turned the read op down */
+	bool noread;
+	pthread_mutex_t mtx;
+	pthread_t thr;
+	/* the mappings */
+	void *sq;
+	size_t sqz;
+	void *cq;
+	size_t cqz;
+	size_t sqez;
+} ring = {.fd = -1, .mtx = PTHREAD_MUTEX_INITIALIZER};
+
+static int
+ring_enter(unsigned int nsub, unsigned int nwait)
+{
+	const unsigned int flags = nwait ? IORING_ENTER_GETEVENTS : 0U;
+
+	return syscall(__NR_io_uring_enter, ring.fd, nsub, nwait, flags, NULL, 0);
+}
+
+static int
+ring_push(uint8_t op, struct gand_aio_req_s *r)
+{
+/* submit one sqe, OP on R's next chunk, with RING.MTX held, return -1
+ * if it's not been submitted in which case it's been taken back off */
+	const unsigned int head = *(volatile unsigned int*)ring.sq_head;
+	const unsigned int tail = *ring.sq_tail;
+	const unsigned int i = tail & ring.sq_mask;
+	struct io_uring_sqe *e = ring.sqes + i;
+
+	if (UNLIKELY(tail - head >= ring.nsqe)) {
+		/* can't be, we never leave anything behind, still */
+		return -1;
+	}
+	memset(e, 0, sizeof(*e));
+	e->opcode = op;
+	if (r != NULL) {
+		e->fd = r->fd;
+		e->off = r->off;
+		e->addr = (uintptr_t)aio_sink;
+		e->len = (uint32_t)req_chunk(r);
+	}
+	e->user_data = (uintptr_t)r;
+	ring.sq_array[i] = i;
+	__sync_synchronize();
+	*ring.sq_tail = tail + 1U;
+
+	if (UNLIKELY(ring_enter(1U, 0U) < 1)) {
+		/* the kernel consumes sqes at enter time only, so it's
+		 * still ours, take it back lest it goes with the next one */
+		GAND_ERR_LOG("cannot submit to io_uring: %s", strerror(errno));
+		*ring.sq_tail = tail;
+		return -1;
+	}
+	ring.nflt++;
+	return 0;
+}
+
+static void
+ring_fall(struct gand_aio_req_s *r)
+{
+/* the ring gave up on R, hand it to the pool or, failing that, do it
+ * on the reaper, it's not the loop after all */
+	if (aio_pool == NULL || gand_pool_push(aio_pool, pool_warm, r) < 0) {
+		pool_warm(r);
+	}
+	return;
+}
+
+static void
+ring_next(struct gand_aio_req_s *r)
+{
+/* R's last chunk is in, go for the next one */
+	int rc;
+
+	pthread_mutex_lock(&ring.mtx);
+	rc = ring_push(IORING_OP_READ, r);
+	pthread_mutex_unlock(&ring.mtx);
+	if (UNLIKELY(rc < 0)) {
+		ring_fall(r);
+	}
+	return;
+}
+
+static void*
+ring_reap(void *UNUSED(clo))
+{
+	sigset_t ss[1U];
+	bool cue = false;
+	bool quit = false;
+
+	/* signals are the main thread's business */
+	sigfillset(ss);
+	pthread_sigmask(SIG_BLOCK, ss, NULL);
+
+	while (!quit) {
+		unsigned int head, tail;
+		size_t n = 0U;
+
+		if (ring_enter(0U, 1U) < 0 && errno != EINTR) {
+			GAND_ERR_LOG("cannot wait for io_uring: %s",
+				     strerror(errno));
+			break;
+		}
+		head = *ring.cq_head;
+		tail = *(volatile unsigned int*)ring.cq_tail;
+		__sync_synchronize();
+		for (; head != tail; head++) {
+			const struct io_uring_cqe *e =
+				ring.cqes + (head & ring.cq_mask);
+			struct gand_aio_req_s *r = (void*)(uintptr_t)e->user_data;
+
+			n++;
+			if (r == NULL) {
+				/* that's our cue */
+				cue = true;
+			} else if (LIKELY(e->res > 0)) {
+				r->off += e->res;
+				r->len -= e->res;
+				if (r->len) {
+					/* counts as in flight still */
+					ring_next(r);
+				} else {
+					req_done(r);
+				}
+			} else if (!e->res) {
+				/* file's shorter than we thought */
+				req_done(r);
+			} else {
+				if (e->res == -EINVAL && !ring.noread) {
+					GAND_NOTI_LOG("\
+io_uring cannot read, using the pool");
+					ring.noread = true;
+				}
+				ring_fall(r);
+			}
+		}
+		__sync_synchronize();
+		*ring.cq_head = head;
+
+		pthread_mutex_lock(&ring.mtx);
+		ring.nflt -= n;
+		/* completions needn't come in order, wait for stragglers */
+		quit = cue && !ring.nflt;
+		pthread_mutex_unlock(&ring.mtx);
+	}
+	return NULL;
+}
+
+static int
+ring_init(void)
+{
+	struct io_uring_params p = {0U};
+	int fd;
+
+	if ((fd = syscall(__NR_io_uring_setup, AIO_NSQE, &p)) < 0) {
+		/* old kernel or seccomp'd away */
+		return -1;
+	}
+	ring.fd = fd;
+	ring.sqz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring.cqz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring.sqez = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring.sq = mmap(NULL, ring.sqz, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring.sq == MAP_FAILED) {
+		goto fail;
+	}
+	ring.cq = mmap(NULL, ring.cqz, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	if (ring.cq == MAP_FAILED) {
+		goto fail;
+	}
+	ring.sqes = mmap(NULL, ring.sqez, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring.sqes == MAP_FAILED) {
+		goto fail;
+	}
+	ring.sq_head = (void*)((char*)ring.sq + p.sq_off.head);
+	ring.sq_tail = (void*)((char*)ring.sq + p.sq_off.tail);
+	ring.sq_mask = *(unsigned int*)((char*)ring.sq + p.sq_off.ring_mask);
+	ring.sq_array = (void*)((char*)ring.sq + p.sq_off.array);
+	ring.nsqe = p.sq_entries;
+	ring.cq_head = (void*)((char*)ring.cq + p.cq_off.head);
+	ring.cq_tail = (void*)((char*)ring.cq + p.cq_off.tail);
+	ring.cq_mask = *(unsigned int*)((char*)ring.cq + p.cq_off.ring_mask);
+	ring.cqes = (void*)((char*)ring.cq + p.cq_off.cqes);
+	ring.ncqe = p.cq_entries;
+
+	if (pthread_create(&ring.thr, NULL, ring_reap, NULL)) {
+		goto fail;
+	}
+	return 0;
+
+fail:
+	GAND_ERR_LOG("cannot set up io_uring: %s", strerror(errno));
+	if (ring.sqes != NULL && ring.sqes != MAP_FAILED) {
+		munmap(ring.sqes, ring.sqez);
+	}
+	if (ring.cq != NULL && ring.cq != MAP_FAILED) {
+		munmap(ring.cq, ring.cqz);
+	}
+	if (ring.sq != NULL && ring.sq != MAP_FAILED) {
+		munmap(ring.sq, ring.sqz);
+	}
+	close(fd);
+	ring.fd = -1;
+	return -1;
+}
+
+static void
+ring_fini(void)
+{
+	if (ring.fd < 0) {
+		return;
+	}
+	/* a nop without request is the reaper's cue to quit */
+	pthread_mutex_lock(&ring.mtx);
+	(void)ring_push(IORING_OP_NOP, NULL);
+	pthread_mutex_unlock(&ring.mtx);
+	pthread_join(ring.thr, NULL);
+
+	munmap(ring.sqes, ring.sqez);
+	munmap(ring.cq, ring.cqz);
+	munmap(ring.sq, ring.sqz);
+	close(ring.fd);
+	ring.fd = -1;
+	return;
+}
+
+static int
+ring_warm(struct gand_aio_req_s *r)
+{
+	int rc = -1;
+
+	if (ring.fd < 0 || ring.noread) {
+		return -1;
+	}
+	pthread_mutex_lock(&ring.mtx);
+	if (ring.nflt >= ring.ncqe) {
+		/* don't overflow the completion ring */
+		goto out;
+	}
+	rc = ring_push(IORING_OP_READ, r);
+out:
+	pthread_mutex_unlock(&ring.mtx);
+	return rc;
+}
+#endif	/* HAVE_DECL_IORING_OP_READ */
+
+
+int
+gand_aio_init(gand_pool_t pool)
+{
+	aio_pool = pool;
+#if HAVE_DECL_IORING_OP_READ
+	if (ring_init() == 0) {
+		aio_up = true;
+		return 0;
+	}
+#endif	/* HAVE_DECL_IORING_OP_READ */
+	if (aio_pool == NULL) {
+		return -1;
+	}
+	aio_up = true;
+	return 0;
+}
+
+void
+gand_aio_fini(void)
+{
+	aio_up = false;
+#if HAVE_DECL_IORING_OP_READ
+	ring_fini();
+#endif	/* HAVE_DECL_IORING_OP_READ */
+	/* what's been handed to the pool is collected with the pool */
+	aio_pool = NULL;
+	return;
+}
+
+int
+gand_aio_warm(int fd, off_t off, size_t len, void(*cb)(void*), void *clo)
+{
+	struct gand_aio_req_s *r;
+
+	if (!aio_up || !len) {
+		return -1;
+	} else if (UNLIKELY((r = malloc(sizeof(*r))) == NULL)) {
+		return -1;
+	} else if (UNLIKELY((r->fd = dup(fd)) < 0)) {
+		free(r);
+		return -1;
+	}
+	r->off = off;
+	r->len = len;
+	r->cb = cb;
+	r->clo = clo;
+#if HAVE_DECL_IORING_OP_READ
+	if (ring_warm(r) == 0) {
+		return 0;
+	}
+#endif	/* HAVE_DECL_IORING_OP_READ */
+	if (aio_pool != NULL && gand_pool_push(aio_pool, pool_warm, r) == 0) {
+		return 0;
+	}
+	close(r->fd);
+	free(r);
+	return -1;
+}
+
+/* gand-aio.c ends here */
@@ -0,0 +1,66 @@
+/*** gand-aio.h -- read files into the page cache in the background
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_aio_h_
+#define INCLUDED_gand_aio_h_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "gand-pool.h"
+
+/**
+ * Set up background reads, through io_uring if the kernel has it,
+ * or on the threads of POOL otherwise.
+ * POOL may be NULL.  Return -1 if neither can be used. */
+extern int gand_aio_init(gand_pool_t pool);
+
+/**
+ * Wait for the reads in flight and free resources, reads that failed
+ * on the ring go to the pool passed to gand_aio_init(), so that must
+ * be freed afterwards. */
+extern void gand_aio_fini(void);
+
+/**
+ * Have LEN bytes at OFF of FD read into the page cache in the background,
+ * FD is dup()ed so the caller may close it any time.
+ * CB is called with CLO from another thread once the reads are done,
+ * failed reads count as done.
+ * Return -1 if no reads were started, CB won't be called then. */
+extern int
+gand_aio_warm(
+	int fd, off_t off, size_t len, void(*cb)(void *clo), void *clo);
+
+#endif	/* INCLUDED_gand_aio_h_ */
@@ -0,0 +1,763 @@
+/*** gand-arrow.c -- arrow ipc stream encoding of series
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * The ipc stream is a sequence of messages, each one being
+ *   0xffffffff, int32 metadata size, metadata, body
+ * where the metadata is a flatbuffer'd Message table and the body
+ * holds the column buffers, 8-byte aligned each.
+ * Flatbuffers are built front to back here, children after their
+ * parents, so that offsets to them come out positive, vtables are put
+ * right before their tables.  No flatbuffers library needed. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "gand-arrow.h"
+#include "gand-enc.h"
+#include "nifty.h"
+
+/* metadata version V5 */
+#define ARW_VERSION	(4)
+/* message header types */
+#define ARW_SCHEMA	(1U)
+#define ARW_DICTBATCH	(2U)
+#define ARW_RECBATCH	(3U)
+/* type union members */
+#define ARW_FLOAT	(3U)
+#define ARW_UTF8	(5U)
+#define ARW_DATE	(8U)
+
+#define ARW_NFLD	(5U)
+#define ARW_NBUF	(11U)
+
+#define ALGN8(x)	(((x) + 7U) & ~(size_t)7U)
+
+struct fb_s {
+	uint8_t *b;
+	size_t n;
+	size_t z;
+	/* set once we ran out of memory, all writes are void then */
+	bool err;
+};
+
+/* table fields for fb_table() */
+struct fb_fld_s {
+	/* size of the scalar or 4 for offsets, 0 if the field is absent */
+	unsigned int z;
+	/* true if this is an offset to be patched via fb_ref() */
+	bool ref;
+	uint64_t v;
+	/* where the field ended up */
+	size_t at;
+};
+
+/* column buffers of a message body */
+struct arw_buf_s {
+	const void *p;
+	size_t z;
+};
+
+/* column length and null count */
+struct arw_node_s {
+	size_t n;
+	size_t nul;
+};
+
+struct arw_dict_s {
+	struct gand_enc_dict_s d;
+	/* number of entries that went out already */
+	size_t nsent;
+};
+
+struct gand_arrow_s {
+	/* current batch, ZROW is what's allocated */
+	size_t nrow;
+	size_t zrow;
+	int32_t *sym;
+	int32_t *dat;
+	int32_t *vf;
+	double *val;
+	/* validity bitmaps */
+	uint8_t *dok;
+	uint8_t *vok;
+	uint8_t *sok;
+	size_t dnul;
+	size_t vnul;
+	size_t snul;
+	/* non-numeric values */
+	int32_t *soff;
+	size_t nstr;
+	size_t zstr;
+	char *str;
+
+	struct arw_dict_s dict[2U];
+
+	/* custom metadata for the schema */
+	size_t nmeta;
+	char **meta;
+
+	bool schp;
+	struct fb_s out;
+};
+
+
+static int
+arw_grow_rows(gand_arrow_t a, size_t n)
+{
+/* make room for N rows in all columns, offsets have one more */
+	size_t nuz = a->zrow ? a->zrow : 256U;
+	void *p;
+
+	if (LIKELY(n < a->zrow)) {
+		return 0;
+	}
+	while (nuz <= n) {
+		nuz *= 2U;
+	}
+#define GROW(x, nx)						\
+	if ((p = realloc(a->x, (nx) * sizeof(*a->x))) == NULL) {	\
+		return -1;					\
+	}							\
+	a->x = p
+	GROW(sym, nuz);
+	GROW(dat, nuz);
+	GROW(vf, nuz);
+	GROW(val, nuz);
+	GROW(soff, nuz + 1U);
+	/* bitmaps go by bytes */
+	GROW(dok, nuz / 8U);
+	GROW(vok, nuz / 8U);
+	GROW(sok, nuz / 8U);
+#undef GROW
+	a->zrow = nuz;
+	return 0;
+}
+
+static inline void
+arw_bit(uint8_t *restrict b, size_t i, bool x)
+{
+	if (!(i % 8U)) {
+		b[i / 8U] = 0U;
+	}
+	b[i / 8U] |= (uint8_t)(x << (i % 8U));
+	return;
+}
+
+static bool
+arw_dat(int32_t *restrict r, word_t d)
+{
+/* YYYY-MM-DD to days since 1970-01-01, times and the like are ignored */
+	static const unsigned char dig[] = {0, 1, 2, 3, 5, 6, 8, 9};
+	unsigned int x[countof(dig)];
+	int y;
+	unsigned int m, dd, doy, doe;
+
+	if (d.z < 10U || d.s[4U] != '-' || d.s[7U] != '-') {
+		return false;
+	}
+	for (size_t i = 0U; i < countof(dig); i++) {
+		if (UNLIKELY((x[i] = d.s[dig[i]] - '0') > 9U)) {
+			return false;
+		}
+	}
+	y = x[0U] * 1000 + x[1U] * 100 + x[2U] * 10 + x[3U];
+	m = x[4U] * 10U + x[5U];
+	dd = x[6U] * 10U + x[7U];
+	if (UNLIKELY(m - 1U >= 12U || dd - 1U >= 31U)) {
+		return false;
+	}
+	/* shift the year to start in march, then count eras of 400y */
+	y -= m <= 2U;
+	doy = (153U * (m + (m > 2U ? -3 : 9)) + 2U) / 5U + dd - 1U;
+	doe = (y % 400) * 365U + (y % 400) / 4U - (y % 400) / 100U + doy;
+	*r = (int32_t)((y / 400) * 146097 + (int)doe - 719468);
+	return true;
+}
+
+
+/* flatbuffer goodness, all scalars little-endian */
+static int
+fb_room(struct fb_s *f, size_t z)
+{
+	void *p;
+
+	if (UNLIKELY((p = gand_enc_grow(f->b, &f->z, f->n + z, 1U)) == NULL)) {
+		f->err = true;
+		return -1;
+	}
+	f->b = p;
+	return 0;
+}
+
+static size_t
+fb_put(struct fb_s *f, const void *p, size_t z)
+{
+/* append Z bytes from P (or zeroes if NULL), return where they went */
+	const size_t at = f->n;
+
+	if (UNLIKELY(f->err) || UNLIKELY(fb_room(f, z) < 0)) {
+		return 0U;
+	} else if (p != NULL) {
+		memcpy(f->b + at, p, z);
+	} else {
+		memset(f->b + at, 0, z);
+	}
+	f->n += z;
+	return at;
+}
+
+static inline void
+fb_set(struct fb_s *f, size_t at, uint64_t v, unsigned int z)
+{
+	if (UNLIKELY(f->err)) {
+		return;
+	}
+	for (unsigned int i = 0U; i < z; i++, v >>= 8U) {
+		f->b[at + i] = (uint8_t)(v & 0xffU);
+	}
+	return;
+}
+
+static size_t
+fb_scal(struct fb_s *f, uint64_t v, unsigned int z)
+{
+	const size_t at = fb_put(f, NULL, z);
+
+	fb_set(f, at, v, z);
+	return at;
+}
+
+static void
+fb_pad(struct fb_s *f, size_t a, size_t off)
+{
+/* pad so that OFF bytes hence we're aligned to A */
+	while ((f->n + off) % a && !f->err) {
+		fb_put(f, NULL, 1U);
+	}
+	return;
+}
+
+static inline void
+fb_ref(struct fb_s *f, size_t at, size_t to)
+{
+/* let the offset at AT point to TO */
+	fb_set(f, at, to - at, 4U);
+	return;
+}
+
+static size_t
+fb_table(struct fb_s *f, struct fb_fld_s *fld, size_t nfld)
+{
+/* lay out a table with NFLD fields, biggest first, after its vtable */
+	uint16_t vo[8U] = {0U};
+	size_t o = 4U;
+	size_t vt, t;
+
+	for (unsigned int z = 8U; z; z /= 2U) {
+		for (size_t i = 0U; i < nfld; i++) {
+			if (fld[i].z == z) {
+				o = (o + z - 1U) & ~(size_t)(z - 1U);
+				vo[i] = (uint16_t)o;
+				o += z;
+			}
+		}
+	}
+	fb_pad(f, 2U, 0U);
+	vt = fb_scal(f, 4U + 2U * nfld, 2U);
+	fb_scal(f, o, 2U);
+	for (size_t i = 0U; i < nfld; i++) {
+		fb_scal(f, vo[i], 2U);
+	}
+	fb_pad(f, 8U, 0U);
+	t = fb_put(f, NULL, o);
+	fb_set(f, t, t - vt, 4U);
+	for (size_t i = 0U; i < nfld; i++) {
+		fld[i].at = t + vo[i];
+		if (fld[i].z) {
+			fb_set(f, fld[i].at, fld[i].v, fld[i].z);
+		}
+	}
+	return t;
+}
+
+static size_t
+fb_str(struct fb_s *f, const char *s)
+{
+	const size_t z = strlen(s);
+	size_t at;
+
+	fb_pad(f, 4U, 0U);
+	at = fb_scal(f, z, 4U);
+	fb_put(f, s, z + 1U);
+	return at;
+}
+
+static size_t
+fb_vec(struct fb_s *f, size_t n)
+{
+/* vector of N offsets or 16-byte structs, elements to be filled in */
+	size_t at;
+
+	fb_pad(f, 8U, 4U);
+	at = fb_scal(f, n, 4U);
+	fb_put(f, NULL, n * 16U);
+	/* offsets don't need the space */
+	return at;
+}
+
+
+/* messages */
+static size_t
+arw_msg(struct fb_s *f, unsigned int htyp, size_t bodyz, size_t *hdr)
+{
+/* start a message of type HTYP, the header table is to be hooked
+ * onto *HDR, return where the metadata size goes */
+	struct fb_fld_s fld[] = {
+		{.z = 2U, .v = ARW_VERSION},
+		{.z = 1U, .v = htyp},
+		{.z = 4U, .ref = true},
+		{.z = 8U, .v = bodyz},
+	};
+	size_t lz, root, msg;
+
+	fb_scal(f, 0xffffffffU, 4U);
+	lz = fb_scal(f, 0U, 4U);
+	root = fb_scal(f, 0U, 4U);
+	msg = fb_table(f, fld, countof(fld));
+	fb_ref(f, root, msg);
+	*hdr = fld[2U].at;
+	return lz;
+}
+
+static void
+arw_body(
+	struct fb_s *f, size_t lz,
+	const struct arw_buf_s *b, size_t nb)
+{
+/* finish the metadata started at LZ and append the body buffers */
+	fb_pad(f, 8U, 0U);
+	fb_set(f, lz, f->n - (lz + 4U), 4U);
+	for (size_t i = 0U; i < nb; i++) {
+		fb_put(f, b[i].p, b[i].z);
+		fb_pad(f, 8U, 0U);
+	}
+	return;
+}
+
+static size_t
+arw_bodyz(const struct arw_buf_s *b, size_t nb)
+{
+	size_t z = 0U;
+
+	for (size_t i = 0U; i < nb; i++) {
+		z += ALGN8(b[i].z);
+	}
+	return z;
+}
+
+static size_t
+arw_recbatch(
+	struct fb_s *f, size_t nrow,
+	const struct arw_node_s *n, size_t nn,
+	const struct arw_buf_s *b, size_t nb)
+{
+/* RecordBatch table, return where it went */
+	struct fb_fld_s fld[] = {
+		{.z = 8U, .v = nrow},
+		{.z = 4U, .ref = true},
+		{.z = 4U, .ref = true},
+	};
+	size_t t, v, o;
+
+	t = fb_table(f, fld, countof(fld));
+	v = fb_vec(f, nn);
+	fb_ref(f, fld[1U].at, v);
+	for (size_t i = 0U; i < nn; i++) {
+		fb_set(f, v + 4U + 16U * i, n[i].n, 8U);
+		fb_set(f, v + 4U + 16U * i + 8U, n[i].nul, 8U);
+	}
+	v = fb_vec(f, nb);
+	fb_ref(f, fld[2U].at, v);
+	o = 0U;
+	for (size_t i = 0U; i < nb; i++) {
+		fb_set(f, v + 4U + 16U * i, o, 8U);
+		fb_set(f, v + 4U + 16U * i + 8U, b[i].z, 8U);
+		o += ALGN8(b[i].z);
+	}
+	return t;
+}
+
+static void
+arw_schema(struct fb_s *f, char *const *meta, size_t nmeta)
+{
+	static const struct {
+		const char *name;
+		bool nullp;
+		unsigned int typ;
+		/* type table's only field, 0 for none */
+		unsigned int par;
+		/* dictionary id + 1, 0 for plain columns */
+		unsigned int dict;
+	} col[ARW_NFLD] = {
+		{"sym", false, ARW_UTF8, .dict = 1U},
+		/* unit DAY */
+		{"date", true, ARW_DATE, .par = 0U},
+		{"valflav", false, ARW_UTF8, .dict = 2U},
+		/* precision DOUBLE */
+		{"value", true, ARW_FLOAT, .par = 2U},
+		{"value_str", true, ARW_UTF8, .par = 0U},
+	};
+	struct fb_fld_s sch[] = {
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		{.z = 2U, .v = 1U},
+#else  /* !big endian */
+		{.z = 2U, .v = 0U},
+#endif	/* big endian */
+		{.z = 4U, .ref = true},
+		{.z = nmeta ? 4U : 0U, .ref = true},
+	};
+	size_t lz, hdr, t, v;
+
+	lz = arw_msg(f, ARW_SCHEMA, 0U, &hdr);
+	t = fb_table(f, sch, countof(sch));
+	fb_ref(f, hdr, t);
+	v = fb_vec(f, ARW_NFLD);
+	fb_ref(f, sch[1U].at, v);
+	for (size_t i = 0U; i < ARW_NFLD; i++) {
+		struct fb_fld_s fld[] = {
+			{.z = 4U, .ref = true},
+			{.z = 1U, .v = col[i].nullp},
+			{.z = 1U, .v = col[i].typ},
+			{.z = 4U, .ref = true},
+			{.z = col[i].dict ? 4U : 0U, .ref = true},
+			{.z = 4U, .ref = true},
+		};
+
+		t = fb_table(f, fld, countof(fld));
+		fb_ref(f, v + 4U + 4U * i, t);
+		fb_ref(f, fld[0U].at, fb_str(f, col[i].name));
+		with (struct fb_fld_s par[] = {{.z = 2U, .v = col[i].par}}) {
+			/* Date and FloatingPoint have their one field,
+			 * Utf8 is an empty table */
+			t = fb_table(f, par, col[i].typ != ARW_UTF8);
+			fb_ref(f, fld[3U].at, t);
+		}
+		if (col[i].dict) {
+			struct fb_fld_s enc[] = {
+				{.z = 8U, .v = col[i].dict - 1U},
+				{.z = 4U, .ref = true},
+			};
+			/* indices are int32 */
+			struct fb_fld_s ityp[] = {
+				{.z = 4U, .v = 32U},
+				{.z = 1U, .v = 1U},
+			};
+
+			t = fb_table(f, enc, countof(enc));
+			fb_ref(f, fld[4U].at, t);
+			t = fb_table(f, ityp, countof(ityp));
+			fb_ref(f, enc[1U].at, t);
+		}
+		/* no children */
+		fb_pad(f, 4U, 0U);
+		fb_ref(f, fld[5U].at, fb_scal(f, 0U, 4U));
+	}
+	if (nmeta) {
+		/* KeyValue tables */
+		v = fb_vec(f, nmeta);
+		fb_ref(f, sch[2U].at, v);
+	}
+	for (size_t i = 0U; i < nmeta; i++) {
+		struct fb_fld_s kv[] = {
+			{.z = 4U, .ref = true},
+			{.z = 4U, .ref = true},
+		};
+
+		t = fb_table(f, kv, countof(kv));
+		fb_ref(f, v + 4U + 4U * i, t);
+		fb_ref(f, kv[0U].at, fb_str(f, meta[2U * i + 0U]));
+		fb_ref(f, kv[1U].at, fb_str(f, meta[2U * i + 1U]));
+	}
+	arw_body(f, lz, NULL, 0U);
+	return;
+}
+
+static void
+arw_dictbatch(struct fb_s *f, struct arw_dict_s *x, size_t id)
+{
+/* entries not sent yet, as delta unless it's the first batch */
+	const struct gand_enc_dict_s *d = &x->d;
+	const size_t n = d->n - x->nsent;
+	const bool deltap = x->nsent > 0U;
+	const int32_t o0 = (int32_t)d->off[x->nsent];
+	struct fb_fld_s fld[] = {
+		{.z = 8U, .v = id},
+		{.z = 4U, .ref = true},
+		{.z = 1U, .v = deltap},
+	};
+	struct arw_node_s nod[] = {{n, 0U}};
+	struct arw_buf_s buf[] = {
+		{NULL, 0U},
+		{d->off + x->nsent, (n + 1U) * sizeof(*d->off)},
+		{d->str + o0, d->off[d->n] - o0},
+	};
+	size_t lz, hdr, t;
+
+	lz = arw_msg(f, ARW_DICTBATCH, arw_bodyz(buf, countof(buf)), &hdr);
+	t = fb_table(f, fld, countof(fld));
+	fb_ref(f, hdr, t);
+	t = arw_recbatch(f, n, nod, countof(nod), buf, countof(buf));
+	fb_ref(f, fld[1U].at, t);
+	arw_body(f, lz, buf, countof(buf));
+	if (o0 && !f->err) {
+		/* offsets of deltas start over at 0, they're right
+		 * at the beginning of the body */
+		int32_t *restrict off = (void*)(f->b + f->n -
+						 arw_bodyz(buf, countof(buf)));
+
+		for (size_t i = 0U; i <= n; i++) {
+			off[i] -= o0;
+		}
+	}
+	x->nsent = d->n;
+	return;
+}
+
+static void
+arw_batch(gand_arrow_t a)
+{
+	struct fb_s *f = &a->out;
+	const size_t n = a->nrow;
+	const size_t nb = (n + 7U) / 8U;
+	const struct arw_node_s nod[ARW_NFLD] = {
+		{n, 0U}, {n, a->dnul}, {n, 0U}, {n, a->vnul}, {n, a->snul},
+	};
+	/* validity bitmaps can be left out if there's no nulls */
+	const struct arw_buf_s buf[ARW_NBUF] = {
+		{NULL, 0U},
+		{a->sym, n * sizeof(*a->sym)},
+		{a->dok, a->dnul ? nb : 0U},
+		{a->dat, n * sizeof(*a->dat)},
+		{NULL, 0U},
+		{a->vf, n * sizeof(*a->vf)},
+		{a->vok, a->vnul ? nb : 0U},
+		{a->val, n * sizeof(*a->val)},
+		{a->sok, a->snul ? nb : 0U},
+		{a->soff, (n + 1U) * sizeof(*a->soff)},
+		{a->str, a->nstr},
+	};
+	size_t lz, hdr, t;
+
+	lz = arw_msg(f, ARW_RECBATCH, arw_bodyz(buf, countof(buf)), &hdr);
+	t = arw_recbatch(f, n, nod, countof(nod), buf, countof(buf));
+	fb_ref(f, hdr, t);
+	arw_body(f, lz, buf, countof(buf));
+	return;
+}
+
+
+/* public api */
+gand_arrow_t
+make_gand_arrow(void)
+{
+	gand_arrow_t a;
+
+	if (UNLIKELY((a = calloc(1U, sizeof(*a))) == NULL)) {
+		return NULL;
+	} else if (UNLIKELY(arw_grow_rows(a, 1U) < 0)) {
+		goto free;
+	}
+	/* the offset arrays always have their first element */
+	a->soff[0U] = 0;
+	for (size_t i = 0U; i < countof(a->dict); i++) {
+		if (UNLIKELY(gand_enc_dict_init(&a->dict[i].d) < 0)) {
+			goto free;
+		}
+	}
+	return a;
+
+free:
+	free_gand_arrow(a);
+	return NULL;
+}
+
+void
+free_gand_arrow(gand_arrow_t a)
+{
+	for (size_t i = 0U; i < countof(a->dict); i++) {
+		gand_enc_dict_fini(&a->dict[i].d);
+	}
+	free(a->sym);
+	free(a->dat);
+	free(a->vf);
+	free(a->val);
+	free(a->dok);
+	free(a->vok);
+	free(a->sok);
+	free(a->soff);
+	free(a->str);
+	for (size_t i = 0U; i < 2U * a->nmeta; i++) {
+		free(a->meta[i]);
+	}
+	free(a->meta);
+	free(a->out.b);
+	free(a);
+	return;
+}
+
+int
+gand_arrow_meta(gand_arrow_t a, const char *key, const char *val)
+{
+	char **nu;
+
+	if (UNLIKELY(a->schp)) {
+		return -1;
+	} else if (UNLIKELY((nu = realloc(
+				     a->meta,
+				     2U * (a->nmeta + 1U) * sizeof(*nu))) == NULL)) {
+		return -1;
+	}
+	a->meta = nu;
+	if (UNLIKELY((nu[2U * a->nmeta + 0U] = strdup(key)) == NULL)) {
+		return -1;
+	} else if (UNLIKELY((nu[2U * a->nmeta + 1U] = strdup(val)) == NULL)) {
+		free(nu[2U * a->nmeta + 0U]);
+		return -1;
+	}
+	a->nmeta++;
+	return 0;
+}
+
+int
+gand_arrow_add(gand_arrow_t a, struct rln_s r)
+{
+	const size_t i = a->nrow;
+	long int sym, vf;
+	bool ok;
+
+	if (UNLIKELY(arw_grow_rows(a, i + 1U) < 0)) {
+		return -1;
+	} else if (UNLIKELY((sym = gand_enc_dict_intern(
+				     &a->dict[0U].d, r.sym, INT32_MAX)) < 0)) {
+		return -1;
+	} else if (UNLIKELY((vf = gand_enc_dict_intern(
+				     &a->dict[1U].d, r.vrb, INT32_MAX)) < 0)) {
+		return -1;
+	}
+	a->sym[i] = (int32_t)sym;
+	a->vf[i] = (int32_t)vf;
+
+	if (!(ok = arw_dat(a->dat + i, r.dat))) {
+		a->dat[i] = 0;
+	}
+	arw_bit(a->dok, i, ok);
+	a->dnul += !ok;
+
+	if (!(ok = gand_enc_num(a->val + i, r.val))) {
+		/* keep it as string then */
+		void *p;
+
+		if (UNLIKELY(a->nstr + r.val.z > INT32_MAX)) {
+			return -1;
+		} else if (UNLIKELY((p = gand_enc_grow(
+					     a->str, &a->zstr,
+					     a->nstr + r.val.z, 1U)) == NULL)) {
+			return -1;
+		}
+		a->str = p;
+		memcpy(a->str + a->nstr, r.val.s, r.val.z);
+		a->nstr += r.val.z;
+		a->val[i] = 0;
+	}
+	arw_bit(a->vok, i, ok);
+	arw_bit(a->sok, i, !ok);
+	a->vnul += !ok;
+	a->snul += ok;
+	a->soff[i + 1U] = (int32_t)a->nstr;
+	a->nrow++;
+	return 0;
+}
+
+size_t
+gand_arrow_nrow(gand_arrow_t a)
+{
+	return a->nrow;
+}
+
+const void*
+gand_arrow_flush(gand_arrow_t a, size_t *z, int fin)
+{
+	struct fb_s *f = &a->out;
+
+	f->n = 0U;
+	f->err = false;
+	if (!a->schp) {
+		/* readers want all dictionaries before the first batch */
+		arw_schema(f, a->meta, a->nmeta);
+		arw_dictbatch(f, a->dict + 0U, 0U);
+		arw_dictbatch(f, a->dict + 1U, 1U);
+		a->schp = true;
+	} else {
+		for (size_t i = 0U; i < countof(a->dict); i++) {
+			if (a->dict[i].d.n > a->dict[i].nsent) {
+				arw_dictbatch(f, a->dict + i, i);
+			}
+		}
+	}
+	if (a->nrow) {
+		arw_batch(a);
+	}
+	if (fin) {
+		/* end-of-stream marker */
+		fb_scal(f, 0xffffffffU, 4U);
+		fb_scal(f, 0U, 4U);
+	}
+	/* start afresh */
+	a->nrow = 0U;
+	a->dnul = a->vnul = a->snul = 0U;
+	a->nstr = 0U;
+	if (UNLIKELY(f->err)) {
+		return NULL;
+	}
+	*z = f->n;
+	return f->b;
+}
+
+/* gand-arrow.c ends here */
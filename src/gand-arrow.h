@@ -0,0 +1,86 @@
+/*** gand-arrow.h -- arrow ipc stream encoding of series
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_arrow_h_
+#define INCLUDED_gand_arrow_h_
+
+#include <stddef.h>
+#include "gand-rln.h"
+
+/**
+ * Series are encoded as Apache Arrow IPC stream with the schema
+ *   sym: dictionary<int32, utf8>
+ *   date: date32 (days since 1970-01-01), null if unparseable
+ *   valflav: dictionary<int32, utf8>
+ *   value: float64, null if not numeric
+ *   value_str: utf8, the value if it's not numeric, null otherwise
+ * Rows are added to the current record batch which is then flushed,
+ * new dictionary entries go out as delta dictionary batches along. */
+typedef struct gand_arrow_s *gand_arrow_t;
+
+
+/**
+ * Obtain a new encoder. */
+extern gand_arrow_t make_gand_arrow(void);
+
+/**
+ * Free resources associated with the encoder. */
+extern void free_gand_arrow(gand_arrow_t);
+
+/**
+ * Attach custom metadata KEY with value VAL to the schema, this must
+ * happen before the first flush.
+ * Return -1 on failure. */
+extern int gand_arrow_meta(gand_arrow_t, const char *key, const char *val);
+
+/**
+ * Add the row in R to the current record batch.
+ * Return -1 if the row couldn't be added. */
+extern int gand_arrow_add(gand_arrow_t, struct rln_s r);
+
+/**
+ * Return the number of rows in the current record batch. */
+extern size_t gand_arrow_nrow(gand_arrow_t);
+
+/**
+ * Encode the current record batch, preceded by the schema upon the
+ * first flush and by dictionary batches as need be, and start a new
+ * batch.  If FIN is non-0 the end-of-stream marker is appended.
+ * Return a pointer to the encoded bytes and put their number into Z,
+ * the bytes are valid until the next call, NULL on failure. */
+extern const void *gand_arrow_flush(gand_arrow_t, size_t *z, int fin);
+
+#endif	/* INCLUDED_gand_arrow_h_ */
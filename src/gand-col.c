@@ -0,0 +1,311 @@
+/*** gand-col.c -- columnar series format
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Rows are collected into growing column arrays, valflavs are
+ * interned into a dictionary on the way, values that don't parse as
+ * numbers go to the overflow section.  Once the size has been asked
+ * for the layout is fixed and the series can be read out in pieces,
+ * without ever putting the sections together in one buffer. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "gand-col.h"
+#include "gand-enc.h"
+#include "nifty.h"
+
+/* header and sections, in order */
+#define COL_NSEC	(9U)
+
+struct gand_col_s {
+	struct gand_col_hdr_s h;
+
+	/* columns, ZROW is what's allocated */
+	size_t zrow;
+	double *val;
+	int32_t *dat;
+	uint16_t *vf;
+
+	/* valflav dictionary */
+	struct gand_enc_dict_s vfd;
+
+	/* non-numeric values */
+	size_t zovrow;
+	uint32_t *ovrow;
+	size_t zov;
+	uint32_t *ovoff;
+	size_t novstr;
+	size_t zovstr;
+	char *ovstr;
+
+	/* layout, once fixed */
+	bool fin;
+	struct {
+		size_t off;
+		const void *p;
+		size_t z;
+	} sec[COL_NSEC];
+};
+
+#define COL_MAXVF	(65535U)
+
+
+static int
+col_grow_rows(gand_col_t c, size_t n)
+{
+	size_t z;
+	void *p;
+
+	if (LIKELY(n <= c->zrow)) {
+		return 0;
+	}
+	z = c->zrow;
+	if ((p = gand_enc_grow(c->val, &z, n, sizeof(*c->val))) == NULL) {
+		return -1;
+	}
+	c->val = p;
+	z = c->zrow;
+	if ((p = gand_enc_grow(c->dat, &z, n, sizeof(*c->dat))) == NULL) {
+		return -1;
+	}
+	c->dat = p;
+	z = c->zrow;
+	if ((p = gand_enc_grow(c->vf, &z, n, sizeof(*c->vf))) == NULL) {
+		return -1;
+	}
+	c->vf = p;
+	c->zrow = z;
+	return 0;
+}
+
+static int
+col_str(
+	uint32_t **off, size_t *zoff, size_t n,
+	char **str, size_t *nstr, size_t *zstr, word_t w)
+{
+/* append W as N-th string to STR and note its end in OFF */
+	void *p;
+
+	if ((p = gand_enc_grow(*off, zoff, n + 2U, sizeof(**off))) == NULL) {
+		return -1;
+	}
+	*off = p;
+	if ((p = gand_enc_grow(*str, zstr, *nstr + w.z, 1U)) == NULL) {
+		return -1;
+	}
+	*str = p;
+	memcpy(*str + *nstr, w.s, w.z);
+	*nstr += w.z;
+	(*off)[n + 1U] = *nstr;
+	return 0;
+}
+
+static int32_t
+col_dat(word_t d)
+{
+/* YYYY-MM-DD to YYYYMMDD, times and the like are ignored */
+	static const unsigned char dig[] = {0, 1, 2, 3, 5, 6, 8, 9};
+	int32_t r = 0;
+
+	if (d.z < 10U || d.s[4U] != '-' || d.s[7U] != '-') {
+		return 0;
+	}
+	for (size_t i = 0U; i < countof(dig); i++) {
+		const unsigned int x = d.s[dig[i]] - '0';
+
+		if (UNLIKELY(x > 9U)) {
+			return 0;
+		}
+		r = r * 10 + x;
+	}
+	return r;
+}
+
+static void
+col_fin(gand_col_t c)
+{
+/* fix the layout */
+	const size_t nrow = c->h.nrow;
+	size_t o;
+
+#define ALGN8(x)	(((x) + 7U) & ~(size_t)7U)
+#define SEC(_i_, _slot_, _p_, _z_)					\
+	(c->sec[_i_].off = o, c->sec[_i_].p = (_p_), c->sec[_i_].z = (_z_), \
+	 _slot_ = o, o = ALGN8(o + (_z_)))
+	c->sec[0U].off = 0U;
+	c->sec[0U].p = &c->h;
+	c->sec[0U].z = sizeof(c->h);
+	o = ALGN8(sizeof(c->h));
+	SEC(1U, c->h.val, c->val, nrow * sizeof(*c->val));
+	SEC(2U, c->h.dat, c->dat, nrow * sizeof(*c->dat));
+	SEC(3U, c->h.vf, c->vf, nrow * sizeof(*c->vf));
+	SEC(4U, c->h.vfoff, c->vfd.off, (c->h.nvf + 1U) * sizeof(*c->vfd.off));
+	SEC(5U, c->h.vfstr, c->vfd.str, c->vfd.nstr);
+	SEC(6U, c->h.ovrow, c->ovrow, c->h.nov * sizeof(*c->ovrow));
+	SEC(7U, c->h.ovoff, c->ovoff, (c->h.nov + 1U) * sizeof(*c->ovoff));
+	SEC(8U, c->h.ovstr, c->ovstr, c->novstr);
+#undef SEC
+#undef ALGN8
+	c->h.size = o;
+	c->fin = true;
+	return;
+}
+
+
+/* public api */
+gand_col_t
+make_gand_col(void)
+{
+	gand_col_t c;
+
+	if (UNLIKELY((c = calloc(1U, sizeof(*c))) == NULL)) {
+		return NULL;
+	}
+	memcpy(c->h.magic, GAND_COL_MAGIC, sizeof(c->h.magic));
+	c->h.bom = GAND_COL_BOM;
+	/* the offset arrays always have their first element */
+	if (UNLIKELY(gand_enc_dict_init(&c->vfd) < 0)) {
+		goto free;
+	} else if (UNLIKELY((c->ovoff = gand_enc_grow(
+				       NULL, &c->zov, 1U,
+				       sizeof(*c->ovoff))) == NULL)) {
+		goto free;
+	}
+	c->ovoff[0U] = 0U;
+	return c;
+
+free:
+	free_gand_col(c);
+	return NULL;
+}
+
+void
+free_gand_col(gand_col_t c)
+{
+	free(c->val);
+	free(c->dat);
+	free(c->vf);
+	gand_enc_dict_fini(&c->vfd);
+	free(c->ovrow);
+	free(c->ovoff);
+	free(c->ovstr);
+	free(c);
+	return;
+}
+
+int
+gand_col_add(gand_col_t c, word_t dat, word_t vf, word_t val)
+{
+	const size_t i = c->h.nrow;
+	long int id;
+
+	if (UNLIKELY(c->fin)) {
+		return -1;
+	} else if (UNLIKELY(i >= UINT32_MAX)) {
+		return -1;
+	} else if (UNLIKELY(col_grow_rows(c, i + 1U) < 0)) {
+		return -1;
+	} else if (UNLIKELY((id = gand_enc_dict_intern(
+				     &c->vfd, vf, COL_MAXVF)) < 0)) {
+		return -1;
+	}
+	c->h.nvf = c->vfd.n;
+	c->dat[i] = col_dat(dat);
+	c->vf[i] = (uint16_t)id;
+	if (LIKELY(gand_enc_num(c->val + i, val))) {
+		goto out;
+	}
+	/* keep the string then */
+	c->val[i] = NAN;
+	with (void *p) {
+		if (UNLIKELY((p = gand_enc_grow(
+				      c->ovrow, &c->zovrow, c->h.nov + 1U,
+				      sizeof(*c->ovrow))) == NULL)) {
+			return -1;
+		}
+		c->ovrow = p;
+	}
+	if (UNLIKELY(col_str(
+			     &c->ovoff, &c->zov, c->h.nov,
+			     &c->ovstr, &c->novstr, &c->zovstr, val) < 0)) {
+		return -1;
+	}
+	c->ovrow[c->h.nov++] = i;
+out:
+	c->h.nrow++;
+	return 0;
+}
+
+size_t
+gand_col_size(gand_col_t c)
+{
+	if (!c->fin) {
+		col_fin(c);
+	}
+	return c->h.size;
+}
+
+size_t
+gand_col_read(gand_col_t c, void *restrict buf, size_t bsz, size_t off)
+{
+	const size_t z = gand_col_size(c);
+	const size_t eo = off + bsz < z ? off + bsz : z;
+	char *const bp = buf;
+
+	if (UNLIKELY(off >= z)) {
+		return 0U;
+	}
+	/* padding is zeroes */
+	memset(bp, 0, eo - off);
+	for (size_t i = 0U; i < COL_NSEC; i++) {
+		const size_t so = c->sec[i].off;
+		const size_t se = so + c->sec[i].z;
+		const size_t bo = so > off ? so : off;
+		const size_t be = se < eo ? se : eo;
+
+		if (bo < be) {
+			memcpy(bp + (bo - off),
+			       (const char*)c->sec[i].p + (bo - so), be - bo);
+		}
+	}
+	return eo - off;
+}
+
+/* gand-col.c ends here */
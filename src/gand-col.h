@@ -0,0 +1,106 @@
+/*** gand-col.h -- columnar series format
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_col_h_
+#define INCLUDED_gand_col_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gand-rln.h"
+
+/**
+ * A series in columnar format is a header followed by the sections
+ * it points to, all of them 8-byte aligned so they can be used in
+ * place once the whole thing is mmap()ed or read into memory.
+ * Numbers are in host byte order, BOM tells which one that is. */
+#define GAND_COL_MAGIC	"GCL1"
+#define GAND_COL_BOM	(0x01020304U)
+
+struct gand_col_hdr_s {
+	char magic[4U];
+	uint32_t bom;
+	/* number of rows, distinct valflavs and non-numeric values */
+	uint64_t nrow;
+	uint64_t nvf;
+	uint64_t nov;
+	/* offsets of the sections relative to the header */
+	/** double[nrow], values, NaN if not numeric */
+	uint64_t val;
+	/** int32_t[nrow], dates as YYYYMMDD, 0 if unparseable */
+	uint64_t dat;
+	/** uint16_t[nrow], valflav ids, indices into the dictionary */
+	uint64_t vf;
+	/** uint32_t[nvf + 1], valflav I is VFSTR[VFOFF[I]..VFOFF[I + 1]) */
+	uint64_t vfoff;
+	uint64_t vfstr;
+	/** uint32_t[nov], rows of the non-numeric values */
+	uint64_t ovrow;
+	/** uint32_t[nov + 1], value I is OVSTR[OVOFF[I]..OVOFF[I + 1]) */
+	uint64_t ovoff;
+	uint64_t ovstr;
+	/** size of it all, header included */
+	uint64_t size;
+};
+
+typedef struct gand_col_s *gand_col_t;
+
+
+/**
+ * Obtain an empty columnar series. */
+extern gand_col_t make_gand_col(void);
+
+/**
+ * Free resources associated with the columnar series. */
+extern void free_gand_col(gand_col_t);
+
+/**
+ * Append the row made up of date DAT, valflav VF and value VAL.
+ * Return -1 if the row cannot be added, e.g. if there's too many
+ * distinct valflavs. */
+extern int gand_col_add(gand_col_t, word_t dat, word_t vf, word_t val);
+
+/**
+ * Return the size of the series in columnar format.
+ * No rows can be added after this. */
+extern size_t gand_col_size(gand_col_t);
+
+/**
+ * Copy up to BSZ bytes of the series in columnar format, starting at
+ * offset OFF, to BUF and return the number of bytes copied. */
+extern size_t
+gand_col_read(gand_col_t, void *restrict buf, size_t bsz, size_t off);
+
+#endif	/* INCLUDED_gand_col_h_ */
@@ -0,0 +1,319 @@
+/*** gand-dict-cache.c -- lookup cache in front of the dict backends
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Entries come from one array allocated up front, they're hashed into
+ * chains and kept on a doubly-linked list in order of use, all under
+ * one mutex, much like the response cache.
+ * Symbols too long for an entry simply aren't cached.
+ * Flushing drops everything and bumps the tag, so that answers to
+ * lookups that were in flight at the time won't make it back in. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "gand-dict-cache.h"
+#include "nifty.h"
+
+#define DC_SYMZ		(48U)
+
+struct dc_ent_s {
+	/* bucket chain, or free list */
+	struct dc_ent_s *next;
+	/* lru list, most recent first */
+	struct dc_ent_s *lprev;
+	struct dc_ent_s *lnext;
+	uint64_t h;
+	/* expiry, in seconds on the monotonic clock */
+	time_t exp;
+	dict_oid_t oid;
+	size_t len;
+	char sym[DC_SYMZ];
+};
+
+static pthread_mutex_t dc_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct dc_ent_s *dc_ent;
+static struct dc_ent_s *dc_free;
+static struct dc_ent_s **dc_buck;
+static size_t dc_nbuck;
+static struct dc_ent_s *dc_head;
+static struct dc_ent_s *dc_tail;
+static unsigned int dc_ttl;
+static volatile unsigned int dc_tag;
+static dict_cache_stats_t dc_st;
+
+
+static uint64_t
+dc_hash(const char *sym, size_t len)
+{
+	return fnv1a(FNV1A_BASIS, sym, len);
+}
+
+static time_t
+dc_now(void)
+{
+	struct timespec tsp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return tsp.tv_sec;
+}
+
+static struct dc_ent_s**
+dc_find(uint64_t h, const char *sym, size_t len)
+{
+/* return the chain slot pointing to SYM's entry, or the end of the chain */
+	struct dc_ent_s **ep = dc_buck + (h & (dc_nbuck - 1U));
+
+	for (; *ep != NULL; ep = &(*ep)->next) {
+		const struct dc_ent_s *e = *ep;
+
+		if (e->h == h && e->len == len && !memcmp(e->sym, sym, len)) {
+			break;
+		}
+	}
+	return ep;
+}
+
+static void
+dc_lru_unlink(struct dc_ent_s *e)
+{
+	if (e->lprev != NULL) {
+		e->lprev->lnext = e->lnext;
+	} else {
+		dc_head = e->lnext;
+	}
+	if (e->lnext != NULL) {
+		e->lnext->lprev = e->lprev;
+	} else {
+		dc_tail = e->lprev;
+	}
+	return;
+}
+
+static void
+dc_lru_push(struct dc_ent_s *e)
+{
+	e->lprev = NULL;
+	if ((e->lnext = dc_head) != NULL) {
+		dc_head->lprev = e;
+	} else {
+		dc_tail = e;
+	}
+	dc_head = e;
+	return;
+}
+
+static void
+dc_drop(struct dc_ent_s **ep)
+{
+/* remove the entry at EP from its chain and the lru, and recycle it */
+	struct dc_ent_s *e = *ep;
+
+	*ep = e->next;
+	dc_lru_unlink(e);
+	e->next = dc_free;
+	dc_free = e;
+	dc_st.nent--;
+	return;
+}
+
+static void
+dc_drop_all(void)
+{
+	while (dc_tail != NULL) {
+		dc_drop(dc_find(dc_tail->h, dc_tail->sym, dc_tail->len));
+	}
+	return;
+}
+
+
+/* public api */
+int
+dict_cache_init(size_t nent, unsigned int ttl)
+{
+	if (!nent) {
+		/* off it is */
+		return 0;
+	}
+	for (dc_nbuck = 1U; dc_nbuck < nent; dc_nbuck <<= 1U);
+	dc_ent = calloc(nent, sizeof(*dc_ent));
+	dc_buck = calloc(dc_nbuck, sizeof(*dc_buck));
+	if (UNLIKELY(dc_ent == NULL || dc_buck == NULL)) {
+		free(dc_ent);
+		free(dc_buck);
+		dc_ent = NULL;
+		dc_buck = NULL;
+		return -1;
+	}
+	/* everything's free */
+	for (size_t i = 0U; i < nent; i++) {
+		dc_ent[i].next = dc_ent + i + 1U;
+	}
+	dc_ent[nent - 1U].next = NULL;
+	dc_free = dc_ent;
+	dc_ttl = ttl;
+	return 0;
+}
+
+void
+dict_cache_fini(void)
+{
+	pthread_mutex_lock(&dc_mtx);
+	dc_drop_all();
+	free(dc_ent);
+	free(dc_buck);
+	dc_ent = NULL;
+	dc_buck = NULL;
+	dc_free = NULL;
+	pthread_mutex_unlock(&dc_mtx);
+	return;
+}
+
+unsigned int
+dict_cache_tag(void)
+{
+	return dc_tag;
+}
+
+dict_oid_t
+dict_cache_get(const char *sym)
+{
+	const size_t len = strlen(sym);
+	dict_oid_t res = DICT_CACHE_NONE;
+	struct dc_ent_s **ep;
+	uint64_t h;
+	time_t now;
+
+	if (dc_ent == NULL || len >= DC_SYMZ) {
+		return DICT_CACHE_NONE;
+	}
+	h = dc_hash(sym, len);
+	now = dc_ttl ? dc_now() : 0;
+
+	pthread_mutex_lock(&dc_mtx);
+	if (*(ep = dc_find(h, sym, len)) == NULL) {
+		dc_st.misses++;
+	} else if (dc_ttl && (*ep)->exp <= now) {
+		/* too old */
+		dc_drop(ep);
+		dc_st.evictions++;
+		dc_st.misses++;
+	} else {
+		struct dc_ent_s *e = *ep;
+
+		/* most recently used now */
+		dc_lru_unlink(e);
+		dc_lru_push(e);
+		res = e->oid;
+		dc_st.hits++;
+	}
+	pthread_mutex_unlock(&dc_mtx);
+	return res;
+}
+
+void
+dict_cache_put(const char *sym, dict_oid_t oid, unsigned int tag)
+{
+	const size_t len = strlen(sym);
+	struct dc_ent_s **ep;
+	struct dc_ent_s *e;
+	uint64_t h;
+	time_t now;
+
+	if (dc_ent == NULL || len >= DC_SYMZ || oid == DICT_CACHE_NONE) {
+		return;
+	} else if (UNLIKELY(oid == ERR_OID)) {
+		/* an outage is no answer, have the next lookup ask again */
+		return;
+	}
+	h = dc_hash(sym, len);
+	now = dc_ttl ? dc_now() : 0;
+
+	pthread_mutex_lock(&dc_mtx);
+	if (tag != dc_tag) {
+		/* the dict's changed in the meantime */
+		goto out;
+	} else if (*(ep = dc_find(h, sym, len)) != NULL) {
+		/* someone beat us to it */
+		dc_drop(ep);
+	} else if (dc_free == NULL) {
+		/* make room */
+		dc_drop(dc_find(dc_tail->h, dc_tail->sym, dc_tail->len));
+		dc_st.evictions++;
+		ep = dc_find(h, sym, len);
+	}
+	e = dc_free;
+	dc_free = e->next;
+	e->h = h;
+	e->exp = now + dc_ttl;
+	e->oid = oid;
+	e->len = len;
+	memcpy(e->sym, sym, len);
+	e->next = *ep;
+	*ep = e;
+	dc_lru_push(e);
+	dc_st.nent++;
+out:
+	pthread_mutex_unlock(&dc_mtx);
+	return;
+}
+
+void
+dict_cache_flush(void)
+{
+	pthread_mutex_lock(&dc_mtx);
+	dc_tag++;
+	dc_drop_all();
+	pthread_mutex_unlock(&dc_mtx);
+	return;
+}
+
+dict_cache_stats_t
+dict_cache_stats(void)
+{
+	dict_cache_stats_t res;
+
+	pthread_mutex_lock(&dc_mtx);
+	res = dc_st;
+	pthread_mutex_unlock(&dc_mtx);
+	return res;
+}
+
+/* gand-dict-cache.c ends here */
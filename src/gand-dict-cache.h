@@ -0,0 +1,91 @@
+/*** gand-dict-cache.h -- lookup cache in front of the dict backends
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_dict_cache_h_
+#define INCLUDED_gand_dict_cache_h_
+
+#include <stddef.h>
+#include "gand-dict.h"
+
+typedef struct {
+	/** lookups answered by the cache, misses of the dict included */
+	size_t hits;
+	/** lookups that weren't */
+	size_t misses;
+	/** entries dropped to make room or because they expired */
+	size_t evictions;
+	/** number of entries */
+	size_t nent;
+} dict_cache_stats_t;
+
+/* what dict_cache_get() returns for symbols it knows nothing about */
+#define DICT_CACHE_NONE	((dict_oid_t)-2)
+
+
+/**
+ * Remember the outcome of up to NENT lookups, symbols not in the dict
+ * included, for TTL seconds each, or indefinitely if TTL is 0. */
+extern int dict_cache_init(size_t nent, unsigned int ttl);
+
+/**
+ * Drop all entries and turn the cache off. */
+extern void dict_cache_fini(void);
+
+/**
+ * Return the cache's current tag, to be obtained before asking the dict
+ * and to be passed to dict_cache_put() with the answer. */
+extern unsigned int dict_cache_tag(void);
+
+/**
+ * Return the oid cached for SYM, NUL_OID if SYM is known not to be in
+ * the dict, or DICT_CACHE_NONE if the dict has to be asked. */
+extern dict_oid_t dict_cache_get(const char *sym);
+
+/**
+ * Remember OID as the dict's answer for SYM.
+ * This is a no-op if the cache has been flushed since TAG was obtained,
+ * or if OID is ERR_OID, failed lookups are to be retried. */
+extern void dict_cache_put(const char *sym, dict_oid_t oid, unsigned int tag);
+
+/**
+ * Forget all entries, e.g. because the dict has changed. */
+extern void dict_cache_flush(void);
+
+/**
+ * Return the cache's counters. */
+extern dict_cache_stats_t dict_cache_stats(void);
+
+#endif	/* INCLUDED_gand_dict_cache_h_ */
@@ -0,0 +1,741 @@
+/*** gand-dict-mph.c -- dict reading from a mmapped minimal perfect hash
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * The index is written once, by gandaux build, and mapped read-only
+ * thereafter.  Its layout, integers in host byte order:
+ *
+ *   hdr        magic, number of symbols N, number of buckets B, seed,
+ *              next oid to hand out, size of the string table
+ *   disp[B]    displacement per bucket, or, with the top bit set, the
+ *              slot itself if the bucket holds just the one symbol
+ *   slot[N]    oid, offset and length of the symbol in the string table
+ *   str[]      the symbols, \nul-terminated
+ *
+ * A symbol hashes to a bucket and, with the bucket's displacement, to
+ * its slot, so a lookup is one hash and one memcmp().
+ * Writers keep the symbols in memory and close_dict() writes a fresh
+ * index to a temporary file and renames it over the old one, mappings
+ * of the old index stay valid that way. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#if !defined USE_MPH
+# error mph database backend not available
+#endif	/* !USE_MPH */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "gand-dict.h"
+#include "nifty.h"
+
+#define MPH_MAGIC	"GANDMPH\x01"
+/* single-symbol buckets refer to their slots directly */
+#define MPH_DIRECT	(0x80000000U)
+/* displacements to try per bucket before giving up on a seed */
+#define MPH_MAXD	(1U << 20U)
+/* seeds to try before giving up altogether */
+#define MPH_NSEED	(64U)
+#define MPH_FREE	(0xffffffffU)
+
+struct mph_hdr_s {
+	char magic[8U];
+	uint32_t nsym;
+	uint32_t nbkt;
+	uint32_t seed;
+	uint32_t next;
+	uint64_t strz;
+};
+
+struct mph_slot_s {
+	dict_oid_t oid;
+	uint32_t off;
+	uint32_t len;
+};
+
+struct mph_key_s {
+	uint32_t b;
+	uint32_t f;
+	uint32_t g;
+};
+
+struct dict_s {
+	/* the mapped index */
+	void *map;
+	size_t mapz;
+	const struct mph_hdr_s *hdr;
+	const uint32_t *disp;
+	const struct mph_slot_s *slot;
+	const char *str;
+
+	/* writers only, the file to write and the symbols so far */
+	char *fn;
+	mode_t mode;
+	dict_oid_t next;
+	struct mph_slot_s *ent;
+	size_t nent;
+	size_t zent;
+	char *sb;
+	size_t nsb;
+	size_t zsb;
+	/* open addressing over ENT, entries are indices + 1 */
+	uint32_t *ix;
+	size_t zix;
+};
+
+
+static inline uint64_t
+mph_mix(uint64_t h)
+{
+/* murmur3's finaliser */
+	h ^= h >> 33U;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33U;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33U;
+	return h;
+}
+
+static inline uint64_t
+mph_hash(const char *s, size_t z, uint32_t seed)
+{
+/* fnv-1a, mixed */
+	return mph_mix(fnv1a(FNV1A_BASIS ^ seed, s, z));
+}
+
+static inline struct mph_key_s
+mph_key(const char *s, size_t z, uint32_t seed, uint32_t nbkt, uint32_t n)
+{
+	const uint64_t h = mph_hash(s, z, seed);
+	const uint64_t k = mph_mix(h ^ 0x9e3779b97f4a7c15ULL);
+
+	return (struct mph_key_s){
+		.b = (uint32_t)(h >> 32U) % nbkt,
+		.f = (uint32_t)h % n,
+		/* keep the step non-0 so displacements actually move */
+		.g = n > 1U ? 1U + (uint32_t)k % (n - 1U) : 0U,
+	};
+}
+
+static inline uint32_t
+mph_slot(struct mph_key_s k, uint32_t d, uint32_t n)
+{
+	return (uint32_t)((k.f + (uint64_t)d * k.g) % n);
+}
+
+static inline bool
+mph_slot_ok_p(const struct mph_slot_s *s, size_t strz)
+{
+/* whether S's symbol and its \nul lie within the string table */
+	return s->off < strz && s->len < strz - s->off;
+}
+
+static int
+mph_map(struct dict_s *m, const char *fn)
+{
+	const struct mph_hdr_s *h;
+	struct stat st;
+	size_t z;
+	void *p;
+	int fd;
+
+	if ((fd = open(fn, O_RDONLY)) < 0) {
+		return -1;
+	} else if (fstat(fd, &st) < 0) {
+		goto clo;
+	} else if ((z = st.st_size) < sizeof(*h)) {
+		errno = EINVAL;
+		goto clo;
+	} else if ((p = mmap(NULL, z, PROT_READ, MAP_SHARED, fd, 0)) ==
+		   MAP_FAILED) {
+		goto clo;
+	}
+	/* the mapping is all we need */
+	close(fd);
+	/* lookups go all over the place */
+	(void)madvise(p, z, MADV_RANDOM);
+
+	h = p;
+	if (memcmp(h->magic, MPH_MAGIC, sizeof(h->magic)) ||
+	    (h->nsym && !h->nbkt) || h->nsym >= MPH_DIRECT ||
+	    z != sizeof(*h) +
+	    (size_t)h->nbkt * sizeof(*m->disp) +
+	    (size_t)h->nsym * sizeof(*m->slot) + h->strz) {
+		munmap(p, z);
+		errno = EINVAL;
+		return -1;
+	}
+	m->map = p;
+	m->mapz = z;
+	m->hdr = h;
+	m->disp = (const void*)(h + 1U);
+	m->slot = (const void*)(m->disp + h->nbkt);
+	m->str = (const void*)(m->slot + h->nsym);
+	return 0;
+
+clo:
+	close(fd);
+	return -1;
+}
+
+static void
+mph_unmap(struct dict_s *m)
+{
+	if (m->map != NULL) {
+		munmap(m->map, m->mapz);
+	}
+	m->map = NULL;
+	m->hdr = NULL;
+	return;
+}
+
+static dict_oid_t
+mph_get(const struct dict_s *m, const char *sym, size_t ssz)
+{
+	const uint32_t n = m->hdr->nsym;
+	const struct mph_slot_s *s;
+	struct mph_key_s k;
+	uint32_t x;
+
+	if (UNLIKELY(!n)) {
+		return NUL_OID;
+	}
+	k = mph_key(sym, ssz, m->hdr->seed, m->hdr->nbkt, n);
+	if ((x = m->disp[k.b]) & MPH_DIRECT) {
+		x &= ~MPH_DIRECT;
+	} else {
+		x = mph_slot(k, x, n);
+	}
+	if (UNLIKELY(x >= n)) {
+		return NUL_OID;
+	}
+	s = m->slot + x;
+	if (s->len != ssz) {
+		return NUL_OID;
+	} else if (UNLIKELY(!mph_slot_ok_p(s, m->hdr->strz))) {
+		return NUL_OID;
+	} else if (memcmp(m->str + s->off, sym, ssz)) {
+		return NUL_OID;
+	}
+	return s->oid;
+}
+
+
+/* writers */
+static size_t
+mem_find(const struct dict_s *m, const char *sym, size_t ssz)
+{
+/* return the index slot holding SYM, or the empty one it would go to */
+	const size_t msk = m->zix - 1U;
+	size_t i = mph_hash(sym, ssz, 0U) & msk;
+
+	for (uint32_t e; (e = m->ix[i]); i = (i + 1U) & msk) {
+		const struct mph_slot_s *s = m->ent + e - 1U;
+
+		if (s->len == ssz && !memcmp(m->sb + s->off, sym, ssz)) {
+			break;
+		}
+	}
+	return i;
+}
+
+static int
+mem_grow(struct dict_s *m)
+{
+	const size_t nuz = m->zix ? 2U * m->zix : 1024U;
+	uint32_t *nu;
+
+	if (UNLIKELY((nu = calloc(nuz, sizeof(*nu))) == NULL)) {
+		return -1;
+	}
+	free(m->ix);
+	m->ix = nu;
+	m->zix = nuz;
+	/* rehash */
+	for (size_t i = 0U; i < m->nent; i++) {
+		const struct mph_slot_s *s = m->ent + i;
+
+		m->ix[mem_find(m, m->sb + s->off, s->len)] = i + 1U;
+	}
+	return 0;
+}
+
+static dict_oid_t
+mem_get(const struct dict_s *m, const char *sym, size_t ssz)
+{
+	uint32_t e;
+
+	if (!m->zix || !(e = m->ix[mem_find(m, sym, ssz)])) {
+		return NUL_OID;
+	}
+	return m->ent[e - 1U].oid;
+}
+
+static dict_oid_t
+mem_put(struct dict_s *m, const char *sym, size_t ssz, dict_oid_t oid)
+{
+	size_t i;
+
+	if (2U * (m->nent + 1U) > m->zix && mem_grow(m) < 0) {
+		return NUL_OID;
+	} else if (m->ix[i = mem_find(m, sym, ssz)]) {
+		/* just reassign */
+		return m->ent[m->ix[i] - 1U].oid = oid;
+	} else if (UNLIKELY(m->nent + 1U >= MPH_DIRECT)) {
+		return NUL_OID;
+	} else if (UNLIKELY(m->nsb + ssz + 1U > UINT32_MAX)) {
+		return NUL_OID;
+	}
+
+	if (m->nent >= m->zent) {
+		const size_t nuz = m->zent ? 2U * m->zent : 1024U;
+		void *nu;
+
+		if (UNLIKELY((nu = realloc(m->ent, nuz * sizeof(*m->ent))) ==
+			     NULL)) {
+			return NUL_OID;
+		}
+		m->ent = nu;
+		m->zent = nuz;
+	}
+	if (m->nsb + ssz + 1U > m->zsb) {
+		size_t nuz = m->zsb ? 2U * m->zsb : 65536U;
+		void *nu;
+
+		while (m->nsb + ssz + 1U > nuz) {
+			nuz *= 2U;
+		}
+		if (UNLIKELY((nu = realloc(m->sb, nuz)) == NULL)) {
+			return NUL_OID;
+		}
+		m->sb = nu;
+		m->zsb = nuz;
+	}
+	memcpy(m->sb + m->nsb, sym, ssz);
+	m->sb[m->nsb + ssz] = '\0';
+	m->ent[m->nent] = (struct mph_slot_s){
+		.oid = oid,
+		.off = (uint32_t)m->nsb,
+		.len = (uint32_t)ssz,
+	};
+	m->nsb += ssz + 1U;
+	m->ix[i] = ++m->nent;
+	return oid;
+}
+
+static int
+mem_load(struct dict_s *m)
+{
+/* take over the symbols of the mapped index */
+	const struct mph_hdr_s *h = m->hdr;
+
+	for (uint32_t i = 0U; i < h->nsym; i++) {
+		const struct mph_slot_s *s = m->slot + i;
+
+		if (UNLIKELY(!mph_slot_ok_p(s, h->strz))) {
+			errno = EINVAL;
+			return -1;
+		} else if (!mem_put(m, m->str + s->off, s->len, s->oid)) {
+			return -1;
+		}
+	}
+	m->next = h->next;
+	return 0;
+}
+
+static int
+mph_build(uint32_t *restrict disp, uint32_t *restrict slot,
+	  const struct dict_s *m, uint32_t nbkt, uint32_t seed)
+{
+/* assign each entry of M a slot, -1 if SEED won't do */
+	const uint32_t n = m->nent;
+	const uint32_t maxd = n < MPH_MAXD ? n : MPH_MAXD;
+	struct mph_key_s *k;
+	/* entries by bucket, and the buckets' offsets therein */
+	uint32_t *be;
+	uint32_t *bo;
+	uint32_t maxz = 0U;
+	int rc = -1;
+
+	k = malloc(n * sizeof(*k));
+	be = malloc(n * sizeof(*be));
+	bo = calloc(nbkt + 1U, sizeof(*bo));
+	if (UNLIKELY(k == NULL || be == NULL || bo == NULL)) {
+		goto out;
+	}
+
+	for (uint32_t i = 0U; i < n; i++) {
+		const struct mph_slot_s *s = m->ent + i;
+
+		k[i] = mph_key(m->sb + s->off, s->len, seed, nbkt, n);
+		bo[k[i].b + 1U]++;
+	}
+	for (uint32_t b = 0U; b < nbkt; b++) {
+		if (bo[b + 1U] > maxz) {
+			maxz = bo[b + 1U];
+		}
+		bo[b + 1U] += bo[b];
+	}
+	/* distribute, BO[b] ends up as the offset of bucket b + 1 */
+	for (uint32_t i = 0U; i < n; i++) {
+		be[bo[k[i].b]++] = i;
+	}
+	memmove(bo + 1U, bo, nbkt * sizeof(*bo));
+	bo[0U] = 0U;
+
+	/* place the big buckets first, while there's room */
+	for (uint32_t z = maxz; z > 1U; z--) {
+		for (uint32_t b = 0U; b < nbkt; b++) {
+			const uint32_t *e = be + bo[b];
+			uint32_t d;
+
+			if (bo[b + 1U] - bo[b] != z) {
+				continue;
+			}
+			for (d = 0U; d < maxd; d++) {
+				uint32_t j;
+
+				for (j = 0U; j < z; j++) {
+					uint32_t x = mph_slot(k[e[j]], d, n);
+
+					if (slot[x] != MPH_FREE) {
+						break;
+					}
+					slot[x] = e[j];
+				}
+				if (j == z) {
+					break;
+				}
+				/* undo */
+				while (j-- > 0U) {
+					slot[mph_slot(k[e[j]], d, n)] = MPH_FREE;
+				}
+			}
+			if (d >= maxd) {
+				goto out;
+			}
+			disp[b] = d;
+		}
+	}
+	/* singletons fill the gaps */
+	for (uint32_t b = 0U, x = 0U; b < nbkt; b++) {
+		switch (bo[b + 1U] - bo[b]) {
+		case 0U:
+			disp[b] = 0U;
+			break;
+		case 1U:
+			while (slot[x] != MPH_FREE) {
+				x++;
+			}
+			slot[x] = be[bo[b]];
+			disp[b] = MPH_DIRECT | x;
+			break;
+		default:
+			break;
+		}
+	}
+	rc = 0;
+out:
+	free(k);
+	free(be);
+	free(bo);
+	return rc;
+}
+
+static int
+xwrite(int fd, const void *p, size_t z)
+{
+	for (ssize_t nwr; z > 0U; p = (const char*)p + nwr, z -= nwr) {
+		if ((nwr = write(fd, p, z)) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+mph_write(const struct dict_s *m)
+{
+	const uint32_t n = m->nent;
+	/* 2 symbols per bucket on average */
+	const uint32_t nbkt = n / 2U + 1U;
+	const size_t fnz = strlen(m->fn);
+	char tmpf[fnz + sizeof(".XXXXXX")];
+	struct mph_hdr_s hdr = {
+		.nsym = n,
+		.nbkt = nbkt,
+		.next = m->next,
+		.strz = m->nsb,
+	};
+	struct mph_slot_s *tbl;
+	uint32_t *disp;
+	uint32_t *slot;
+	int rc = -1;
+	int fd;
+
+	memcpy(hdr.magic, MPH_MAGIC, sizeof(hdr.magic));
+	disp = calloc(nbkt, sizeof(*disp));
+	slot = malloc((n + 1U) * sizeof(*slot));
+	tbl = malloc((n + 1U) * sizeof(*tbl));
+	if (UNLIKELY(disp == NULL || slot == NULL || tbl == NULL)) {
+		goto out;
+	}
+	for (; n && hdr.seed < MPH_NSEED; hdr.seed++) {
+		memset(slot, 0xff, n * sizeof(*slot));
+		if (!mph_build(disp, slot, m, nbkt, hdr.seed)) {
+			break;
+		}
+	}
+	if (UNLIKELY(hdr.seed >= MPH_NSEED)) {
+		errno = EDOM;
+		goto out;
+	}
+	for (uint32_t i = 0U; i < n; i++) {
+		tbl[i] = m->ent[slot[i]];
+	}
+
+	memcpy(tmpf, m->fn, fnz);
+	memcpy(tmpf + fnz, ".XXXXXX", sizeof(".XXXXXX"));
+	if ((fd = mkstemp(tmpf)) < 0) {
+		goto out;
+	} else if (xwrite(fd, &hdr, sizeof(hdr)) < 0 ||
+		   xwrite(fd, disp, nbkt * sizeof(*disp)) < 0 ||
+		   xwrite(fd, tbl, n * sizeof(*tbl)) < 0 ||
+		   xwrite(fd, m->sb, m->nsb) < 0 ||
+		   fchmod(fd, m->mode) < 0) {
+		close(fd);
+		goto unl;
+	} else if (close(fd) < 0) {
+		goto unl;
+	} else if (rename(tmpf, m->fn) < 0) {
+		goto unl;
+	}
+	rc = 0;
+out:
+	free(disp);
+	free(slot);
+	free(tbl);
+	return rc;
+unl:
+	(void)unlink(tmpf);
+	goto out;
+}
+
+
+dict_t
+open_dict(const char *fn, int oflags)
+{
+	struct dict_s *res;
+	struct stat st;
+
+	if (UNLIKELY((res = calloc(1U, sizeof(*res))) == NULL)) {
+		goto out;
+	} else if ((oflags & O_ACCMODE) == O_RDONLY) {
+		/* readers get just the mapping */
+		if (mph_map(res, fn) < 0) {
+			goto free_out;
+		}
+		return res;
+	}
+
+	/* writers */
+	if (UNLIKELY((res->fn = strdup(fn)) == NULL)) {
+		goto free_out;
+	} else if (UNLIKELY(mem_grow(res) < 0)) {
+		goto free_out;
+	}
+	if (stat(fn, &st) < 0) {
+		if (errno != ENOENT || !(oflags & O_CREAT)) {
+			goto free_out;
+		}
+		res->mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+		return res;
+	}
+	/* keep the rights of the file we're replacing */
+	res->mode = st.st_mode & 0777;
+	if (oflags & O_TRUNC || st.st_size == 0) {
+		/* nothing to take over, mkstemp()'d files are empty too */
+		return res;
+	} else if (mph_map(res, fn) < 0) {
+		goto free_out;
+	} else if (mem_load(res) < 0) {
+		mph_unmap(res);
+		goto free_out;
+	}
+	mph_unmap(res);
+	return res;
+
+free_out:
+	free(res->fn);
+	free(res->ix);
+	free(res->ent);
+	free(res->sb);
+	free(res);
+out:
+	return NULL;
+}
+
+void
+close_dict(dict_t d)
+{
+	struct dict_s *m = d;
+
+	if (m->fn != NULL) {
+		(void)mph_write(m);
+		free(m->fn);
+		free(m->ix);
+		free(m->ent);
+		free(m->sb);
+	}
+	mph_unmap(m);
+	free(m);
+	return;
+}
+
+dict_oid_t
+dict_get_sym(dict_t d, const char *sym)
+{
+	const struct dict_s *m = d;
+	const size_t ssz = strlen(sym);
+
+	if (m->fn != NULL) {
+		return mem_get(m, sym, ssz);
+	}
+	return mph_get(m, sym, ssz);
+}
+
+size_t
+dict_get_syms(
+	dict_t d, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n)
+{
+/* lookups are cheap enough as they are */
+	size_t nfnd = 0U;
+
+	for (size_t i = 0U; i < n; i++) {
+		nfnd += (oids[i] = dict_get_sym(d, syms[i])) != NUL_OID;
+	}
+	return nfnd;
+}
+
+dict_oid_t
+dict_put_sym(dict_t d, const char *sym, dict_oid_t sid)
+{
+	struct dict_s *m = d;
+
+	if (UNLIKELY(m->fn == NULL)) {
+		/* read-only */
+		return NUL_OID;
+	} else if (sid == NUL_OID && !(sid = dict_next_oid(d))) {
+		return NUL_OID;
+	}
+	return mem_put(m, sym, strlen(sym), sid);
+}
+
+dict_oid_t
+dict_next_oid(dict_t d)
+{
+	struct dict_s *m = d;
+
+	if (UNLIKELY(m->fn == NULL)) {
+		return NUL_OID;
+	}
+	return ++m->next;
+}
+
+dict_oid_t
+dict_set_next_oid(dict_t d, dict_oid_t oid)
+{
+	struct dict_s *m = d;
+
+	if (UNLIKELY(m->fn == NULL)) {
+		return NUL_OID;
+	}
+	return m->next = oid;
+}
+
+
+/* iterators */
+dict_si_t
+dict_sym_iter(dict_t d)
+{
+/* uses static state */
+	static size_t i;
+	const struct dict_s *m = d;
+	const struct mph_slot_s *s;
+	const char *str;
+	size_t strz;
+	size_t n;
+
+	if (m->fn != NULL) {
+		s = m->ent;
+		n = m->nent;
+		str = m->sb;
+		strz = m->nsb;
+	} else {
+		s = m->slot;
+		n = m->hdr->nsym;
+		str = m->str;
+		strz = m->hdr->strz;
+	}
+	for (; i < n; i++) {
+		if (LIKELY(mph_slot_ok_p(s + i, strz))) {
+			const size_t this = i++;
+			return (dict_si_t){s[this].oid, str + s[this].off};
+		}
+	}
+	i = 0U;
+	return (dict_si_t){};
+}
+
+dict_si_t
+dict_src_iter(dict_t d, const char *src)
+{
+/* uses static state */
+	(void)d;
+	(void)src;
+
+	return (dict_si_t){};
+}
+
+/* gand-dict-mph.c ends here */
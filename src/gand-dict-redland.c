@@ -56,6 +56,15 @@ static librdf_uri *uri_max;
 static librdf_uri *uri_ser;
 static librdf_uri *uri_src;
 
+/* batches bigger than 1/SYMS_SCAN of the model are resolved by
+ * scanning all rid statements once rather than by N lookups */
+#define SYMS_SCAN	(4U)
+
+struct sq_s {
+	const char *sym;
+	size_t i;
+};
+
 static int
 init_world(void)
 {
@@ -101,6 +110,14 @@ fini_world(void)
 	return 0;
 }
 
+static int
+sqcmp(const void *x, const void *y)
+{
+	const struct sq_s *a = x;
+	const struct sq_s *b = y;
+	return strcmp(a->sym, b->sym);
+}
+
 static inline librdf_node*
 dict_sym(const char *sym)
 {
@@ -175,6 +192,94 @@ dict_get_sym(dict_t d, const char *sym)
 	return rid;
 }
 
+size_t
+dict_get_syms(
+	dict_t d, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n)
+{
+/* one stream over all rid statements, matched against the sorted batch */
+	struct sq_s *sq;
+	librdf_statement *st;
+	librdf_stream *i;
+	const char *pre;
+	size_t prz;
+	size_t nfnd = 0U;
+	int msz;
+
+	if (UNLIKELY(!n)) {
+		return 0U;
+	} else if ((msz = librdf_model_size(d)) >= 0 &&
+		   n * SYMS_SCAN < (size_t)msz) {
+		/* the model's too big to be scanned for so few */
+		goto one_by_one;
+	} else if (UNLIKELY((sq = malloc(n * sizeof(*sq))) == NULL)) {
+		goto one_by_one;
+	}
+	with (librdf_node *p = librdf_new_node_from_uri(wrld, vrb_rid)) {
+		st = librdf_new_statement_from_nodes(wrld, NULL, p, NULL);
+		i = librdf_model_find_statements(d, st);
+		librdf_free_statement(st);
+	}
+	if (UNLIKELY(i == NULL)) {
+		free(sq);
+		goto one_by_one;
+	}
+	for (size_t j = 0U; j < n; j++) {
+		oids[j] = NUL_OID;
+		sq[j] = (struct sq_s){syms[j], j};
+	}
+	qsort(sq, n, sizeof(*sq), sqcmp);
+
+	pre = (const char*)librdf_uri_as_counted_string(uri_ser, &prz);
+	for (; !librdf_stream_end(i); (void)librdf_stream_next(i)) {
+		librdf_node *s, *o;
+		const unsigned char *val;
+		struct sq_s k;
+		struct sq_s *hit;
+
+		if (UNLIKELY((st = librdf_stream_get_object(i)) == NULL)) {
+			break;
+		}
+		s = librdf_statement_get_subject(st);
+		o = librdf_statement_get_object(st);
+		if (UNLIKELY(!librdf_node_is_resource(s))) {
+			continue;
+		} else if (UNLIKELY((val = librdf_node_get_literal_value(o))
+				    == NULL)) {
+			continue;
+		}
+		with (librdf_uri *u = librdf_node_get_uri(s)) {
+			k.sym = (const char*)librdf_uri_as_string(u);
+		}
+		if (UNLIKELY(strncmp(k.sym, pre, prz))) {
+			continue;
+		}
+		k.sym += prz;
+		if ((hit = bsearch(&k, sq, n, sizeof(*sq), sqcmp)) == NULL) {
+			continue;
+		}
+		/* duplicates in the batch are neighbours now */
+		while (hit > sq && !strcmp(hit[-1].sym, k.sym)) {
+			hit--;
+		}
+		for (; hit < sq + n && !strcmp(hit->sym, k.sym); hit++) {
+			if (oids[hit->i] == NUL_OID) {
+				oids[hit->i] = strtoul((const char*)val, NULL, 10);
+				nfnd += oids[hit->i] != NUL_OID;
+			}
+		}
+	}
+	librdf_free_stream(i);
+	free(sq);
+	return nfnd;
+
+one_by_one:
+	for (size_t j = 0U; j < n; j++) {
+		nfnd += (oids[j] = dict_get_sym(d, syms[j])) != NUL_OID;
+	}
+	return nfnd;
+}
+
 dict_oid_t
 dict_put_sym(dict_t d, const char *sym, dict_oid_t sid)
 {
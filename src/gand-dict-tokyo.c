@@ -50,6 +50,35 @@
 
 #define SID_SPACE	"\x1d"
 #define SYM_SPACE	"\x20"
+/* records to walk before jumping in dict_get_syms() */
+#define SYMS_WALK	(8U)
+
+struct sq_s {
+	const char *sym;
+	int len;
+	size_t i;
+};
+
+
+static int
+keycmp(const void *k1, int z1, const void *k2, int z2)
+{
+/* like tcbdb's default (lexical) comparison of keys */
+	int res;
+
+	if ((res = memcmp(k1, k2, z1 < z2 ? z1 : z2))) {
+		return res;
+	}
+	return z1 - z2;
+}
+
+static int
+sqcmp(const void *x, const void *y)
+{
+	const struct sq_s *a = x;
+	const struct sq_s *b = y;
+	return keycmp(a->sym, a->len, b->sym, b->len);
+}
 
 
 dict_t
@@ -106,6 +135,73 @@ dict_get_sym(dict_t d, const char *sym)
 	return *rp;
 }
 
+size_t
+dict_get_syms(
+	dict_t d, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n)
+{
+/* sort the symbols, then go through them with one cursor, walking
+ * from one to the next if they're close and jumping otherwise */
+	struct sq_s *sq;
+	BDBCUR *c;
+	bool curp = false;
+	size_t nfnd = 0U;
+
+	if (UNLIKELY((sq = malloc(n * sizeof(*sq))) == NULL)) {
+		goto one_by_one;
+	} else if (UNLIKELY((c = tcbdbcurnew(d)) == NULL)) {
+		free(sq);
+		goto one_by_one;
+	}
+	for (size_t i = 0U; i < n; i++) {
+		sq[i] = (struct sq_s){syms[i], (int)strlen(syms[i]), i};
+	}
+	qsort(sq, n, sizeof(*sq), sqcmp);
+
+	for (size_t j = 0U; j < n; j++) {
+		const void *kp;
+		const void *vp;
+		int kz[1U];
+		int vz[1U];
+		int cmp = -1;
+
+		oids[sq[j].i] = NUL_OID;
+		for (unsigned int k = 0U; k < SYMS_WALK && curp &&
+			     (kp = tcbdbcurkey3(c, kz)) != NULL &&
+			     (cmp = keycmp(kp, *kz, sq[j].sym, sq[j].len)) < 0;
+		     k++) {
+			curp = tcbdbcurnext(c);
+		}
+		if (cmp < 0) {
+			/* too far off, jump to the first key >= SYM */
+			curp = tcbdbcurjump(c, sq[j].sym, sq[j].len);
+			if (!curp || (kp = tcbdbcurkey3(c, kz)) == NULL) {
+				continue;
+			}
+			cmp = keycmp(kp, *kz, sq[j].sym, sq[j].len);
+		}
+		if (cmp) {
+			continue;
+		} else if ((vp = tcbdbcurval3(c, vz)) == NULL) {
+			continue;
+		} else if (UNLIKELY(*vz != sizeof(dict_oid_t))) {
+			continue;
+		}
+		oids[sq[j].i] = *(const dict_oid_t*)vp;
+		nfnd++;
+	}
+
+	tcbdbcurdel(c);
+	free(sq);
+	return nfnd;
+
+one_by_one:
+	for (size_t i = 0U; i < n; i++) {
+		nfnd += (oids[i] = dict_get_sym(d, syms[i])) != NUL_OID;
+	}
+	return nfnd;
+}
+
 dict_oid_t
 dict_put_sym(dict_t d, const char *sym, dict_oid_t sid)
 {
@@ -46,6 +46,8 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <time.h>
+#include <pthread.h>
 #include <sql.h>
 #include <sqlext.h>
 #if defined HAVE_IODBC
@@ -55,18 +57,104 @@
 #include "nifty.h"
 #include "logger.h"
 
-static SQLHANDLE henv = SQL_NULL_HANDLE;
-static SQLHANDLE hdbc = SQL_NULL_HANDLE;
-static SQLHANDLE stmt = SQL_NULL_HANDLE;
+/* connections in the pool, they're opened as concurrency demands */
+#define NCONN		(8U)
+/* longest wait between attempts to reach the server, in seconds */
+#define MAX_BACKOFF	(32U)
+
+/* one connection with its own prepared statements and bindings */
+struct conn_s {
+	struct conn_s *next;
+	SQLHANDLE henv;
+	SQLHANDLE hdbc;
+	/* prepared statement to resolve symbols */
+	SQLHANDLE stmt;
+	/* prepared statement to list the symbols of a source */
+	SQLHANDLE ssrc;
+	/* statement for batches of symbols */
+	SQLHANDLE sbat;
+	/* set when the driver reported the connection as broken */
+	bool deadp;
+	/* pool epoch at the time of connecting */
+	unsigned int epoch;
+
+	/* bound parameters and result columns of the statements */
+	SQLCHAR psym[256U];
+	SQLLEN psymz;
+	SQLCHAR rrid[32U];
+	SQLLEN rridz;
+	SQLCHAR psrc[256U];
+	SQLLEN psrcz;
+	SQLCHAR rsym[1024U];
+	SQLLEN rsymz;
+	SQLCHAR rbsym[1024U];
+	SQLLEN rbsymz;
+	SQLCHAR rbrid[32U];
+	SQLLEN rbridz;
+};
+
+/* what dict_t points to */
+struct pool_s {
+	SQLHANDLE henv;
+	SQLCHAR dsn[1024U];
+	size_t ndsn;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t cnd;
+	/* idle connections */
+	struct conn_s *idle;
+	/* connections open or being opened */
+	size_t nconn;
+	/* failed connection attempts in a row and when to try again */
+	unsigned int nfail;
+	time_t retry;
+	/* bumped whenever a connection dies, connections from
+	 * earlier epochs are suspect and get dropped when released */
+	unsigned int epoch;
+};
+
+/* symbols per VALUES clause */
+#define NBATCH		(256U)
+
+/* parameters are ??, virtuoso's positional parameters in sparql,
+ * spelt ?\? below so as not to be taken for trigraphs */
+static const char qsym[] = "\
+SPARQL \
+DEFINE input:same-as \"yes\" \
+PREFIX gas: <http://schema.ga-group.nl/symbology#> \
+SELECT ?rid FROM <http://data.ga-group.nl/rolf/> WHERE {\
+	`iri(bif:concat(\"http://data.ga-group.nl/rolf/series/\", ?\?))` \
+		gas:rolfid ?rid .\
+}";
+
+/* we won't get the rolfid in this query despite being
+ * promised as part of the dict_si_t contract
+ * we will simply return 1U for every match */
+static const char qsrc[] = "\
+SPARQL \
+DEFINE input:same-as \"yes\" \
+PREFIX gas: <http://schema.ga-group.nl/symbology#> \
+SELECT ?sym FROM <http://data.ga-group.nl/rolf/> WHERE {\
+	?sym gas:listedOn \
+		`iri(bif:concat(\"http://data.ga-group.nl/rolf/sources/\", ?\?))` .\
+}";
 
-static SQLCHAR rdsn[1024U];
-static SQLSMALLINT zdsn;
+/* batches don't fit the fixed parameters of a prepared statement,
+ * they're spelt out between the head and the tail of this query */
+static const char qbat_head[] = "\
+SPARQL \
+DEFINE input:same-as \"yes\" \
+PREFIX gas: <http://schema.ga-group.nl/symbology#> \
+SELECT ?sym ?rid FROM <http://data.ga-group.nl/rolf/> WHERE {\
+	VALUES ?sym {";
+static const char qbat_tail[] = "\
+	} \
+	?sym gas:rolfid ?rid .\
+}";
+static const char qbat_pre[] = "http://data.ga-group.nl/rolf/series/";
 
-static char qbuf[1024U];
 
-static int init_odbc(const char *conn);
-static int fini_odbc(void);
-static int odbc_error(SQLHANDLE s, const char *where);
+static int odbc_error(struct conn_s *c, SQLHANDLE s, const char *where);
 
 static size_t
 xstrlcpy(SQLCHAR *restrict dst, const char *src, size_t dsz)
@@ -80,99 +168,304 @@ xstrlcpy(SQLCHAR *restrict dst, const char *src, size_t dsz)
 	return ssz;
 }
 
-
+static time_t
+now_sec(void)
+{
+	struct timespec tsp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return tsp.tv_sec;
+}
+
+
 static int
-init_odbc(const char *conn)
+prep_conn(struct conn_s *c)
 {
 	SQLRETURN rc;
-	size_t ndsn;
 
-	/* allocate environment handle */
-	rc = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &henv);
+	/* symbol lookups */
+	rc = SQLPrepare(c->stmt, deconst(qsym), sizeof(qsym) - 1U);
 	if (!SQL_SUCCEEDED(rc)) {
-		goto error;
+		return odbc_error(c, c->stmt, "SQLPrepare()");
+	}
+	rc = SQLBindParameter(
+		c->stmt, 1U, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		sizeof(c->psym) - 1U, 0, c->psym, sizeof(c->psym), &c->psymz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->stmt, "SQLBindParameter()");
+	}
+	rc = SQLBindCol(
+		c->stmt, 1U, SQL_C_CHAR, c->rrid, sizeof(c->rrid), &c->rridz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->stmt, "SQLBindCol()");
 	}
 
-	/* set ODBC version environment attribute */
-	rc = SQLSetEnvAttr(henv, SQL_ATTR_ODBC_VERSION, (void*)SQL_OV_ODBC3, 0);
+	/* source listings */
+	rc = SQLPrepare(c->ssrc, deconst(qsrc), sizeof(qsrc) - 1U);
 	if (!SQL_SUCCEEDED(rc)) {
-		goto error;
+		return odbc_error(c, c->ssrc, "SQLPrepare()");
+	}
+	rc = SQLBindParameter(
+		c->ssrc, 1U, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR,
+		sizeof(c->psrc) - 1U, 0, c->psrc, sizeof(c->psrc), &c->psrcz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->ssrc, "SQLBindParameter()");
+	}
+	rc = SQLBindCol(
+		c->ssrc, 1U, SQL_C_CHAR, c->rsym, sizeof(c->rsym), &c->rsymz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->ssrc, "SQLBindCol()");
+	}
+
+	/* batches, bindings survive the statements */
+	rc = SQLBindCol(
+		c->sbat, 1U, SQL_C_CHAR, c->rbsym, sizeof(c->rbsym), &c->rbsymz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->sbat, "SQLBindCol()");
+	}
+	rc = SQLBindCol(
+		c->sbat, 2U, SQL_C_CHAR, c->rbrid, sizeof(c->rbrid), &c->rbridz);
+	if (!SQL_SUCCEEDED(rc)) {
+		return odbc_error(c, c->sbat, "SQLBindCol()");
 	}
+	return 0;
+}
+
+static void
+free_conn(struct conn_s *c)
+{
+	if (c->sbat) {
+		SQLFreeHandle(SQL_HANDLE_STMT, c->sbat);
+	}
+	if (c->ssrc) {
+		SQLFreeHandle(SQL_HANDLE_STMT, c->ssrc);
+	}
+	if (c->stmt) {
+		SQLFreeHandle(SQL_HANDLE_STMT, c->stmt);
+	}
+	if (c->hdbc) {
+		(void)SQLDisconnect(c->hdbc);
+		SQLFreeHandle(SQL_HANDLE_DBC, c->hdbc);
+	}
+	free(c);
+	return;
+}
+
+static struct conn_s*
+make_conn(struct pool_s *p)
+{
+	SQLCHAR odsn[1024U];
+	SQLSMALLINT zdsn;
+	struct conn_s *c;
+	SQLRETURN rc;
+
+	if (UNLIKELY((c = calloc(1U, sizeof(*c))) == NULL)) {
+		return NULL;
+	}
+	c->henv = p->henv;
 
 	/* allocate connection handle */
-	rc = SQLAllocHandle(SQL_HANDLE_DBC, henv, &hdbc);
+	rc = SQLAllocHandle(SQL_HANDLE_DBC, p->henv, &c->hdbc);
 	if (!SQL_SUCCEEDED(rc)) {
 		goto error;
 	}
 
-	/* prep connection string */
-	ndsn = xstrlcpy(rdsn, conn, sizeof(rdsn));
 	/* actually connect to data source */
-	rc = SQLDriverConnect(hdbc, SQL_NULL_HANDLE,
-			      /*in*/rdsn, ndsn,
-			      /*out*/rdsn, sizeof(rdsn), &zdsn,
+	rc = SQLDriverConnect(c->hdbc, SQL_NULL_HANDLE,
+			      /*in*/p->dsn, p->ndsn,
+			      /*out*/odsn, sizeof(odsn), &zdsn,
 			      SQL_DRIVER_COMPLETE_REQUIRED);
 	if (!SQL_SUCCEEDED(rc)) {
 		goto error;
 	}
 
-	/* allocate statement handle */
-	rc = SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &stmt);
+	/* allocate statement handles */
+	rc = SQLAllocHandle(SQL_HANDLE_STMT, c->hdbc, &c->stmt);
 	if (!SQL_SUCCEEDED(rc)) {
 		goto error;
 	}
+	rc = SQLAllocHandle(SQL_HANDLE_STMT, c->hdbc, &c->ssrc);
+	if (!SQL_SUCCEEDED(rc)) {
+		goto error;
+	}
+	rc = SQLAllocHandle(SQL_HANDLE_STMT, c->hdbc, &c->sbat);
+	if (!SQL_SUCCEEDED(rc)) {
+		goto error;
+	}
+
+	/* have the server parse and plan our queries once and for all */
+	if (prep_conn(c) < 0) {
+		free_conn(c);
+		return NULL;
+	}
 
 	/* success */
-	return 0;
+	return c;
 
 error:
 	/* failure */
-	odbc_error(stmt, "init_odbc()");
-	fini_odbc();
-	return -1;
+	odbc_error(c, c->stmt, "make_conn()");
+	free_conn(c);
+	return NULL;
 }
 
-static int
-fini_odbc(void)
+static bool
+conn_dead_p(struct conn_s *c)
 {
-	if (stmt) {
-		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+/* ask the driver, this doesn't go through to the server */
+	SQLUINTEGER dead = SQL_CD_FALSE;
+	SQLRETURN rc;
+
+	if (UNLIKELY(c->deadp)) {
+		return true;
 	}
-	stmt = SQL_NULL_HANDLE;
+	rc = SQLGetConnectAttr(
+		c->hdbc, SQL_ATTR_CONNECTION_DEAD, &dead, 0, NULL);
+	return c->deadp = SQL_SUCCEEDED(rc) && dead == SQL_CD_TRUE;
+}
 
-	if (hdbc) {
-		(void)SQLDisconnect(hdbc);
-		SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
+static struct conn_s*
+conn_acq(struct pool_s *p)
+{
+/* obtain an idle connection, or open a new one if there's room,
+ * return NULL if the data source can't be reached */
+	struct conn_s *c;
+	unsigned int epoch;
+
+	pthread_mutex_lock(&p->mtx);
+	for (;;) {
+		if ((c = p->idle) != NULL) {
+			p->idle = c->next;
+			pthread_mutex_unlock(&p->mtx);
+
+			if (LIKELY(!conn_dead_p(c))) {
+				return c;
+			}
+			/* went away while idle, replace it */
+			GAND_NOTI_LOG("odbc connection lost, reconnecting");
+			free_conn(c);
+			pthread_mutex_lock(&p->mtx);
+			p->nconn--;
+			continue;
+		} else if (p->nconn >= NCONN) {
+			/* wait for one to become idle */
+			;
+		} else if (p->nfail && now_sec() < p->retry) {
+			/* don't hammer a server that's down */
+			if (!p->nconn) {
+				pthread_mutex_unlock(&p->mtx);
+				return NULL;
+			}
+		} else {
+			p->nconn++;
+			break;
+		}
+		pthread_cond_wait(&p->cnd, &p->mtx);
 	}
-	hdbc = SQL_NULL_HANDLE;
+	epoch = p->epoch;
+	pthread_mutex_unlock(&p->mtx);
+
+	/* connecting may take a while, do it unlocked */
+	c = make_conn(p);
 
-	if (henv) {
-		SQLFreeHandle(SQL_HANDLE_ENV, henv);
+	pthread_mutex_lock(&p->mtx);
+	if (LIKELY(c != NULL)) {
+		c->epoch = epoch;
+		if (UNLIKELY(p->nfail)) {
+			GAND_NOTI_LOG("odbc connection re-established");
+		}
+		p->nfail = 0U;
+	} else {
+		const unsigned int b =
+			p->nfail < 5U ? 1U << p->nfail : MAX_BACKOFF;
+
+		GAND_ERR_LOG("\
+cannot connect to data source, next attempt in %us", b);
+		p->nfail++;
+		p->retry = now_sec() + b;
+		p->nconn--;
+		/* waiters might have nothing left to wait for */
+		pthread_cond_broadcast(&p->cnd);
 	}
-	henv = SQL_NULL_HANDLE;
-	return 0;
+	pthread_mutex_unlock(&p->mtx);
+	return c;
+}
+
+static void
+conn_rel(struct pool_s *p, struct conn_s *c)
+{
+/* hand C back to the pool */
+	const bool deadp = conn_dead_p(c);
+	struct conn_s *idle = NULL;
+	size_t nidle = 0U;
+
+	pthread_mutex_lock(&p->mtx);
+	if (LIKELY(!deadp && c->epoch == p->epoch)) {
+		c->next = p->idle;
+		p->idle = c;
+		pthread_cond_signal(&p->cnd);
+		pthread_mutex_unlock(&p->mtx);
+		return;
+	} else if (deadp) {
+		/* the server most likely went away, the other connections
+		 * are just as stale then, drop the idle ones right away
+		 * and the busy ones when they come back */
+		p->epoch++;
+		idle = p->idle;
+		p->idle = NULL;
+		for (struct conn_s *i = idle; i != NULL; i = i->next) {
+			nidle++;
+		}
+	}
+	p->nconn -= 1U + nidle;
+	pthread_cond_broadcast(&p->cnd);
+	pthread_mutex_unlock(&p->mtx);
+
+	if (deadp) {
+		GAND_NOTI_LOG("odbc connection lost, dropping %zu more", nidle);
+	}
+	free_conn(c);
+	for (struct conn_s *nx; idle != NULL; idle = nx) {
+		nx = idle->next;
+		free_conn(idle);
+	}
+	return;
+}
+
+static struct conn_s*
+conn_redo(struct pool_s *p, struct conn_s *c)
+{
+/* hand back C after a failed query, return a fresh connection
+ * to retry on if C died, or NULL if retrying is pointless */
+	const bool deadp = conn_dead_p(c);
+
+	conn_rel(p, c);
+	return deadp ? conn_acq(p) : NULL;
 }
 
 static int
-odbc_error(SQLHANDLE s, const char *where)
+odbc_error(struct conn_s *c, SQLHANDLE s, const char *where)
 {
 	unsigned char buf[256U];
 	unsigned char sta[16U];
 
 	/* statement errors */
-	while (SQLError(henv, hdbc, s, sta, NULL,
+	while (SQLError(c->henv, c->hdbc, s, sta, NULL,
 			buf, sizeof(buf), NULL) == SQL_SUCCESS) {
 		GAND_ERR_LOG("STMT: %s || %s, SQLSTATE=%s", where, buf, sta);
+		/* class 08 is connection exceptions */
+		c->deadp |= sta[0U] == '0' && sta[1U] == '8';
         }
 
 	/* connection errors */
-	while (SQLError(henv, hdbc, SQL_NULL_HSTMT, sta, NULL,
+	while (SQLError(c->henv, c->hdbc, SQL_NULL_HSTMT, sta, NULL,
 			buf, sizeof(buf), NULL) == SQL_SUCCESS) {
 		GAND_ERR_LOG("CONN:%s || %s, SQLSTATE=%s\n", where, buf, sta);
+		c->deadp |= sta[0U] == '0' && sta[1U] == '8';
         }
 
 	/* environment errors */
-	while (SQLError(henv, SQL_NULL_HDBC, SQL_NULL_HSTMT, sta, NULL,
+	while (SQLError(c->henv, SQL_NULL_HDBC, SQL_NULL_HSTMT, sta, NULL,
 			buf, sizeof(buf), NULL) == SQL_SUCCESS) {
 		GAND_ERR_LOG("XENV:%s || %s, SQLSTATE=%s\n", where, buf, sta);
         }
@@ -180,11 +473,12 @@ odbc_error(SQLHANDLE s, const char *where)
 }
 
 static int
-odbc_exec(SQLHANDLE d, char *qry, size_t qrz)
+odbc_exec(struct conn_s *c, SQLHANDLE s)
 {
+/* execute the prepared statement S with whatever's bound to it */
 	int rc;
 
-	switch ((rc = SQLExecDirect(d, (SQLCHAR*)qry, qrz))) {
+	switch ((rc = SQLExecute(s))) {
 	case SQL_SUCCESS:
 	case SQL_SUCCESS_WITH_INFO:
 		return 0;
@@ -193,26 +487,259 @@ odbc_exec(SQLHANDLE d, char *qry, size_t qrz)
 	default:
 		break;
         }
-	odbc_error(d, "SQLExecDirect()");
+	odbc_error(c, s, "SQLExecute()");
 	return -1;
 }
 
-
+static bool
+iri_safe_p(const char *s)
+{
+/* whether S can go into an IRI reference verbatim */
+	for (; *s; s++) {
+		if ((unsigned char)*s <= ' ' || strchr("<>\"{}|^`\\", *s)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct sq_s {
+	const char *sym;
+	size_t i;
+};
+
+static int
+sqcmp(const void *x, const void *y)
+{
+	const struct sq_s *a = x;
+	const struct sq_s *b = y;
+	return strcmp(a->sym, b->sym);
+}
+
+static size_t
+xparam(SQLCHAR *restrict dst, SQLLEN *dsz, const char *src, size_t dmax)
+{
+/* copy SRC to the bound parameter DST, return 0 if it doesn't fit */
+	size_t ssz = strlen(src);
+
+	if (UNLIKELY(ssz >= dmax)) {
+		return 0U;
+	}
+	memcpy(dst, src, ssz + 1U);
+	*dsz = (SQLLEN)ssz;
+	return ssz;
+}
+
+
+static int
+get_sym(struct conn_s *c, dict_oid_t *restrict rid, const char *sym)
+{
+/* resolve SYM to RID on C, return -1 if the query failed,
+ * RID is ERR_OID then */
+	SQLRETURN rc;
+	int res = 0;
+
+	*rid = NUL_OID;
+	if (UNLIKELY(!xparam(c->psym, &c->psymz, sym, sizeof(c->psym)))) {
+		return 0;
+	} else if (UNLIKELY(odbc_exec(c, c->stmt) < 0)) {
+		*rid = ERR_OID;
+		return -1;
+	}
+	/* otherwise snarf first match, straight into rrid */
+	if ((rc = SQLFetch(c->stmt)) == SQL_NO_DATA_FOUND) {
+                goto out;
+	} else if (!SQL_SUCCEEDED(rc)) {
+		res = odbc_error(c, c->stmt, "SQLFetch()");
+		*rid = ERR_OID;
+                goto out;
+	} else if (c->rridz == SQL_NULL_DATA) {
+                goto out;
+	}
+	/* just try and interpret as number */
+	*rid = strtoul((const char*)c->rrid, NULL, 10);
+out:
+	/* close the cursor but keep the plan and the bindings */
+	SQLFreeStmt(c->stmt, SQL_CLOSE);
+	return res;
+}
+
+static int
+get_batch(
+	struct conn_s *c, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n)
+{
+/* resolve up to NBATCH symbols on C with one VALUES query,
+ * return -1 if C died on us, symbols not got to are ERR_OID then */
+	struct sq_s sq[NBATCH];
+	size_t nsq = 0U;
+	size_t qz = sizeof(qbat_head) + sizeof(qbat_tail);
+	SQLRETURN rc;
+	char *qry;
+	char *qp;
+
+	for (size_t i = 0U; i < n; i++) {
+		oids[i] = ERR_OID;
+		if (iri_safe_p(syms[i])) {
+			sq[nsq++] = (struct sq_s){syms[i], i};
+			qz += sizeof(qbat_pre) + 2U/*< >*/ + strlen(syms[i]);
+		}
+	}
+	if (UNLIKELY(!nsq)) {
+		goto rest;
+	} else if (UNLIKELY((qry = malloc(qz)) == NULL)) {
+		nsq = 0U;
+		goto rest;
+	}
+	/* spell out the query */
+	memcpy(qp = qry, qbat_head, sizeof(qbat_head) - 1U);
+	qp += sizeof(qbat_head) - 1U;
+	for (size_t j = 0U; j < nsq; j++) {
+		const size_t z = strlen(sq[j].sym);
+
+		*qp++ = ' ';
+		*qp++ = '<';
+		memcpy(qp, qbat_pre, sizeof(qbat_pre) - 1U);
+		qp += sizeof(qbat_pre) - 1U;
+		memcpy(qp, sq[j].sym, z);
+		qp += z;
+		*qp++ = '>';
+	}
+	memcpy(qp, qbat_tail, sizeof(qbat_tail) - 1U);
+	qp += sizeof(qbat_tail) - 1U;
+
+	rc = SQLExecDirect(c->sbat, (SQLCHAR*)qry, qp - qry);
+	free(qry);
+	if (!SQL_SUCCEEDED(rc)) {
+		odbc_error(c, c->sbat, "SQLExecDirect()");
+		if (conn_dead_p(c)) {
+			return -1;
+		}
+		/* leave the whole batch to the prepared lookups */
+		nsq = 0U;
+		goto rest;
+	}
+	/* results come in any order, map them back via the sorted batch */
+	qsort(sq, nsq, sizeof(*sq), sqcmp);
+	while (SQL_SUCCEEDED(rc = SQLFetch(c->sbat))) {
+		struct sq_s k;
+		struct sq_s *hit;
+
+		if (c->rbsymz == SQL_NULL_DATA || c->rbridz == SQL_NULL_DATA) {
+			continue;
+		} else if (strncmp((const char*)c->rbsym,
+				   qbat_pre, sizeof(qbat_pre) - 1U)) {
+			continue;
+		}
+		k.sym = (const char*)c->rbsym + sizeof(qbat_pre) - 1U;
+		if ((hit = bsearch(&k, sq, nsq, sizeof(*sq), sqcmp)) == NULL) {
+			continue;
+		}
+		/* duplicates in the batch are neighbours now */
+		while (hit > sq && !strcmp(hit[-1].sym, k.sym)) {
+			hit--;
+		}
+		for (; hit < sq + nsq && !strcmp(hit->sym, k.sym); hit++) {
+			if (oids[hit->i] == ERR_OID) {
+				oids[hit->i] =
+					strtoul((const char*)c->rbrid, NULL, 10);
+			}
+		}
+	}
+	SQLFreeStmt(c->sbat, SQL_CLOSE);
+	if (rc != SQL_NO_DATA_FOUND) {
+		odbc_error(c, c->sbat, "SQLFetch()");
+		if (conn_dead_p(c)) {
+			return -1;
+		}
+		/* can't tell what's missing, look them all up again */
+		nsq = 0U;
+		goto rest;
+	}
+	/* what's not come through isn't there */
+	for (size_t j = 0U; j < nsq; j++) {
+		if (oids[sq[j].i] == ERR_OID) {
+			oids[sq[j].i] = NUL_OID;
+		}
+	}
+
+rest:
+	/* whatever couldn't go into the query */
+	if (nsq < n) {
+		for (size_t i = 0U; i < n; i++) {
+			if (nsq && iri_safe_p(syms[i])) {
+				continue;
+			} else if (get_sym(c, oids + i, syms[i]) < 0 &&
+				   conn_dead_p(c)) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+
 dict_t
 open_dict(const char *fn, int UNUSED(oflags))
 {
-	if (init_odbc(fn) < 0) {
+	struct pool_s *p;
+	struct conn_s *c;
+	SQLRETURN rc;
+
+	if (UNLIKELY((p = calloc(1U, sizeof(*p))) == NULL)) {
 		return NULL;
 	}
-	return stmt;
+	pthread_mutex_init(&p->mtx, NULL);
+	pthread_cond_init(&p->cnd, NULL);
+
+	/* allocate environment handle */
+	rc = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &p->henv);
+	if (!SQL_SUCCEEDED(rc)) {
+		goto error;
+	}
+
+	/* set ODBC version environment attribute */
+	rc = SQLSetEnvAttr(
+		p->henv, SQL_ATTR_ODBC_VERSION, (void*)SQL_OV_ODBC3, 0);
+	if (!SQL_SUCCEEDED(rc)) {
+		goto error;
+	}
+
+	/* prep connection string */
+	p->ndsn = xstrlcpy(p->dsn, fn, sizeof(p->dsn));
+
+	/* connect once to see if the data source is there at all,
+	 * further connections are opened as lookups overlap */
+	if ((c = conn_acq(p)) == NULL) {
+		goto error;
+	}
+	conn_rel(p, c);
+	return p;
+
+error:
+	if (p->henv) {
+		SQLFreeHandle(SQL_HANDLE_ENV, p->henv);
+	}
+	pthread_cond_destroy(&p->cnd);
+	pthread_mutex_destroy(&p->mtx);
+	free(p);
+	return NULL;
 }
 
 void
 close_dict(dict_t d)
 {
-	SQLFreeStmt(d, SQL_UNBIND);
-	SQLFreeStmt(d, SQL_CLOSE);
-	(void)fini_odbc();
+	struct pool_s *p = d;
+
+	/* lookups are over by now, so all connections are idle */
+	for (struct conn_s *c = p->idle, *nx; c != NULL; c = nx) {
+		nx = c->next;
+		free_conn(c);
+	}
+	SQLFreeHandle(SQL_HANDLE_ENV, p->henv);
+	pthread_cond_destroy(&p->cnd);
+	pthread_mutex_destroy(&p->mtx);
+	free(p);
 	return;
 }
 
@@ -220,45 +747,59 @@ dict_oid_t
 dict_get_sym(dict_t d, const char *sym)
 {
 /* resolve SYM to RID */
-	int n;
-	SQLRETURN rc;
-	SQLLEN rz = 0U;
-	dict_oid_t rid = NUL_OID;
+	struct pool_s *p = d;
+	struct conn_s *c;
+	dict_oid_t rid = ERR_OID;
+
+	if (UNLIKELY((c = conn_acq(p)) == NULL)) {
+		/* server's away */
+		return ERR_OID;
+	} else if (get_sym(c, &rid, sym) < 0 &&
+		   (c = conn_redo(p, c)) != NULL) {
+		/* one more go on a fresh connection */
+		(void)get_sym(c, &rid, sym);
+	}
+	if (c != NULL) {
+		conn_rel(p, c);
+	}
+	return rid;
+}
 
-	n = snprintf(qbuf, sizeof(qbuf), "\
-SPARQL \
-DEFINE input:same-as \"yes\" \
-PREFIX gas: <http://schema.ga-group.nl/symbology#> \
-SELECT ?rid FROM <http://data.ga-group.nl/rolf/> WHERE {\
-	<http://data.ga-group.nl/rolf/series/%s> gas:rolfid ?rid .\
-}", sym);
+size_t
+dict_get_syms(
+	dict_t d, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n)
+{
+	struct pool_s *p = d;
+	struct conn_s *c;
+	size_t nfnd = 0U;
 
-	if (UNLIKELY(n <= 0)) {
-		return NUL_OID;
-	} else if (UNLIKELY(odbc_exec(d, qbuf, (size_t)n) < 0)) {
-		return NUL_OID;
+	/* what we don't get to stays a failed lookup */
+	for (size_t i = 0U; i < n; i++) {
+		oids[i] = ERR_OID;
 	}
-	/* otherwise snarf first match */
-	if ((rc = SQLFetch(d)) == SQL_NO_DATA_FOUND) {
-                goto out;
-	} else if (!SQL_SUCCEEDED(rc)) {
-		odbc_error(d, "SQLFetch()");
-                goto out;
+	if (UNLIKELY(!n)) {
+		return 0U;
+	} else if (UNLIKELY((c = conn_acq(p)) == NULL)) {
+		/* server's away */
+		return 0U;
 	}
-	/* get actual data */
-	rc = SQLGetData(d, 1, SQL_C_CHAR, qbuf, sizeof(qbuf), &rz);
-	if (!SQL_SUCCEEDED(rc)) {
-		odbc_error(d, "SQLGetData()");
-                goto out;
-	} else if (rz == SQL_NULL_DATA) {
-                goto out;
+	for (size_t i = 0U; i < n && c != NULL; i += NBATCH) {
+		const size_t m = n - i < NBATCH ? n - i : NBATCH;
+
+		if (get_batch(c, oids + i, syms + i, m) < 0 &&
+		    (c = conn_redo(p, c)) != NULL) {
+			/* one more go on a fresh connection */
+			(void)get_batch(c, oids + i, syms + i, m);
+		}
 	}
-	/* just try and interpret as number */
-	rid = strtoul((const char*)qbuf, NULL, 10);
-out:
-	SQLFreeStmt(d, SQL_UNBIND);
-	SQLFreeStmt(d, SQL_CLOSE);
-	return rid;
+	if (c != NULL) {
+		conn_rel(p, c);
+	}
+	for (size_t i = 0U; i < n; i++) {
+		nfnd += oids[i] != NUL_OID && oids[i] != ERR_OID;
+	}
+	return nfnd;
 }
 
 dict_oid_t
@@ -289,66 +830,50 @@ dict_sym_iter(dict_t d)
 	return (dict_si_t){};
 }
 
+static int
+src_exec(struct conn_s *c, const char *src)
+{
+	if (UNLIKELY(!xparam(c->psrc, &c->psrcz, src, sizeof(c->psrc)))) {
+		return -1;
+	}
+	return odbc_exec(c, c->ssrc);
+}
+
 dict_si_t
 dict_src_iter(dict_t d, const char *src)
 {
-/* uses static state */
-	static SQLHANDLE s = SQL_NULL_HANDLE;
+/* uses thread-local state, the connection is held till the end */
+	static __thread struct conn_s *c;
+	struct pool_s *p = d;
 	SQLRETURN rc;
-	SQLLEN rz = 0U;
 
-	if (UNLIKELY(s == SQL_NULL_HANDLE)) {
-		int n;
-
-		/* allocate statement handle */
-		rc = SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &s);
-		if (!SQL_SUCCEEDED(rc)) {
-			odbc_error(s, "SQLAllocHandle()");
-			goto null;
-		}
-
-		/* we won't get the rolfid in this query despite being
-		 * promised as part of the dict_si_t contract
-		 * we will simply return 1U for every match */
-		n = snprintf(qbuf, sizeof(qbuf), "\
-SPARQL \
-DEFINE input:same-as \"yes\" \
-PREFIX gas: <http://schema.ga-group.nl/symbology#> \
-SELECT ?sym FROM <http://data.ga-group.nl/rolf/> WHERE {\
-	?sym gas:listedOn <http://data.ga-group.nl/rolf/sources/%s> .\
-}", src);
-
-		if (UNLIKELY(n <= 0)) {
-			goto null;
-		} else if (UNLIKELY(odbc_exec(s, qbuf, (size_t)n) < 0)) {
+	if (UNLIKELY(c == NULL)) {
+		if (UNLIKELY((c = conn_acq(p)) == NULL)) {
+			return (dict_si_t){};
+		} else if (src_exec(c, src) < 0 &&
+			   ((c = conn_redo(p, c)) == NULL ||
+			    src_exec(c, src) < 0)) {
 			goto null;
 		}
 	}
-	/* fetch next record */
-	if ((rc = SQLFetch(s)) == SQL_NO_DATA_FOUND) {
-		assert(SQLMoreResults(s) == SQL_NO_DATA_FOUND);
+	/* fetch next record, straight into rsym */
+	if ((rc = SQLFetch(c->ssrc)) == SQL_NO_DATA_FOUND) {
+		assert(SQLMoreResults(c->ssrc) == SQL_NO_DATA_FOUND);
 		goto null;
 	} else if (!SQL_SUCCEEDED(rc)) {
-		odbc_error(s, "SQLFetch()");
+		odbc_error(c, c->ssrc, "SQLFetch()");
 		goto null;
-	}
-	/* get actual data */
-	rc = SQLGetData(s, 1, SQL_C_CHAR, qbuf, sizeof(qbuf), &rz);
-	if (!SQL_SUCCEEDED(rc)) {
-		odbc_error(s, "SQLGetData()");
-                goto null;
-	} else if (rz == SQL_NULL_DATA) {
+	} else if (c->rsymz == SQL_NULL_DATA) {
                 goto null;
 	}
-	return (dict_si_t){1U, qbuf};
+	return (dict_si_t){1U, (const char*)c->rsym};
 
 null:
-	if (LIKELY(s != SQL_NULL_HANDLE)) {
-		SQLFreeStmt(s, SQL_UNBIND);
-		SQLFreeStmt(s, SQL_CLOSE);
-		SQLFreeHandle(SQL_HANDLE_STMT, s);
+	if (c != NULL) {
+		SQLFreeStmt(c->ssrc, SQL_CLOSE);
+		conn_rel(p, c);
 	}
-	s = SQL_NULL_HANDLE;
+	c = NULL;
 	return (dict_si_t){};
 }
 
@@ -48,11 +48,16 @@ struct dict_si_s {
 };
 
 #define NUL_OID		((dict_oid_t)0U)
+/* what lookups return when the dict couldn't be asked, e.g. because
+ * its server is away, as opposed to NUL_OID for symbols it hasn't got */
+#define ERR_OID		((dict_oid_t)-1)
 
 #if defined USE_VIRTUOSO
 # define DICT_DEFAULT	"dsn=gandalf"
 #elif defined USE_REDLAND
 # define DICT_DEFAULT	"gand_store"
+#elif defined USE_MPH
+# define DICT_DEFAULT	"gand_idx2sym.mph"
 #elif defined USE_TOKYOCABINET
 # define DICT_DEFAULT	"gand_idx2sym.tcb"
 #else
@@ -65,10 +70,21 @@ extern dict_t open_dict(const char *fn, int oflags);
 extern void close_dict(dict_t d);
 
 /**
- * Return oid for SYM (of length SSZ), or NUL_OID if not existent. */
+ * Return oid for SYM (of length SSZ), or NUL_OID if not existent,
+ * or ERR_OID if the lookup failed. */
 extern dict_oid_t
 dict_get_sym(dict_t d, const char *sym);
 
+/**
+ * Resolve the N symbols SYMS in one go, storing their oids in OIDS,
+ * or NUL_OID for symbols that aren't in the dictionary, or ERR_OID
+ * for symbols whose lookup failed.
+ * Return the number of symbols found. */
+extern size_t
+dict_get_syms(
+	dict_t d, dict_oid_t *restrict oids,
+	const char *const *syms, size_t n);
+
 /**
  * Put SYM (of length SSZ) into dictionary D under oid ID, or
  * if ID is NUL_OID, create a suitable oid.
@@ -0,0 +1,348 @@
+/*** gand-didx.c -- date index sidecars of series files
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Series files (show_lateglu) are date-ordered, the sidecar samples
+ * every STEP-th line's date and offset so that date lookups need only
+ * the sidecar and a handful of lines around the sampled ones.
+ * Series files are only ever appended to, so updating the sidecar
+ * means indexing the bits after the covered size and appending the
+ * entries, the header is written last.  Readers only trust entries
+ * that the header claims. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "gand-didx.h"
+#include "gand-rln.h"
+#include "nifty.h"
+
+struct gand_didx_s {
+	struct gand_didx_hdr_s h;
+	struct gand_didx_ent_s e[];
+};
+
+
+static int
+didx_cmp(const char dat[static 16U], const char *d, size_t dz)
+{
+/* compare entry date DAT to D, like the server compares dates
+ * (i.e. on D's width), truncated entries may compare equal */
+	const size_t ez = strnlen(dat, 16U);
+	int c;
+
+	if ((c = memcmp(dat, d, ez < dz ? ez : dz))) {
+		return c;
+	} else if (ez >= dz) {
+		return 0;
+	} else if (ez < 16U) {
+		/* genuinely shorter */
+		return -1;
+	}
+	/* can't tell */
+	return 0;
+}
+
+static bool
+didx_fits_p(const struct gand_didx_hdr_s *h, const struct gand_didx_ent_s *e, gandf_t fb)
+{
+/* check that header H and the last entry E match FB */
+	const char *const dp = fb.d;
+
+	if (memcmp(h->magic, GAND_DIDX_MAGIC, sizeof(h->magic))) {
+		return false;
+	} else if (h->fz > fb.z) {
+		/* truncated? */
+		return false;
+	} else if (h->fz && dp[h->fz - 1U] != '\n') {
+		/* not a line boundary, rewritten? */
+		return false;
+	} else if (e == NULL) {
+		return !h->nent;
+	} else if (e->off >= h->fz) {
+		return false;
+	} else if (e->off && dp[e->off - 1U] != '\n') {
+		return false;
+	}
+	/* last sampled line must still have the date we noted */
+	with (const char *eol = memchr(dp + e->off, '\n', h->fz - e->off)) {
+		word_t dat;
+
+		if (eol == NULL) {
+			return false;
+		} else if ((dat = snarf_rln(
+				    dp + e->off, eol - (dp + e->off)).dat).s == NULL) {
+			return false;
+		} else if (strncmp(e->dat, dat.s, dat.z < 16U ? dat.z : 16U)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int
+didx_name(char *restrict buf, size_t bsz, const char *fn)
+{
+	int z = snprintf(buf, bsz, "%s" GAND_DIDX_SFX, fn);
+
+	if (UNLIKELY(z < 0 || (size_t)z >= bsz)) {
+		return -1;
+	}
+	return z;
+}
+
+
+/* public api */
+ssize_t
+gand_didx_build(int dirfd, const char *fn, unsigned int step)
+{
+	struct gand_didx_hdr_s h;
+	struct gand_didx_ent_s *ev = NULL;
+	size_t ne = 0U, ze = 0U;
+	char xfn[PATH_MAX];
+	char tfn[PATH_MAX];
+	gandfn_t fx;
+	bool pend = false;
+	ssize_t res = -1;
+	int fd;
+
+	if (UNLIKELY(!step)) {
+		return -1;
+	} else if (didx_name(xfn, sizeof(xfn), fn) < 0) {
+		return -1;
+	} else if ((fx = mmapat_fn(dirfd, fn, O_RDONLY)).fd < 0) {
+		return -1;
+	}
+	*tfn = '\0';
+
+	/* see if there's anything to pick up from */
+	if ((fd = openat(dirfd, xfn, O_RDWR)) >= 0) {
+		struct gand_didx_ent_s last;
+
+		if (pread(fd, &h, sizeof(h), 0) < (ssize_t)sizeof(h)) {
+			goto full;
+		} else if (h.step != step) {
+			goto full;
+		} else if (h.nent && pread(
+				   fd, &last, sizeof(last),
+				   sizeof(h) + (h.nent - 1U) * sizeof(last)) <
+			   (ssize_t)sizeof(last)) {
+			goto full;
+		} else if (!didx_fits_p(&h, h.nent ? &last : NULL, fx.fb)) {
+			goto full;
+		}
+		goto scan;
+
+	full:
+		close(fd);
+	}
+	/* start afresh in a temporary file */
+	if ((size_t)snprintf(tfn, sizeof(tfn), "%s.tmp", xfn) >= sizeof(tfn)) {
+		*tfn = '\0';
+		goto unmap;
+	} else if ((fd = openat(
+			    dirfd, tfn, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		*tfn = '\0';
+		goto unmap;
+	}
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, GAND_DIDX_MAGIC, sizeof(h.magic));
+	h.step = step;
+
+scan:
+	/* index what's past the covered bit, complete lines only */
+	for (const char *const dp = fx.fb.d, *eol;
+	     h.fz < fx.fb.z &&
+		     (eol = memchr(dp + h.fz, '\n', fx.fb.z - h.fz)) != NULL;
+	     h.fz = eol - dp + 1U, h.nln++) {
+		const char *bol = dp + h.fz;
+		const word_t dat = snarf_rln(bol, eol - bol).dat;
+		const size_t dz = dat.z < 16U ? dat.z : 16U;
+
+		if (dat.s == NULL) {
+			/* sample the next good line instead */
+			pend |= !(h.nln % step);
+			continue;
+		}
+		if (!h.nln || !*h.first) {
+			memcpy(h.first, dat.s, dz);
+		}
+		memset(h.last, 0, sizeof(h.last));
+		memcpy(h.last, dat.s, dz);
+
+		if (!pend && h.nln % step) {
+			continue;
+		} else if (UNLIKELY(ne >= ze)) {
+			const size_t nuz = ze ? ze * 2U : 256U;
+			struct gand_didx_ent_s *nu;
+
+			if ((nu = realloc(ev, nuz * sizeof(*nu))) == NULL) {
+				goto unl;
+			}
+			ev = nu;
+			ze = nuz;
+		}
+		memset(ev[ne].dat, 0, sizeof(ev[ne].dat));
+		memcpy(ev[ne].dat, dat.s, dz);
+		ev[ne].off = h.fz;
+		ne++;
+		pend = false;
+	}
+
+	/* entries first, then the header that claims them */
+	with (const size_t z = ne * sizeof(*ev)) {
+		const off_t o = sizeof(h) + h.nent * sizeof(*ev);
+
+		if (z && pwrite(fd, ev, z, o) < (ssize_t)z) {
+			goto unl;
+		}
+	}
+	h.nent += ne;
+	if (pwrite(fd, &h, sizeof(h), 0) < (ssize_t)sizeof(h)) {
+		goto unl;
+	} else if (*tfn && renameat(dirfd, tfn, dirfd, xfn) < 0) {
+		goto unl;
+	}
+	res = ne;
+	goto clo;
+
+unl:
+	if (*tfn) {
+		(void)unlinkat(dirfd, tfn, 0);
+	}
+clo:
+	close(fd);
+unmap:
+	if (ev != NULL) {
+		free(ev);
+	}
+	munmap_fn(fx);
+	return res;
+}
+
+gand_didx_t
+gand_didx_read(int dirfd, const char *fn, gandf_t fb)
+{
+	struct gand_didx_hdr_s h;
+	char xfn[PATH_MAX];
+	gand_didx_t res;
+	size_t z;
+	int fd;
+
+	if (didx_name(xfn, sizeof(xfn), fn) < 0) {
+		return NULL;
+	} else if ((fd = openat(dirfd, xfn, O_RDONLY)) < 0) {
+		return NULL;
+	} else if (pread(fd, &h, sizeof(h), 0) < (ssize_t)sizeof(h)) {
+		goto clo;
+	} else if (!h.nent || h.nent > fb.z) {
+		/* nothing to go by or clearly bogus */
+		goto clo;
+	}
+	/* just the one small read */
+	z = h.nent * sizeof(*res->e);
+	if (UNLIKELY((res = malloc(sizeof(*res) + z)) == NULL)) {
+		goto clo;
+	} else if (pread(fd, res->e, z, sizeof(h)) < (ssize_t)z) {
+		goto free;
+	}
+	res->h = h;
+	if (!didx_fits_p(&h, res->e + h.nent - 1U, fb)) {
+		goto free;
+	}
+	close(fd);
+	return res;
+
+free:
+	free(res);
+clo:
+	close(fd);
+	return NULL;
+}
+
+void
+gand_didx_free(gand_didx_t x)
+{
+	free(x);
+	return;
+}
+
+static size_t
+didx_bisect(gand_didx_t x, const char *d, size_t dz, bool after)
+{
+/* return the first entry dated D or later, or later than D if AFTER */
+	size_t l = 0U, h = x->h.nent;
+
+	while (l < h) {
+		const size_t m = l + (h - l) / 2U;
+		const int c = didx_cmp(x->e[m].dat, d, dz);
+
+		if (c < 0 || (after && c == 0)) {
+			l = m + 1U;
+		} else {
+			h = m;
+		}
+	}
+	return l;
+}
+
+void
+gand_didx_bounds(gand_didx_t x, const char *d, size_t *lo, size_t *hi)
+{
+	const size_t dz = strlen(d);
+	size_t l, h;
+
+	/* everything before the last entry dated before D is, too */
+	if ((l = didx_bisect(x, d, dz, false)) > 0U &&
+	    x->e[l - 1U].off > *lo) {
+		*lo = x->e[l - 1U].off;
+	}
+	/* everything from the first entry dated after D on is, too */
+	if ((h = didx_bisect(x, d, dz, true)) < x->h.nent &&
+	    x->e[h].off < *hi) {
+		*hi = x->e[h].off;
+	}
+	return;
+}
+
+/* gand-didx.c ends here */
@@ -0,0 +1,93 @@
+/*** gand-didx.h -- date index sidecars of series files
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_didx_h_
+#define INCLUDED_gand_didx_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fops.h"
+
+/* the sidecar of FILE is FILE.didx, a header followed by entries */
+#define GAND_DIDX_SFX	".didx"
+#define GAND_DIDX_MAGIC	"GDX1"
+
+typedef struct gand_didx_s *gand_didx_t;
+
+struct gand_didx_hdr_s {
+	char magic[4U];
+	/* lines between entries */
+	uint32_t step;
+	/* bytes and lines of the series file covered */
+	uint64_t fz;
+	uint64_t nln;
+	/* number of entries following the header */
+	uint64_t nent;
+	/* dates of the first and last line, \nul-padded */
+	char first[16U];
+	char last[16U];
+};
+
+struct gand_didx_ent_s {
+	/* date of the line at OFF, \nul-padded, possibly truncated */
+	char dat[16U];
+	uint64_t off;
+};
+
+
+/**
+ * Build FN's sidecar (FN relative to DIRFD) with an entry every
+ * STEP lines, or bring an existing one up to date if FN has merely
+ * been appended to.
+ * Return the number of entries added or -1 on failure. */
+extern ssize_t gand_didx_build(int dirfd, const char *fn, unsigned int step);
+
+/**
+ * Read FN's sidecar if there is one and it fits FB, FN's contents. */
+extern gand_didx_t gand_didx_read(int dirfd, const char *fn, gandf_t fb);
+
+/**
+ * Free resources associated with the index. */
+extern void gand_didx_free(gand_didx_t);
+
+/**
+ * Narrow the range [*LO, *HI) of line boundaries down to the lines
+ * amongst which the first line dated D or later, as well as the first
+ * line dated later than D, have to be. */
+extern void
+gand_didx_bounds(gand_didx_t, const char *d, size_t *lo, size_t *hi);
+
+#endif	/* INCLUDED_gand_didx_h_ */
@@ -0,0 +1,217 @@
+/*** gand-enc.c -- bits shared by the binary encoders
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Dictionaries are open-addressed hash tables over the ids of the
+ * strings, kept at most half full. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "gand-enc.h"
+#include "nifty.h"
+
+
+static inline unsigned int
+dict_hash(word_t w)
+{
+	const uint64_t h = fnv1a(FNV1A_BASIS, w.s, w.z);
+
+	return (unsigned int)(h ^ h >> 32U);
+}
+
+static inline bool
+dict_eq_p(const struct gand_enc_dict_s *d, size_t id, word_t w)
+{
+	const size_t o = d->off[id];
+
+	return d->off[id + 1U] - o == w.z && !memcmp(d->str + o, w.s, w.z);
+}
+
+static int
+dict_rehash(struct gand_enc_dict_s *d)
+{
+	const size_t nuz = d->zht ? d->zht * 2U : 64U;
+	uint32_t *nu;
+
+	if (UNLIKELY((nu = calloc(nuz, sizeof(*nu))) == NULL)) {
+		return -1;
+	}
+	for (size_t id = 0U; id < d->n; id++) {
+		const word_t w = {
+			d->str + d->off[id],
+			d->off[id + 1U] - d->off[id],
+		};
+		size_t i;
+
+		i = dict_hash(w) & (nuz - 1U);
+		for (; nu[i]; i = (i + 1U) & (nuz - 1U));
+		nu[i] = (uint32_t)(id + 1U);
+	}
+	free(d->ht);
+	d->ht = nu;
+	d->zht = nuz;
+	return 0;
+}
+
+
+void*
+gand_enc_grow(void *p, size_t *restrict z, size_t n, size_t sz)
+{
+	size_t nuz = *z ? *z : 256U;
+	void *nu;
+
+	if (LIKELY(n <= *z)) {
+		return p;
+	}
+	while (nuz < n) {
+		nuz *= 2U;
+	}
+	if (UNLIKELY((nu = realloc(p, nuz * sz)) == NULL)) {
+		return NULL;
+	}
+	*z = nuz;
+	return nu;
+}
+
+int
+gand_enc_dict_init(struct gand_enc_dict_s *d)
+{
+	memset(d, 0, sizeof(*d));
+	d->run = -1;
+	/* the offsets always have their first element */
+	if (UNLIKELY((d->off = gand_enc_grow(
+			      NULL, &d->zoff, 1U, sizeof(*d->off))) == NULL)) {
+		return -1;
+	}
+	d->off[0U] = 0U;
+	return 0;
+}
+
+void
+gand_enc_dict_fini(struct gand_enc_dict_s *d)
+{
+	free(d->off);
+	free(d->str);
+	free(d->ht);
+	memset(d, 0, sizeof(*d));
+	return;
+}
+
+long int
+gand_enc_dict_intern(struct gand_enc_dict_s *d, word_t w, size_t maxn)
+{
+	size_t i;
+	void *p;
+
+	if (d->run >= 0 && dict_eq_p(d, d->run, w)) {
+		/* same as last time, happens a lot */
+		return d->run;
+	} else if (UNLIKELY(2U * (d->n + 1U) > d->zht) &&
+		   UNLIKELY(dict_rehash(d) < 0)) {
+		return -1;
+	}
+	for (i = dict_hash(w) & (d->zht - 1U); d->ht[i];
+	     i = (i + 1U) & (d->zht - 1U)) {
+		if (dict_eq_p(d, d->ht[i] - 1U, w)) {
+			return d->run = d->ht[i] - 1U;
+		}
+	}
+	/* new one, offsets have to fit arrow's int32 */
+	if (UNLIKELY(d->n >= maxn || d->nstr + w.z > INT32_MAX)) {
+		return -1;
+	} else if ((p = gand_enc_grow(
+			    d->off, &d->zoff,
+			    d->n + 2U, sizeof(*d->off))) == NULL) {
+		return -1;
+	}
+	d->off = p;
+	if ((p = gand_enc_grow(d->str, &d->zstr, d->nstr + w.z, 1U)) == NULL) {
+		return -1;
+	}
+	d->str = p;
+	memcpy(d->str + d->nstr, w.s, w.z);
+	d->nstr += w.z;
+	d->off[d->n + 1U] = (uint32_t)d->nstr;
+	d->ht[i] = (uint32_t)(d->n + 1U);
+	return d->run = d->n++;
+}
+
+bool
+gand_enc_num(double *restrict v, word_t w)
+{
+/* parse W as number, true if it's all number and printing the number
+ * gives W back, strtod() alone would take whitespace, nan, inf and hex
+ * and turn 1.10 or 007 into something that doesn't read the same */
+	char tmp[64U];
+	char fmt[64U];
+	const char *sp = w.s;
+	const char *const ep = w.s + w.z;
+	int ndec = 0;
+
+	if (UNLIKELY(!w.z || w.z >= sizeof(tmp))) {
+		return false;
+	}
+	/* -?(0|[1-9][0-9]*)(\.[0-9]*[1-9])? is all we accept */
+	sp += *sp == '-';
+	if (sp >= ep || (unsigned char)(*sp - '0') > 9U) {
+		return false;
+	} else if (*sp == '0' && sp + 1U < ep && *++sp != '.') {
+		return false;
+	}
+	for (; sp < ep && (unsigned char)(*sp - '0') <= 9U; sp++);
+	if (sp < ep && *sp++ == '.') {
+		for (; sp < ep && (unsigned char)(*sp - '0') <= 9U; sp++, ndec++);
+		if (!ndec || sp[-1] == '0') {
+			return false;
+		}
+	}
+	if (sp < ep) {
+		return false;
+	}
+	memcpy(tmp, w.s, w.z);
+	tmp[w.z] = '\0';
+	*v = strtod(tmp, NULL);
+	/* more digits than a double holds won't come back */
+	return snprintf(fmt, sizeof(fmt), "%.*f", ndec, *v) == (int)w.z &&
+		!memcmp(fmt, tmp, w.z);
+}
+
+/* gand-enc.c ends here */
@@ -0,0 +1,89 @@
+/*** gand-enc.h -- bits shared by the binary encoders
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Bits the columnar and the arrow encoder have in common, both keep
+ * their dictionaries as string data plus offsets, ready to be sent. */
+#if !defined INCLUDED_gand_enc_h_
+#define INCLUDED_gand_enc_h_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "gand-rln.h"
+
+/* interned strings, the I-th one is STR[OFF[I] .. OFF[I + 1]) */
+struct gand_enc_dict_s {
+	size_t n;
+	size_t zoff;
+	uint32_t *off;
+	size_t nstr;
+	size_t zstr;
+	char *str;
+	/* ids + 1 hashed, 0 for empty slots */
+	size_t zht;
+	uint32_t *ht;
+	/* id looked up last, -1 for none */
+	long int run;
+};
+
+
+/**
+ * Make room for N objects of size SZ in P, of which there's room
+ * for *Z objects at the moment, return NULL on failure. */
+extern void *gand_enc_grow(void *p, size_t *restrict z, size_t n, size_t sz);
+
+/**
+ * Set up dictionary D, return -1 on failure. */
+extern int gand_enc_dict_init(struct gand_enc_dict_s *d);
+
+/**
+ * Free the resources of dictionary D. */
+extern void gand_enc_dict_fini(struct gand_enc_dict_s *d);
+
+/**
+ * Return the id of W in D, adding it if need be, or -1 if that would
+ * make for more than MAXN entries, or on failure. */
+extern long int
+gand_enc_dict_intern(struct gand_enc_dict_s *d, word_t w, size_t maxn);
+
+/**
+ * Parse W as number into *V, true if W is all number and reads the same
+ * as the number printed, false for everything that has to be kept as
+ * string, whitespace, nan, inf, hex and exponents included. */
+extern bool gand_enc_num(double *restrict v, word_t w);
+
+#endif	/* INCLUDED_gand_enc_h_ */
@@ -0,0 +1,273 @@
+/*** gand-pool.c -- work-stealing thread pool
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Every thread owns a ring of tasks, pushes go to the rings round-robin.
+ * Owners take from the front so tasks finish roughly in the order they
+ * were pushed, idle threads steal from the back of the others' rings.
+ * Tasks here are coarse (a series each) so a mutex per ring will do. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "gand-pool.h"
+#include "logger.h"
+#include "nifty.h"
+
+struct gand_task_s {
+	void(*f)(void*);
+	void *clo;
+};
+
+struct gand_deq_s {
+	pthread_mutex_t mtx;
+	/* tasks live in Q[HEAD % Z] ... Q[(TAIL - 1) % Z], Z a power of 2 */
+	size_t head;
+	size_t tail;
+	size_t z;
+	struct gand_task_s *q;
+
+	struct gand_pool_s *pool;
+	pthread_t thr;
+};
+
+struct gand_pool_s {
+	pthread_mutex_t mtx;
+	pthread_cond_t cnd;
+	/* number of tasks queued but not taken yet */
+	size_t npend;
+	bool quit;
+	/* ring to push to next */
+	size_t rr;
+
+	size_t nthr;
+	/* threads actually spawned, rings beyond that are served by
+	 * stealing only */
+	size_t nrun;
+	struct gand_deq_s deq[];
+};
+
+
+static int
+deq_push(struct gand_deq_s *d, struct gand_task_s t)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&d->mtx);
+	if (UNLIKELY(d->tail - d->head >= d->z)) {
+		/* unroll into a ring twice the size */
+		const size_t nuz = d->z * 2U ?: 64U;
+		struct gand_task_s *nuq;
+
+		if (UNLIKELY((nuq = malloc(nuz * sizeof(*nuq))) == NULL)) {
+			rc = -1;
+			goto out;
+		}
+		for (size_t i = 0U, n = d->tail - d->head; i < n; i++) {
+			nuq[i] = d->q[(d->head + i) & (d->z - 1U)];
+		}
+		free(d->q);
+		d->q = nuq;
+		d->tail -= d->head;
+		d->head = 0U;
+		d->z = nuz;
+	}
+	d->q[d->tail++ & (d->z - 1U)] = t;
+out:
+	pthread_mutex_unlock(&d->mtx);
+	return rc;
+}
+
+static bool
+deq_take(struct gand_deq_s *d, struct gand_task_s *restrict t, bool back)
+{
+	bool rc = false;
+
+	pthread_mutex_lock(&d->mtx);
+	if (d->head < d->tail) {
+		*t = d->q[(back ? --d->tail : d->head++) & (d->z - 1U)];
+		rc = true;
+	}
+	pthread_mutex_unlock(&d->mtx);
+	return rc;
+}
+
+static bool
+pool_take(struct gand_pool_s *p, size_t me, struct gand_task_s *restrict t)
+{
+	if (deq_take(p->deq + me, t, false)) {
+		goto took;
+	}
+	/* go steal then */
+	for (size_t i = 1U; i < p->nthr; i++) {
+		if (deq_take(p->deq + (me + i) % p->nthr, t, true)) {
+			goto took;
+		}
+	}
+	return false;
+took:
+	pthread_mutex_lock(&p->mtx);
+	p->npend--;
+	pthread_mutex_unlock(&p->mtx);
+	return true;
+}
+
+static void*
+pool_run(void *clo)
+{
+	struct gand_deq_s *d = clo;
+	struct gand_pool_s *p = d->pool;
+	const size_t me = d - p->deq;
+	sigset_t ss[1U];
+
+	/* signals are the main thread's business */
+	sigfillset(ss);
+	pthread_sigmask(SIG_BLOCK, ss, NULL);
+
+	for (;;) {
+		struct gand_task_s t;
+		bool quit;
+
+		if (pool_take(p, me, &t)) {
+			t.f(t.clo);
+			continue;
+		}
+		/* nothing to do, wait for more */
+		pthread_mutex_lock(&p->mtx);
+		while (!p->npend && !p->quit) {
+			pthread_cond_wait(&p->cnd, &p->mtx);
+		}
+		quit = !p->npend && p->quit;
+		pthread_mutex_unlock(&p->mtx);
+
+		if (quit) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+
+gand_pool_t
+make_gand_pool(size_t nthr)
+{
+	struct gand_pool_s *res;
+
+	if (UNLIKELY(!nthr)) {
+		return NULL;
+	}
+	res = calloc(1U, sizeof(*res) + nthr * sizeof(*res->deq));
+	if (UNLIKELY(res == NULL)) {
+		return NULL;
+	}
+	pthread_mutex_init(&res->mtx, NULL);
+	pthread_cond_init(&res->cnd, NULL);
+	for (size_t i = 0U; i < nthr; i++) {
+		pthread_mutex_init(&res->deq[i].mtx, NULL);
+		res->deq[i].pool = res;
+	}
+	/* all rings must be in place before the first thread goes
+	 * stealing from them */
+	res->nthr = nthr;
+	for (; res->nrun < nthr; res->nrun++) {
+		struct gand_deq_s *d = res->deq + res->nrun;
+
+		if (UNLIKELY(pthread_create(&d->thr, NULL, pool_run, d))) {
+			GAND_ERR_LOG("cannot spawn pool thread %zu", res->nrun);
+			break;
+		}
+	}
+	if (UNLIKELY(!res->nrun)) {
+		free_gand_pool(res);
+		return NULL;
+	}
+	return res;
+}
+
+void
+free_gand_pool(gand_pool_t p)
+{
+	pthread_mutex_lock(&p->mtx);
+	p->quit = true;
+	pthread_cond_broadcast(&p->cnd);
+	pthread_mutex_unlock(&p->mtx);
+
+	for (size_t i = 0U; i < p->nrun; i++) {
+		pthread_join(p->deq[i].thr, NULL);
+	}
+	for (size_t i = 0U; i < p->nthr; i++) {
+		pthread_mutex_destroy(&p->deq[i].mtx);
+		free(p->deq[i].q);
+	}
+	pthread_cond_destroy(&p->cnd);
+	pthread_mutex_destroy(&p->mtx);
+	free(p);
+	return;
+}
+
+int
+gand_pool_push(gand_pool_t p, void(*task)(void*), void *clo)
+{
+	const size_t i = __sync_fetch_and_add(&p->rr, 1U) % p->nthr;
+
+	/* count the task before publishing it, a thread may take it
+	 * (and decrement NPEND) as soon as it's in the ring */
+	pthread_mutex_lock(&p->mtx);
+	p->npend++;
+	pthread_mutex_unlock(&p->mtx);
+	if (UNLIKELY(deq_push(p->deq + i, (struct gand_task_s){task, clo}) < 0)) {
+		pthread_mutex_lock(&p->mtx);
+		p->npend--;
+		pthread_mutex_unlock(&p->mtx);
+		return -1;
+	}
+	pthread_mutex_lock(&p->mtx);
+	pthread_cond_signal(&p->cnd);
+	pthread_mutex_unlock(&p->mtx);
+	return 0;
+}
+
+size_t
+gand_pool_nthr(gand_pool_t p)
+{
+	return p->nrun;
+}
+
+/* gand-pool.c ends here */
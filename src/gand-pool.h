@@ -0,0 +1,65 @@
+/*** gand-pool.h -- work-stealing thread pool
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_pool_h_
+#define INCLUDED_gand_pool_h_
+
+#include <stddef.h>
+
+typedef struct gand_pool_s *gand_pool_t;
+
+
+/**
+ * Spawn a pool of NTHR threads, each with its own queue of tasks,
+ * idle threads steal from the queues of busy ones.
+ * Return NULL on failure. */
+extern gand_pool_t make_gand_pool(size_t nthr);
+
+/**
+ * Run the tasks still queued, collect the threads and free the pool. */
+extern void free_gand_pool(gand_pool_t);
+
+/**
+ * Queue TASK to be called with CLO on one of POOL's threads.
+ * Tasks are taken in the order they were queued as long as nobody
+ * needs to steal.  Return -1 if the task couldn't be queued. */
+extern int gand_pool_push(gand_pool_t pool, void(*task)(void*), void *clo);
+
+/**
+ * Return the number of threads in POOL. */
+extern size_t gand_pool_nthr(gand_pool_t pool);
+
+#endif	/* INCLUDED_gand_pool_h_ */
@@ -0,0 +1,267 @@
+/*** gand-rcache.c -- in-memory cache of responses
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Entries are hashed by id and variant into a fixed number of buckets
+ * and kept on a doubly-linked list in order of use, all under one
+ * mutex as it's shared by all worker threads.
+ * The responses themselves are refcounted buffers, a hit hands out
+ * another reference to it, so evicting an entry that's still being
+ * sent is perfectly fine. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "gand-rcache.h"
+#include "logger.h"
+#include "nifty.h"
+
+struct rc_ent_s {
+	/* bucket chain */
+	struct rc_ent_s *next;
+	/* lru list, most recent first */
+	struct rc_ent_s *lprev;
+	struct rc_ent_s *lnext;
+	uint64_t h;
+	gand_rkey_t k;
+	gand_rbuf_t rb;
+	/* what we account for this entry */
+	size_t z;
+	char var[];
+};
+
+#define RC_NBUCK	(4096U)
+/* largest entry in relation to the whole cache */
+#define RC_ENTDIV	(16U)
+
+static pthread_mutex_t rc_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rc_ent_s *rc_buck[RC_NBUCK];
+static struct rc_ent_s *rc_head;
+static struct rc_ent_s *rc_tail;
+static size_t rc_maxz;
+static gand_rcache_stats_t rc_st;
+
+
+static uint64_t
+rc_hash(gand_rkey_t k)
+{
+	const uint64_t h = fnv1a(FNV1A_BASIS, &k.id, sizeof(k.id));
+
+	return fnv1a(h, k.var, k.varz);
+}
+
+static struct rc_ent_s**
+rc_find(uint64_t h, gand_rkey_t k)
+{
+/* return the chain slot pointing to K's entry, or the end of the chain */
+	struct rc_ent_s **ep = rc_buck + (h % RC_NBUCK);
+
+	for (; *ep != NULL; ep = &(*ep)->next) {
+		const struct rc_ent_s *e = *ep;
+
+		if (e->h == h && e->k.id == k.id && e->k.varz == k.varz &&
+		    !memcmp(e->var, k.var, k.varz)) {
+			break;
+		}
+	}
+	return ep;
+}
+
+static void
+rc_lru_unlink(struct rc_ent_s *e)
+{
+	if (e->lprev != NULL) {
+		e->lprev->lnext = e->lnext;
+	} else {
+		rc_head = e->lnext;
+	}
+	if (e->lnext != NULL) {
+		e->lnext->lprev = e->lprev;
+	} else {
+		rc_tail = e->lprev;
+	}
+	return;
+}
+
+static void
+rc_lru_push(struct rc_ent_s *e)
+{
+	e->lprev = NULL;
+	if ((e->lnext = rc_head) != NULL) {
+		rc_head->lprev = e;
+	} else {
+		rc_tail = e;
+	}
+	rc_head = e;
+	return;
+}
+
+static void
+rc_drop(struct rc_ent_s **ep)
+{
+/* remove the entry at EP from its chain and the lru and free it */
+	struct rc_ent_s *e = *ep;
+
+	*ep = e->next;
+	rc_lru_unlink(e);
+	rc_st.nent--;
+	rc_st.curz -= e->z;
+	free_gand_rbuf(e->rb);
+	free(e);
+	return;
+}
+
+static void
+rc_evict(void)
+{
+/* drop least recently used entries until we're within budget */
+	while (rc_st.curz > rc_maxz && rc_tail != NULL) {
+		rc_drop(rc_find(rc_tail->h, rc_tail->k));
+		rc_st.evictions++;
+	}
+	return;
+}
+
+
+/* public api */
+int
+gand_rcache_init(size_t maxz)
+{
+	rc_maxz = maxz;
+	return 0;
+}
+
+void
+gand_rcache_fini(void)
+{
+	pthread_mutex_lock(&rc_mtx);
+	while (rc_tail != NULL) {
+		rc_drop(rc_find(rc_tail->h, rc_tail->k));
+	}
+	rc_maxz = 0U;
+	pthread_mutex_unlock(&rc_mtx);
+	return;
+}
+
+gand_rbuf_t
+gand_rcache_get(gand_rkey_t k)
+{
+	const uint64_t h = rc_hash(k);
+	gand_rbuf_t res = NULL;
+	struct rc_ent_s **ep;
+
+	if (!rc_maxz) {
+		return NULL;
+	}
+	pthread_mutex_lock(&rc_mtx);
+	if (*(ep = rc_find(h, k)) == NULL) {
+		rc_st.misses++;
+	} else if ((*ep)->k.mtim != k.mtim || (*ep)->k.nsec != k.nsec ||
+		   (*ep)->k.size != k.size) {
+		/* source file's changed */
+		rc_drop(ep);
+		rc_st.evictions++;
+		rc_st.misses++;
+	} else {
+		struct rc_ent_s *e = *ep;
+
+		/* most recently used now */
+		rc_lru_unlink(e);
+		rc_lru_push(e);
+		res = gand_rbuf_ref(e->rb);
+		rc_st.hits++;
+	}
+	pthread_mutex_unlock(&rc_mtx);
+	return res;
+}
+
+int
+gand_rcache_put(gand_rkey_t k, gand_rbuf_t rb)
+{
+	const uint64_t h = rc_hash(k);
+	struct rc_ent_s **ep;
+	struct rc_ent_s *e;
+	size_t z;
+
+	z = sizeof(*e) + k.varz + gand_rbuf_size(rb);
+	if (!gand_rcache_fits_p(z)) {
+		return -1;
+	} else if (UNLIKELY((e = malloc(sizeof(*e) + k.varz)) == NULL)) {
+		return -1;
+	}
+	memcpy(e->var, k.var, k.varz);
+	e->h = h;
+	e->k = k;
+	e->k.var = e->var;
+	e->rb = gand_rbuf_ref(rb);
+	e->z = z;
+
+	pthread_mutex_lock(&rc_mtx);
+	if (*(ep = rc_find(h, k)) != NULL) {
+		/* someone beat us to it, or it's an older version */
+		rc_drop(ep);
+	}
+	e->next = *ep;
+	*ep = e;
+	rc_lru_push(e);
+	rc_st.nent++;
+	rc_st.curz += z;
+	rc_evict();
+	pthread_mutex_unlock(&rc_mtx);
+	return 0;
+}
+
+bool
+gand_rcache_fits_p(size_t z)
+{
+	return z < rc_maxz / RC_ENTDIV;
+}
+
+gand_rcache_stats_t
+gand_rcache_stats(void)
+{
+	gand_rcache_stats_t res;
+
+	pthread_mutex_lock(&rc_mtx);
+	res = rc_st;
+	pthread_mutex_unlock(&rc_mtx);
+	return res;
+}
+
+/* gand-rcache.c ends here */
@@ -0,0 +1,103 @@
+/*** gand-rcache.h -- in-memory cache of responses
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_rcache_h_
+#define INCLUDED_gand_rcache_h_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "httpd.h"
+
+/**
+ * Cache keys, like the ones of gand-zcache, ID, MTIM (and its NSEC)
+ * and SIZE identify the source file, VAR (of length VARZ) the variant
+ * of the response, e.g. output format, encoding and filter. */
+typedef struct {
+	unsigned int id;
+	time_t mtim;
+	long int nsec;
+	off_t size;
+	const void *var;
+	size_t varz;
+} gand_rkey_t;
+
+typedef struct {
+	/** lookups that found a current entry */
+	size_t hits;
+	/** lookups that didn't, stale entries included */
+	size_t misses;
+	/** entries dropped to stay within budget or because
+	 * their source file changed */
+	size_t evictions;
+	/** number of entries and their size in bytes */
+	size_t nent;
+	size_t curz;
+} gand_rcache_stats_t;
+
+
+/**
+ * Keep up to MAXZ bytes worth of responses in memory. */
+extern int gand_rcache_init(size_t maxz);
+
+/**
+ * Drop all entries. */
+extern void gand_rcache_fini(void);
+
+/**
+ * Return a reference to the response cached for KEY, or NULL if there
+ * is none or if the source file has changed since.
+ * The reference is to be dropped with free_gand_rbuf(), handing it to
+ * the httpd as DTYP_RBUF will do just that. */
+extern gand_rbuf_t gand_rcache_get(gand_rkey_t key);
+
+/**
+ * Keep (a reference to) RB as response for KEY, older entries for KEY
+ * are replaced and least recently used ones evicted as need be.
+ * RB must not be written to afterwards.
+ * Return -1 if RB isn't kept, e.g. because it's too big. */
+extern int gand_rcache_put(gand_rkey_t key, gand_rbuf_t rb);
+
+/**
+ * Return true if a response of Z bytes could be kept at all,
+ * false in particular if the cache is off. */
+extern bool gand_rcache_fits_p(size_t z);
+
+/**
+ * Return the cache's counters. */
+extern gand_rcache_stats_t gand_rcache_stats(void);
+
+#endif	/* INCLUDED_gand_rcache_h_ */
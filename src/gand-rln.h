@@ -0,0 +1,76 @@
+/*** gand-rln.h -- splitting series lines into fields
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_rln_h_
+#define INCLUDED_gand_rln_h_
+
+#include <stddef.h>
+
+typedef struct {
+	const char *s;
+	size_t z;
+} word_t;
+
+/* a series line (v0 format) is
+ * RID \t SYM \t TID \t DATE \t VALFLAV \t VALUE */
+struct rln_s {
+	word_t sym;
+	word_t dat;
+	word_t vrb;
+	word_t val;
+};
+
+
+/**
+ * Split line LN of LZ bytes (sans newline) into its fields, zero-copy.
+ * All fields are NULL if LN isn't a series line. */
+extern struct rln_s snarf_rln(const char *ln, size_t lz);
+
+/**
+ * Split up to N lines off the front of the Z bytes at D into R,
+ * like snarf_rln() would, and put the offset of the byte following
+ * each line (and its newline) into EOL, a trailing line without
+ * newline extends to Z.
+ * Return the number of lines split.
+ * Tabs and newlines are searched for 64 bytes at a time, using the
+ * widest vector unit the CPU has to offer. */
+extern size_t
+snarf_rlns(
+	struct rln_s *restrict r, size_t *restrict eol, size_t n,
+	const char *d, size_t z);
+
+#endif	/* INCLUDED_gand_rln_h_ */
+
@@ -0,0 +1,458 @@
+/*** gand-zcache.c -- on-disk cache of compressed responses
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Entries live in DIR/IIIIIIII/MMMMMMMM-SSSSSSSS-VVVVVVVVVVVVVVVV.gz
+ * with I the id, M and S the source file's mtime and size and V a hash
+ * of the variant.  A changed source file simply won't hit any more and
+ * its stale entries are removed as soon as a new one comes in.
+ * Entries are written to dot files first and renamed into place.
+ * Hits touch the entry, so evicting by mtime evicts the least recently
+ * used ones.  Eviction means scanning the whole tree, so that's done on
+ * the pool's threads. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "gand-zcache.h"
+#include "logger.h"
+#include "nifty.h"
+
+struct gand_zent_s {
+	gzFile gz;
+	/* source stamp, for purging */
+	gand_zkey_t k;
+	char tmp[80U];
+	char fin[80U];
+};
+
+static int zc_dirfd = -1;
+static size_t zc_maxz;
+/* current size of the cache */
+static size_t zc_curz;
+/* one eviction run at a time */
+static pthread_mutex_t zc_mtx = PTHREAD_MUTEX_INITIALIZER;
+/* where eviction runs, and whether one's queued there */
+static gand_pool_t zc_pool;
+static bool zc_evq;
+/* to tell temporary files apart */
+static unsigned int zc_tmpc;
+
+
+static int
+zc_stamp(char *restrict buf, size_t bsz, gand_zkey_t k)
+{
+	return snprintf(
+		buf, bsz, "%08lx-%08lx-%08llx-",
+		(unsigned long)k.mtim, (unsigned long)k.mtim_nsec,
+		(unsigned long long)k.size);
+}
+
+static int
+zc_name(char *restrict buf, size_t bsz, gand_zkey_t k)
+{
+	int z;
+
+	z = snprintf(buf, bsz, "%08u/", k.id);
+	z += zc_stamp(buf + z, bsz - z, k);
+	z += snprintf(
+		buf + z, bsz - z, "%016llx.gz",
+		(unsigned long long)fnv1a(FNV1A_BASIS, k.var, k.varz));
+	if (UNLIKELY(z < 0 || (size_t)z >= bsz)) {
+		return -1;
+	}
+	return z;
+}
+
+static size_t
+zc_scan(void(*cb)(int, const char*, const char*, const struct stat*, void*),
+	void *clo)
+{
+/* call CB for every file in every id dir, return the total size of
+ * all entries, temporary files don't count */
+	size_t tot = 0U;
+	DIR *d;
+	int fd;
+
+	if ((fd = openat(zc_dirfd, ".", O_RDONLY | O_DIRECTORY)) < 0) {
+		return 0U;
+	} else if ((d = fdopendir(fd)) == NULL) {
+		close(fd);
+		return 0U;
+	}
+	for (struct dirent *de; (de = readdir(d)) != NULL;) {
+		DIR *sd;
+		int sfd;
+
+		if (de->d_name[0U] == '.') {
+			continue;
+		} else if ((sfd = openat(
+				    zc_dirfd, de->d_name,
+				    O_RDONLY | O_DIRECTORY)) < 0) {
+			continue;
+		} else if ((sd = fdopendir(sfd)) == NULL) {
+			close(sfd);
+			continue;
+		}
+		for (struct dirent *se; (se = readdir(sd)) != NULL;) {
+			struct stat st;
+
+			if (!strcmp(se->d_name, ".") || !strcmp(se->d_name, "..")) {
+				continue;
+			} else if (fstatat(sfd, se->d_name, &st, 0) < 0) {
+				continue;
+			} else if (!S_ISREG(st.st_mode)) {
+				continue;
+			} else if (se->d_name[0U] != '.') {
+				tot += st.st_size;
+			}
+			if (cb != NULL) {
+				cb(sfd, de->d_name, se->d_name, &st, clo);
+			}
+		}
+		closedir(sd);
+	}
+	closedir(d);
+	return tot;
+}
+
+
+/* eviction */
+struct zc_cand_s {
+	time_t mtim;
+	off_t size;
+	char fn[80U];
+};
+
+struct zc_cands_s {
+	size_t n;
+	size_t z;
+	struct zc_cand_s *c;
+};
+
+static void
+zc_cand_cb(
+	int UNUSED(sfd), const char *sub, const char *fn,
+	const struct stat *st, void *clo)
+{
+	struct zc_cands_s *cs = clo;
+	struct zc_cand_s *c;
+
+	if (*fn == '.') {
+		/* someone's still writing this one */
+		return;
+	} else if (UNLIKELY(cs->n >= cs->z)) {
+		const size_t nuz = cs->z ? cs->z * 2U : 256U;
+		struct zc_cand_s *nu;
+
+		if ((nu = realloc(cs->c, nuz * sizeof(*nu))) == NULL) {
+			return;
+		}
+		cs->c = nu;
+		cs->z = nuz;
+	}
+	c = cs->c + cs->n;
+	if ((size_t)snprintf(c->fn, sizeof(c->fn), "%s/%s", sub, fn) >=
+	    sizeof(c->fn)) {
+		/* not one of ours */
+		return;
+	}
+	c->mtim = st->st_mtime;
+	c->size = st->st_size;
+	cs->n++;
+	return;
+}
+
+static int
+zc_cand_cmp(const void *a, const void *b)
+{
+	const struct zc_cand_s *ca = a;
+	const struct zc_cand_s *cb = b;
+
+	return (ca->mtim > cb->mtim) - (ca->mtim < cb->mtim);
+}
+
+static void
+zc_evict(void)
+{
+	struct zc_cands_s cs = {0U};
+	size_t tot;
+
+	if (pthread_mutex_trylock(&zc_mtx)) {
+		/* someone's on it already */
+		return;
+	}
+	if ((tot = zc_scan(zc_cand_cb, &cs)) > zc_maxz) {
+		/* go down to 7/8 of the maximum so we don't end up
+		 * evicting again with the next entry */
+		const size_t lwm = zc_maxz - zc_maxz / 8U;
+		size_t nev = 0U;
+
+		qsort(cs.c, cs.n, sizeof(*cs.c), zc_cand_cmp);
+		for (size_t i = 0U; i < cs.n && tot > lwm; i++) {
+			if (unlinkat(zc_dirfd, cs.c[i].fn, 0) < 0) {
+				continue;
+			}
+			tot -= cs.c[i].size;
+			nev++;
+		}
+		GAND_INFO_LOG(":zc evicted %zu entries", nev);
+	}
+	zc_curz = tot;
+	pthread_mutex_unlock(&zc_mtx);
+
+	if (cs.c != NULL) {
+		free(cs.c);
+	}
+	return;
+}
+
+static void
+zc_evict_task(void *UNUSED(clo))
+{
+	zc_evict();
+	__sync_lock_release(&zc_evq);
+	return;
+}
+
+static void
+zc_evict_bg(void)
+{
+/* have the pool evict, there's no point queuing a second run */
+	if (zc_pool == NULL) {
+		zc_evict();
+	} else if (__sync_lock_test_and_set(&zc_evq, true)) {
+		;
+	} else if (UNLIKELY(gand_pool_push(zc_pool, zc_evict_task, NULL) < 0)) {
+		__sync_lock_release(&zc_evq);
+		zc_evict();
+	}
+	return;
+}
+
+static void
+zc_purge(gand_zkey_t k)
+{
+/* remove K's id's entries whose stamp is not K's */
+	char sub[16U];
+	char stmp[48U];
+	size_t nstmp;
+	DIR *d;
+	int fd;
+
+	snprintf(sub, sizeof(sub), "%08u", k.id);
+	nstmp = zc_stamp(stmp, sizeof(stmp), k);
+	if ((fd = openat(zc_dirfd, sub, O_RDONLY | O_DIRECTORY)) < 0) {
+		return;
+	} else if ((d = fdopendir(fd)) == NULL) {
+		close(fd);
+		return;
+	}
+	for (struct dirent *de; (de = readdir(d)) != NULL;) {
+		struct stat st;
+
+		if (de->d_name[0U] == '.') {
+			continue;
+		} else if (!strncmp(de->d_name, stmp, nstmp)) {
+			/* current */
+			continue;
+		} else if (fstatat(fd, de->d_name, &st, 0) < 0) {
+			continue;
+		} else if (unlinkat(fd, de->d_name, 0) < 0) {
+			continue;
+		}
+		__sync_fetch_and_sub(&zc_curz, st.st_size);
+	}
+	closedir(d);
+	return;
+}
+
+static void
+zc_tmp_cb(
+	int sfd, const char *UNUSED(sub), const char *fn,
+	const struct stat *UNUSED(st), void *UNUSED(clo))
+{
+/* remove left-over temporaries */
+	if (*fn == '.') {
+		(void)unlinkat(sfd, fn, 0);
+	}
+	return;
+}
+
+
+/* public api */
+int
+gand_zcache_init(const char *dir, size_t maxz, gand_pool_t pool)
+{
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		return -1;
+	} else if ((zc_dirfd = open(dir, O_RDONLY | O_DIRECTORY)) < 0) {
+		return -1;
+	}
+	zc_maxz = maxz;
+	zc_pool = pool;
+	/* clean up after earlier runs and see what we've got */
+	if ((zc_curz = zc_scan(zc_tmp_cb, NULL)) > zc_maxz) {
+		zc_evict();
+	}
+	return 0;
+}
+
+void
+gand_zcache_fini(void)
+{
+	if (zc_dirfd >= 0) {
+		close(zc_dirfd);
+	}
+	zc_dirfd = -1;
+	zc_pool = NULL;
+	return;
+}
+
+int
+gand_zcache_get(gand_zkey_t k)
+{
+	char fn[80U];
+	int fd;
+
+	if (zc_dirfd < 0) {
+		return -1;
+	} else if (UNLIKELY(zc_name(fn, sizeof(fn), k) < 0)) {
+		return -1;
+	} else if ((fd = openat(zc_dirfd, fn, O_RDONLY)) < 0) {
+		return -1;
+	}
+	/* touch it, for the lru */
+	(void)futimens(fd, NULL);
+	return fd;
+}
+
+gand_zent_t
+gand_zcache_put(gand_zkey_t k)
+{
+	gand_zent_t e;
+	int fd;
+
+	if (zc_dirfd < 0) {
+		return NULL;
+	} else if (UNLIKELY((e = malloc(sizeof(*e))) == NULL)) {
+		return NULL;
+	} else if (UNLIKELY(zc_name(e->fin, sizeof(e->fin), k) < 0)) {
+		goto free;
+	}
+	/* make sure there's a dir for this id */
+	snprintf(e->tmp, sizeof(e->tmp), "%08u", k.id);
+	if (mkdirat(zc_dirfd, e->tmp, 0755) < 0 && errno != EEXIST) {
+		goto free;
+	}
+	snprintf(e->tmp, sizeof(e->tmp), "%08u/.%08x.tmp",
+		 k.id, __sync_fetch_and_add(&zc_tmpc, 1U));
+	if ((fd = openat(
+		     zc_dirfd, e->tmp,
+		     O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0644)) < 0) {
+		goto free;
+	} else if ((e->gz = gzdopen(fd, "wb")) == NULL) {
+		close(fd);
+		(void)unlinkat(zc_dirfd, e->tmp, 0);
+		goto free;
+	}
+	/* the variant was only needed for the name */
+	e->k = k;
+	e->k.var = NULL;
+	e->k.varz = 0U;
+	return e;
+
+free:
+	free(e);
+	return NULL;
+}
+
+int
+gand_zcache_write(gand_zent_t e, const void *p, size_t z)
+{
+	if (UNLIKELY(z > 0U && gzwrite(e->gz, p, z) <= 0)) {
+		return -1;
+	}
+	return 0;
+}
+
+int
+gand_zcache_commit(gand_zent_t e)
+{
+	struct stat st;
+
+	if (UNLIKELY(gzclose(e->gz) != Z_OK)) {
+		goto unl;
+	} else if (fstatat(zc_dirfd, e->tmp, &st, 0) < 0) {
+		goto unl;
+	} else if (renameat(zc_dirfd, e->tmp, zc_dirfd, e->fin) < 0) {
+		goto unl;
+	}
+	/* entries of older versions of the source can go */
+	zc_purge(e->k);
+	if (__sync_add_and_fetch(&zc_curz, st.st_size) > zc_maxz) {
+		zc_evict_bg();
+	}
+	free(e);
+	return 0;
+
+unl:
+	(void)unlinkat(zc_dirfd, e->tmp, 0);
+	free(e);
+	return -1;
+}
+
+void
+gand_zcache_abort(gand_zent_t e)
+{
+	(void)gzclose(e->gz);
+	(void)unlinkat(zc_dirfd, e->tmp, 0);
+	free(e);
+	return;
+}
+
+/* gand-zcache.c ends here */
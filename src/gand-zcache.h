@@ -0,0 +1,97 @@
+/*** gand-zcache.h -- on-disk cache of compressed responses
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_gand_zcache_h_
+#define INCLUDED_gand_zcache_h_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "gand-pool.h"
+
+/**
+ * Cache keys, ID, MTIM, MTIM_NSEC and SIZE identify the source file,
+ * VAR (of length VARZ) the variant of the response derived from it,
+ * e.g. output format and filter. */
+typedef struct {
+	unsigned int id;
+	time_t mtim;
+	/* rewrites within the same second may keep the size but not this */
+	long int mtim_nsec;
+	off_t size;
+	const void *var;
+	size_t varz;
+} gand_zkey_t;
+
+/* cache entries in the making */
+typedef struct gand_zent_s *gand_zent_t;
+
+
+/**
+ * Use directory DIR for the cache and keep it below MAXZ bytes,
+ * evicting on the threads of POOL, or on the caller's if POOL is NULL.
+ * Return -1 if DIR cannot be used. */
+extern int gand_zcache_init(const char *dir, size_t maxz, gand_pool_t pool);
+
+/**
+ * Release resources held by the cache. */
+extern void gand_zcache_fini(void);
+
+/**
+ * Return a file descriptor to the gzip'd data cached for KEY,
+ * or -1 if there is none. */
+extern int gand_zcache_get(gand_zkey_t key);
+
+/**
+ * Start a new cache entry for KEY, the data written to it will be
+ * compressed on the fly.  Return NULL if caching is off. */
+extern gand_zent_t gand_zcache_put(gand_zkey_t key);
+
+/**
+ * Append Z bytes from P to cache entry E. */
+extern int gand_zcache_write(gand_zent_t e, const void *p, size_t z);
+
+/**
+ * Finish entry E and make it available to gand_zcache_get().
+ * Older entries for the same id but a different source file are
+ * removed, and least recently used ones in the background if the
+ * cache grew too big. */
+extern int gand_zcache_commit(gand_zent_t e);
+
+/**
+ * Discard entry E. */
+extern void gand_zcache_abort(gand_zent_t e);
+
+#endif	/* INCLUDED_gand_zcache_h_ */
@@ -41,12 +41,15 @@
 # include "version.h"
 #endif	/* HAVE_VERSION_H */
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #if defined HAVE_EV_H
 # include <ev.h>
 #endif	/* HAVE_EV_H */
@@ -55,6 +58,17 @@
 #include "gand-cfg.h"
 #include "logger.h"
 #include "fops.h"
+#include "gand-rcache.h"
+#include "gand-dict-cache.h"
+#include "gand-didx.h"
+#include "gand-rln.h"
+#include "gand-col.h"
+#include "gand-arrow.h"
+#include "gand-pool.h"
+#include "gand-aio.h"
+#if defined HAVE_ZLIB_H
+# include "gand-zcache.h"
+#endif	/* HAVE_ZLIB_H */
 #include "nifty.h"
 
 #if defined __INTEL_COMPILER
@@ -64,19 +78,21 @@
 #undef EV_P
 #define EV_P  struct ev_loop *loop __attribute__((unused))
 
-typedef struct {
-	const char *s;
-	size_t z;
-} word_t;
-
-struct rln_s {
-	word_t sym;
-	word_t dat;
-	word_t vrb;
-	word_t val;
-};
-
 static dict_t gsymdb;
+#if defined USE_MPH
+/* the mmapped index is read lock-free, readers announce themselves in
+ * the counter of the current generation, reloads swap gsymdb, bump the
+ * generation and wait for the readers of the old one to leave */
+static volatile unsigned int gsymdb_gen;
+static volatile unsigned int gsymdb_nrd[2U];
+#elif defined USE_VIRTUOSO
+/* the backend pools its connections and may be used concurrently,
+ * lookups only have to be kept away from reloads */
+static pthread_rwlock_t gsymdb_rwl = PTHREAD_RWLOCK_INITIALIZER;
+#else  /* !USE_MPH && !USE_VIRTUOSO */
+/* guards gsymdb against concurrent workers and reloads */
+static pthread_mutex_t gsymdb_mtx = PTHREAD_MUTEX_INITIALIZER;
+#endif	/* USE_MPH */
 static int trolf_dirfd;
 
 
@@ -167,7 +183,7 @@ xmemmem(const char *hay, const size_t hz, const char *ndl, const size_t nz)
 static const char*
 make_lateglu_name(dict_oid_t rid)
 {
-	static char f[PATH_MAX] = "show_lateglu/";
+	static __thread char f[PATH_MAX] = "show_lateglu/";
 	int x;
 
 	x = snprintf(f + 13U, sizeof(f) - 13U, "%04u/%08u", rid / 10000U, rid);
@@ -180,7 +196,7 @@ make_lateglu_name(dict_oid_t rid)
 static __attribute__((unused)) const char*
 make_super_name(dict_oid_t rid)
 {
-	static char f[PATH_MAX] = "super/";
+	static __thread char f[PATH_MAX] = "super/";
 	int x;
 
 	x = snprintf(f + 6U, sizeof(f) - 6U, "%04u/%08u", rid / 10000U, rid);
@@ -190,62 +206,86 @@ make_super_name(dict_oid_t rid)
 	return f;
 }
 
-static struct rln_s
-snarf_rln(const char *ln, size_t lz)
+static dict_t
+gsymdb_acq(unsigned int *gen)
 {
-	struct rln_s r;
-	const char *p;
-
-	/* normally first up is the rolf-id, overread him */
-	if (UNLIKELY((p = memchr(ln, '\t', lz)) == NULL)) {
-		goto b0rk;
-	}
+/* obtain gsymdb for reading, pass GEN to gsymdb_rel() when done */
+#if defined USE_MPH
+	unsigned int g;
+
+	for (;;) {
+		g = gsymdb_gen;
+		__sync_fetch_and_add(gsymdb_nrd + (g & 1U), 1U);
+		if (LIKELY(g == gsymdb_gen)) {
+			break;
+		}
+		/* a reload came in between */
+		__sync_fetch_and_sub(gsymdb_nrd + (g & 1U), 1U);
+	}
+	*gen = g;
+	__sync_synchronize();
+#elif defined USE_VIRTUOSO
+	*gen = 0U;
+	pthread_rwlock_rdlock(&gsymdb_rwl);
+#else  /* !USE_MPH && !USE_VIRTUOSO */
+	*gen = 0U;
+	pthread_mutex_lock(&gsymdb_mtx);
+#endif	/* USE_MPH */
+	return gsymdb;
+}
 
-	/* snarf sym */
-	r.sym.s = ++p;
-	/* find separator between symbol and trans-id */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
-	r.sym.z = p++ - r.sym.s;
+static void
+gsymdb_rel(unsigned int gen)
+{
+#if defined USE_MPH
+	__sync_fetch_and_sub(gsymdb_nrd + (gen & 1U), 1U);
+#elif defined USE_VIRTUOSO
+	(void)gen;
+	pthread_rwlock_unlock(&gsymdb_rwl);
+#else  /* !USE_MPH && !USE_VIRTUOSO */
+	(void)gen;
+	pthread_mutex_unlock(&gsymdb_mtx);
+#endif	/* USE_MPH */
+	return;
+}
 
-	/* find separator between trans-id and date stamp */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
-	}
+static dict_oid_t
+gsymdb_get_sym(const char *sym)
+{
+	const unsigned int tag = dict_cache_tag();
+	unsigned int gen;
+	dict_oid_t rid;
 
-	/* snarf date */
-	r.dat.s = ++p;
-	/* find separator between date stamp and valflav aka verb */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
+	if ((rid = dict_cache_get(sym)) != DICT_CACHE_NONE) {
+		return rid;
 	}
-	r.dat.z = p++ - r.dat.s;
-
-	/* snarf valflav aka verb */
-	r.vrb.s = p;
-	/* find separator between date stamp and valflav aka verb */
-	if (UNLIKELY((p = memchr(p, '\t', ln + lz - p)) == NULL)) {
-		goto b0rk;
+	rid = dict_get_sym(gsymdb_acq(&gen), sym);
+	gsymdb_rel(gen);
+	if (LIKELY(rid != ERR_OID)) {
+		dict_cache_put(sym, rid, tag);
 	}
-	r.vrb.z = p++ - r.vrb.s;
-
-	/* snarf value */
-	r.val.s = p;
-	r.val.z = ln + lz - p;
-
-	/* that's all */
-	return r;
-
-b0rk:
-	return (struct rln_s){NULL};
+	return rid;
 }
 
-
+
 /* filter routines */
-typedef word_t flt_t;
+typedef struct flt_s *flt_t;
 static const flt_t nul_flt;
 
+/* valflav filters are hashed once per request */
+#define FLT_NSLOT	(256U)
+struct flt_s {
+	/* the filter string, \nul-separated and -framed,
+	 * NULL if there's no filter at all */
+	word_t str;
+	char buf[FLT_NSLOT];
+	/* open addressing, at most every other slot is taken */
+	word_t tbl[FLT_NSLOT];
+	/* the valflav last looked up and whether it matched */
+	word_t run;
+	bool runp;
+};
+
 #define FILTER_LAST_INDICATOR	((const void*)0xdeadU)
 #define FILTER_FRST_INDICATOR	((const void*)0xcafeU)
 static const struct rln_s FILTER_FRST = {
@@ -255,32 +295,77 @@ static const struct rln_s FILTER_LAST = {
 	.sym = {.s = FILTER_LAST_INDICATOR},
 };
 
+static inline unsigned int
+flt_hash(word_t w)
+{
+	const uint64_t h = fnv1a(FNV1A_BASIS, w.s, w.z);
+
+	return (unsigned int)(h ^ h >> 32U);
+}
+
+static word_t*
+flt_slot(flt_t f, word_t w)
+{
+/* return W's slot in F, or the empty slot it would go to */
+	for (unsigned int i = flt_hash(w);; i++) {
+		word_t *const x = f->tbl + (i % FLT_NSLOT);
+
+		if (x->s == NULL) {
+			return x;
+		} else if (x->z == w.z && !memcmp(x->s, w.s, w.z)) {
+			return x;
+		}
+	}
+}
+
+static void
+flt_compile(flt_t f)
+{
+/* hash the valflavs in F's filter string */
+	for (const char *fp = f->str.s + 1U, *const ef = f->str.s + f->str.z,
+		     *eow; fp < ef; fp = eow + 1U) {
+		word_t w;
+
+		eow = fp + strlen(fp);
+		if ((w = (word_t){fp, eow - fp}).z) {
+			*flt_slot(f, w) = w;
+		}
+	}
+	return;
+}
+
 static bool
 flt_matches_p(flt_t f, word_t w)
 {
-	if (f.s == NULL) {
+	if (f == NULL || f->str.s == NULL) {
 		/* everything matches the trivial filter */
 		return true;
-	} else if (f.z == 0U) {
-		/* nothing matches the other trivial filter */
-		return false;
-	}
-	/* otherwise it's a non-trivial filter  */
-	for (const char *fp = f.s, *const ef = f.s + f.z;
-	     fp < ef && (fp = xmemmem(fp, ef - fp, w.s, w.z)) != NULL; fp++) {
-		/* check word boundary */
-		if (fp[-1] == '\0' && fp[w.z] == '\0') {
-			/* perfick */
-			return true;
-		}
+	} else if (w.z == f->run.z && !memcmp(w.s, f->run.s, w.z)) {
+		/* same valflav as last time */
+		return f->runp;
 	}
-	return false;
+	f->run = w;
+	return f->runp = flt_slot(f, w)->s != NULL;
 }
 
-static ssize_t
-filter_csv(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
+/* column selection, columns are always output in this order */
+#define SEL_SYM		(1U << 0U)
+#define SEL_DAT		(1U << 1U)
+#define SEL_VRB		(1U << 2U)
+#define SEL_VAL		(1U << 3U)
+#define SEL_ALL		(SEL_SYM | SEL_DAT | SEL_VRB | SEL_VAL)
+
+typedef ssize_t(*filter_f)(
+	char *restrict, size_t, struct rln_s, flt_t, struct rln_s *restrict);
+
+static __inline __attribute__((always_inline)) ssize_t
+_filter_csv(
+	char *restrict scratch, size_t z, struct rln_s r, flt_t f,
+	const unsigned int sel)
 {
+/* SEL is constant in all callers, so unselected columns cost nothing */
 	char *sp = scratch;
+	size_t spc_needed = 0U;
 
 	if (0) {
 		;
@@ -299,10 +384,20 @@ filter_csv(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 		return -1;
 	} else if (UNLIKELY(r.val.s == NULL)) {
 		return -1;
-	} else if (UNLIKELY(r.sym.z + 1U/*\t*/ +
-			    r.dat.z + 1U/*\t*/ +
-			    r.vrb.z + 1U/*\t*/ +
-			    r.val.z + 1U/*\n*/ >= z)) {
+	}
+	if (sel & SEL_SYM) {
+		spc_needed += r.sym.z + 1U/*\t*/;
+	}
+	if (sel & SEL_DAT) {
+		spc_needed += r.dat.z + 1U/*\t*/;
+	}
+	if (sel & SEL_VRB) {
+		spc_needed += r.vrb.z + 1U/*\t*/;
+	}
+	if (sel & SEL_VAL) {
+		spc_needed += r.val.z + 1U/*\n*/;
+	}
+	if (UNLIKELY(spc_needed >= z)) {
 		/* request a bigger buffer */
 		return -2;
 	}
@@ -314,33 +409,43 @@ filter_csv(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 		return 0;
 	}
 
-	/* now copy over sym, dat, vrb and val */
-	memcpy(sp, r.sym.s, r.sym.z);
-	sp += r.sym.z;
-	*sp++ = '\t';
-
-	memcpy(sp, r.dat.s, r.dat.z);
-	sp += r.dat.z;
-	*sp++ = '\t';
-
-	memcpy(sp, r.vrb.s, r.vrb.z);
-	sp += r.vrb.z;
-	*sp++ = '\t';
-
-	memcpy(sp, r.val.s, r.val.z);
-	sp += r.val.z;
-	*sp++ = '\n';
+	/* now copy over the selected ones of sym, dat, vrb and val */
+	if (sel & SEL_SYM) {
+		memcpy(sp, r.sym.s, r.sym.z);
+		sp += r.sym.z;
+		*sp++ = '\t';
+	}
+	if (sel & SEL_DAT) {
+		memcpy(sp, r.dat.s, r.dat.z);
+		sp += r.dat.z;
+		*sp++ = '\t';
+	}
+	if (sel & SEL_VRB) {
+		memcpy(sp, r.vrb.s, r.vrb.z);
+		sp += r.vrb.z;
+		*sp++ = '\t';
+	}
+	if (sel & SEL_VAL) {
+		memcpy(sp, r.val.s, r.val.z);
+		sp += r.val.z;
+		*sp++ = '\t';
+	}
+	/* the last separator terminates the line */
+	sp[-1] = '\n';
 
 	return sp - scratch;
 }
 
-static ssize_t
-filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
+static __inline __attribute__((always_inline)) ssize_t
+_filter_json(
+	char *restrict scratch, size_t z, struct rln_s r, flt_t f,
+	struct rln_s *restrict prev, const unsigned int sel)
 {
-	static struct rln_s prev;
+/* like _filter_csv(), unselected syms and dates don't open groups */
 	char *restrict sp = scratch;
 	size_t spc_needed = 0U;
 	unsigned int flags = 0U;
+	bool frst;
 
 	if (0) {
 		;
@@ -348,22 +453,28 @@ filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 		*sp++ = '[';
 		return sp - scratch;
 	} else if (UNLIKELY(r.sym.s == FILTER_LAST_INDICATOR)) {
-		if (LIKELY(prev.sym.s != NULL)) {
+		if (LIKELY(prev->sym.s != NULL)) {
 			if (UNLIKELY(z < 10U)) {
 				return -2;
 			}
 			/* clear out prev */
-			memset(&prev, 0, sizeof(prev));
+			memset(prev, 0, sizeof(*prev));
 			/* finalise dat indentation */
 			*sp++ = '\n';
-			*sp++ = ' ';
-			*sp++ = ' ';
-			*sp++ = ']';
-			*sp++ = '}';
-			*sp++ = '\n';
+			if (sel & SEL_DAT) {
+				*sp++ = ' ';
+				*sp++ = ' ';
+				*sp++ = ']';
+				*sp++ = '}';
+			}
+			if (sel & SEL_DAT && sel & SEL_SYM) {
+				*sp++ = '\n';
+			}
 			/* finalise sym */
-			*sp++ = ']';
-			*sp++ = '}';
+			if (sel & SEL_SYM) {
+				*sp++ = ']';
+				*sp++ = '}';
+			}
 		}
 		if (UNLIKELY(z < 2U)) {
 			return -2;
@@ -391,21 +502,32 @@ filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 		return 0;
 	}
 
-	if (prev.sym.s == NULL || memcmp(prev.sym.s, r.sym.s, r.sym.z)) {
+	if (!(sel & SEL_SYM)) {
+		;
+	} else if (prev->sym.s == NULL || prev->sym.z != r.sym.z ||
+		   memcmp(prev->sym.s, r.sym.s, r.sym.z)) {
 		spc_needed += r.sym.z + 2U/*quot*/ + sizeof("[{\"sym\":}]") +
-			sizeof("[\"data:]\"");
+			sizeof("[\"data:]\"") + sizeof("\n  ]}\n]},\n");
 		flags |= 0b01U;
 	}
 
-	if (prev.dat.s == NULL || memcmp(prev.dat.s, r.dat.s, r.dat.z)) {
+	if (!(sel & SEL_DAT)) {
+		;
+	} else if (flags & 0b01U ||
+		   prev->dat.s == NULL || prev->dat.z != r.dat.z ||
+		   memcmp(prev->dat.s, r.dat.s, r.dat.z)) {
 		spc_needed += r.dat.z + 2U/*quot*/ + sizeof("  {\"dat\":[]}") +
 			sizeof("[\"data:]\"");
 		flags |= 0b10U;
 	}
 
 	/* definitely need the verb and value space */
-	spc_needed += r.vrb.z + 2U/*quot*/ + sizeof("    {\"vrb\":}");
-	spc_needed += r.val.z + 2U/*quot*/ + sizeof("    {\"val\":}");
+	if (sel & SEL_VRB) {
+		spc_needed += r.vrb.z + 2U/*quot*/ + sizeof("    {\"vrb\":}");
+	}
+	if (sel & SEL_VAL) {
+		spc_needed += r.val.z + 2U/*quot*/ + sizeof("    {\"val\":}");
+	}
 
 	if (UNLIKELY(spc_needed + 3U/*separators*/ >= z)) {
 		/* request a bigger buffer */
@@ -414,6 +536,14 @@ filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 
 #define LITCPY(x, lit)	(memcpy(x, lit, sizeof(lit) - 1U), sizeof(lit) - 1U)
 #define BUFCPY(x, d, z)	(memcpy(x, d, z), z)
+	if (flags & 0b01U && prev->sym.s != NULL) {
+		/* new sym (bulk requests), close the previous one */
+		*sp++ = '\n';
+		if (sel & SEL_DAT) {
+			sp += LITCPY(sp, "  ]}\n");
+		}
+		sp += LITCPY(sp, "]},\n");
+	}
 	if (flags & 0b01U) {
 		/* copy symbol */
 		*sp++ = '{';
@@ -426,7 +556,7 @@ filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 	}
 
 	if (flags & 0b10U) {
-		if (prev.dat.s) {
+		if (prev->dat.s && !(flags & 0b01U)) {
 			*sp++ = '\n';
 			*sp++ = ' ';
 			*sp++ = ' ';
@@ -447,35 +577,100 @@ filter_json(char *restrict scratch, size_t z, struct rln_s r, flt_t f)
 		sp += LITCPY(sp, "\"data\":[");
 	}
 
+	/* keep a note about this line */
+	frst = prev->sym.s == NULL;
+	*prev = r;
+	if (!(sel & (SEL_VRB | SEL_VAL))) {
+		/* no pairs to speak of */
+		return sp - scratch;
+	}
+
 	/* now copy over vrb/val pairs */
-	if (!(flags & 0b10U)) {
+	if (flags & 0b10U) {
+		/* first one in this date */
+		*sp++ = '\n';
+	} else if (flags & 0b01U) {
+		/* first one in this sym, newline's already there */
+		;
+	} else if (frst) {
+		/* first one altogether, no groups */
+		*sp++ = '\n';
+	} else {
 		*sp++ = ',';
-	}	*sp++ = '\n';
+		*sp++ = '\n';
+	}
 
 	*sp++ = ' ';
 	*sp++ = ' ';
 	*sp++ = ' ';
 	*sp++ = ' ';
-	*sp++ = '{';
-	sp += LITCPY(sp, "\"vrb\":");
-	*sp++ = '"';
-	sp += BUFCPY(sp, r.vrb.s, r.vrb.z);
-	*sp++ = '"';
-	*sp++ = '}';
-	*sp++ = ',';
-	*sp++ = '{';
-	sp += LITCPY(sp, "\"value\":");
-	*sp++ = '"';
-	sp += BUFCPY(sp, r.val.s, r.val.z);
-	*sp++ = '"';
-	*sp++ = '}';
-
-	/* keep a note about this line */
-	prev = r;
+	if (sel & SEL_VRB) {
+		*sp++ = '{';
+		sp += LITCPY(sp, "\"vrb\":");
+		*sp++ = '"';
+		sp += BUFCPY(sp, r.vrb.s, r.vrb.z);
+		*sp++ = '"';
+		*sp++ = '}';
+	}
+	if (sel & SEL_VRB && sel & SEL_VAL) {
+		*sp++ = ',';
+	}
+	if (sel & SEL_VAL) {
+		*sp++ = '{';
+		sp += LITCPY(sp, "\"value\":");
+		*sp++ = '"';
+		sp += BUFCPY(sp, r.val.s, r.val.z);
+		*sp++ = '"';
+		*sp++ = '}';
+	}
 	return sp - scratch;
 }
 
-
+/* one filter per column selection */
+#define FILTER_SEL(_x_)							\
+static ssize_t								\
+filter_csv_ ## _x_(							\
+	char *restrict scratch, size_t z, struct rln_s r, flt_t f,	\
+	struct rln_s *restrict UNUSED(prev))				\
+{									\
+	return _filter_csv(scratch, z, r, f, _x_);			\
+}									\
+									\
+static ssize_t								\
+filter_json_ ## _x_(							\
+	char *restrict scratch, size_t z, struct rln_s r, flt_t f,	\
+	struct rln_s *restrict prev)					\
+{									\
+	return _filter_json(scratch, z, r, f, prev, _x_);		\
+}
+
+FILTER_SEL(1)
+FILTER_SEL(2)
+FILTER_SEL(3)
+FILTER_SEL(4)
+FILTER_SEL(5)
+FILTER_SEL(6)
+FILTER_SEL(7)
+FILTER_SEL(8)
+FILTER_SEL(9)
+FILTER_SEL(10)
+FILTER_SEL(11)
+FILTER_SEL(12)
+FILTER_SEL(13)
+FILTER_SEL(14)
+FILTER_SEL(15)
+
+#define FILTER_TBL(_f_)							\
+	{								\
+		NULL, _f_ ## 1, _f_ ## 2, _f_ ## 3,			\
+		_f_ ## 4, _f_ ## 5, _f_ ## 6, _f_ ## 7,			\
+		_f_ ## 8, _f_ ## 9, _f_ ## 10, _f_ ## 11,		\
+		_f_ ## 12, _f_ ## 13, _f_ ## 14, _f_ ## 15,		\
+	}
+static const filter_f filter_csv[] = FILTER_TBL(filter_csv_);
+static const filter_f filter_json[] = FILTER_TBL(filter_json_);
+
+
 /* rolf <-> onion glue */
 typedef enum {
 	EP_UNK,
@@ -490,12 +685,16 @@ typedef enum {
 	OF_CSV,
 	OF_JSON,
 	OF_HTML,
+	OF_COL,
+	OF_ARROW,
 } gand_of_t;
 
 static const char _ofs_UNK[] = "text/plain";
 static const char _ofs_JSON[] = "application/json";
 static const char _ofs_CSV[] = "text/csv";
 static const char _ofs_HTML[] = "text/html";
+static const char _ofs_COL[] = "application/x-gandalf-columnar";
+static const char _ofs_ARROW[] = "application/vnd.apache.arrow.stream";
 #define OF(_x_)		(_ofs_ ## _x_)
 
 static const char *const _ofs[] = {
@@ -503,6 +702,8 @@ static const char *const _ofs[] = {
 	[OF_JSON] = OF(JSON),
 	[OF_CSV] = OF(CSV),
 	[OF_HTML] = OF(HTML),
+	[OF_COL] = OF(COL),
+	[OF_ARROW] = OF(ARROW),
 };
 
 static const char _eps_V0_SERIES[] = "/v0/series";
@@ -528,162 +729,1809 @@ __gand_ep(const char *s, size_t z)
 	} else if (!memcmp(EP(V0_FILES), s, sizeof(EP(V0_FILES)) - 1U)) {
 		return EP_V0_FILES;
 	}
-	return EP_UNK;
+	return EP_UNK;
+}
+
+static gand_of_t
+__gand_of(const char *s, size_t z)
+{
+	if (z < sizeof(OF(CSV)) - 1U) {
+		;
+	} else if (!memcmp(OF(CSV), s, sizeof(OF(CSV)) - 1U)) {
+		return OF_CSV;
+	} else if (z < sizeof(OF(JSON)) - 1U) {
+		;
+	} else if (!memcmp(OF(JSON), s, sizeof(OF(JSON)) - 1U)) {
+		return OF_JSON;
+	} else if (z < sizeof(OF(COL)) - 1U) {
+		;
+	} else if (!memcmp(OF(COL), s, sizeof(OF(COL)) - 1U)) {
+		return OF_COL;
+	} else if (z < sizeof(OF(ARROW)) - 1U) {
+		;
+	} else if (!memcmp(OF(ARROW), s, sizeof(OF(ARROW)) - 1U)) {
+		return OF_ARROW;
+	}
+	return OF_UNK;
+}
+
+static __attribute__((const, pure)) gand_ep_t
+req_get_endpoint(gand_httpd_req_t req)
+{
+	const char *cmd;
+	size_t cmz;
+
+	if (UNLIKELY((cmd = req.path) == NULL)) {
+		return EP_UNK;
+	} else if (UNLIKELY((cmz = strlen(cmd)) == 0U)) {
+		return EP_UNK;
+	} else if (UNLIKELY(cmz == 1U && *cmd == '/')) {
+		return EP_V0_MAIN;
+	}
+	return __gand_ep(cmd, cmz);
+}
+
+static gand_of_t
+req_get_outfmt(gand_httpd_req_t req)
+{
+	gand_word_t acc = gand_req_get_xhdr(req, "Accept");
+	gand_of_t of = OF_UNK;
+	const char *on;
+
+	if (UNLIKELY(acc.str == NULL)) {
+		return OF_UNK;
+	}
+	/* otherwise */
+	do {
+		if ((on = strchr(acc.str, ',')) != NULL) {
+			acc.len = on++ - acc.str;
+		}
+		/* check if there's semicolon specs */
+		with (const char *sc = strchr(acc.str, ';')) {
+			if (sc && on && sc < on || sc) {
+				acc.len = sc - acc.str;
+			}
+		}
+
+		if (LIKELY((of = __gand_of(acc.str, acc.len)) != OF_UNK)) {
+			/* first one wins */
+			break;
+		}
+	} while ((acc.str = on));
+	return of;
+}
+
+static void
+ser_get_filter(flt_t f, gand_httpd_req_t r)
+{
+	static const char Qf[] = "filter";
+	char *const _f = f->buf;
+	const size_t fz = sizeof(f->buf);
+	gand_word_t w;
+
+	if ((w = gand_req_get_xqry(r, Qf)).str == NULL) {
+		/* just go with the flow */
+		f->str = (word_t){NULL};
+		return;
+	} else if ((w.str += sizeof(Qf), w.len -= sizeof(Qf), false)) {
+		/* not reached */
+		;
+	} else if (w.len > fz - 2U) {
+		GAND_ERR_LOG("filter string too long, truncating?");
+		w.len = fz - 2U;
+	}
+	_f[0U] = '\0';
+	memcpy(_f + 1U, w.str, w.len);
+	_f[1U + w.len] = '\0';
+	/* massage the filter string a little */
+	for (char *fp = _f + 1U, *const ef = fp + w.len; fp < ef; fp++) {
+		if (*fp == ',') {
+			*fp = '\0';
+		}
+	}
+	f->str = (word_t){_f, w.len + 2U};
+	flt_compile(f);
+	return;
+}
+
+static unsigned int
+ser_get_sel(gand_httpd_req_t r)
+{
+/* turn select=COL[,...] into a SEL_* mask, all columns by default */
+	static const char Qs[] = "select";
+	static const struct {
+		const char *col;
+		unsigned int sel;
+	} cols[] = {
+		{"sym", SEL_SYM},
+		{"d", SEL_DAT}, {"dat", SEL_DAT}, {"date", SEL_DAT},
+		{"vf", SEL_VRB}, {"vrb", SEL_VRB}, {"valflav", SEL_VRB},
+		{"v", SEL_VAL}, {"val", SEL_VAL}, {"value", SEL_VAL},
+	};
+	unsigned int sel = 0U;
+	gand_word_t w;
+
+	if ((w = gand_req_get_xqry(r, Qs)).str == NULL) {
+		return SEL_ALL;
+	}
+	w.str += sizeof(Qs), w.len -= sizeof(Qs);
+	for (const char *cp = w.str, *const ep = w.str + w.len, *on;
+	     cp < ep; cp = on + 1U) {
+		size_t cz;
+
+		if ((on = memchr(cp, ',', ep - cp)) == NULL) {
+			on = ep;
+		}
+		cz = on - cp;
+		for (size_t i = 0U; i < countof(cols); i++) {
+			if (strlen(cols[i].col) == cz &&
+			    !memcmp(cols[i].col, cp, cz)) {
+				sel |= cols[i].sel;
+				break;
+			}
+		}
+	}
+	if (UNLIKELY(!sel)) {
+		GAND_ERR_LOG("no known columns selected, selecting all");
+		return SEL_ALL;
+	}
+	return sel;
+}
+
+static size_t
+ser_get_date(char *restrict buf, size_t bsz, gand_httpd_req_t r, const char *q)
+{
+/* copy the date of query parameter Q (with =) to BUF */
+	gand_word_t w;
+	size_t qz = strlen(q);
+
+	if ((w = gand_req_get_xqry(r, q)).str == NULL) {
+		w.len = 0U;
+	} else if ((w.str += qz, w.len -= qz) >= bsz) {
+		GAND_ERR_LOG("date string too long, ignoring");
+		w.len = 0U;
+	} else {
+		memcpy(buf, w.str, w.len);
+	}
+	buf[w.len] = '\0';
+	return w.len;
+}
+
+static int
+ser_datcmp(word_t dat, const char *d, size_t dz)
+{
+/* compare line date DAT to date D, lines with finer stamps
+ * (e.g. times) than D compare equal when on the same day */
+	int c;
+
+	if (UNLIKELY(dat.s == NULL)) {
+		/* b0rked lines go first */
+		return -1;
+	} else if ((c = memcmp(dat.s, d, dat.z < dz ? dat.z : dz))) {
+		return c;
+	}
+	return dat.z < dz ? -1 : 0;
+}
+
+static size_t
+ser_bisect(gandf_t fb, size_t lo, size_t hi, const char *d, bool after)
+{
+/* return the offset of the first line in [LO, HI) dated D or later,
+ * or, if AFTER is set, later than D, LO and HI are line boundaries
+ * lines are date-ordered so only log(n) lines (and pages) are touched */
+	const char *const dp = (const char*)fb.d;
+	const size_t dz = strlen(d);
+
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2U;
+		size_t bol, nxt;
+		const char *eol;
+		int c;
+
+		/* rewind to the beginning of MID's line */
+		for (bol = mid; bol > lo && dp[bol - 1U] != '\n'; bol--);
+		if ((eol = memchr(dp + bol, '\n', hi - bol)) == NULL) {
+			eol = dp + hi;
+			nxt = hi;
+		} else {
+			nxt = eol - dp + 1U;
+		}
+		c = ser_datcmp(snarf_rln(dp + bol, eol - (dp + bol)).dat, d, dz);
+		if (c < 0 || (after && c == 0)) {
+			lo = nxt;
+		} else {
+			hi = bol;
+		}
+	}
+	return lo;
+}
+
+static size_t
+ser_last(gandf_t fb, size_t lo, size_t hi, size_t n)
+{
+/* return the offset of the N-th last line in [LO, HI), N > 0,
+ * scanning backwards so only the tail pages are touched */
+	const char *const dp = (const char*)fb.d;
+	size_t i = hi;
+
+	if (i > lo && dp[i - 1U] == '\n') {
+		/* the last line's own newline */
+		i--;
+	}
+	for (; i > lo; i--) {
+		if (dp[i - 1U] == '\n' && !--n) {
+			break;
+		}
+	}
+	return i;
+}
+
+static void
+subst_rln(struct rln_s *restrict r, const char *host)
+{
+	static __thread char *scratch;
+	static __thread size_t zcratch;
+	static __thread size_t scroff;
+
+	if (UNLIKELY(host == NULL)) {
+		/* reset request */
+		scroff = 0U;
+		return;
+	}
+	if (UNLIKELY(!scroff)) {
+		/* construct URI prefix */
+		size_t hlen = strlen(host);
+
+		if (7U + hlen + sizeof(_eps_V0_FILES) + r->val.z > zcratch) {
+			zcratch = 7U + hlen + sizeof(_eps_V0_FILES) + r->val.z;
+			zcratch += 64U;
+			zcratch &= ~(64U - 1U);
+
+			scratch = realloc(scratch, zcratch);
+		}
+		/* bang http:// */
+		memcpy(scratch, "http://", 7U);
+		scroff = 7U;
+		memcpy(scratch + scroff, host, hlen);
+		scroff += hlen;
+		memcpy(scratch + scroff, _eps_V0_FILES, sizeof(_eps_V0_FILES));
+		scroff += sizeof(_eps_V0_FILES) - 1U;
+	}
+	if (scroff + r->val.z > zcratch) {
+		zcratch = scroff + r->val.z;
+		zcratch += 64U;
+		zcratch &= ~(64U - 1U);
+
+		scratch = realloc(scratch, zcratch);
+	}
+	/* now actually subst file:// */
+	memcpy(scratch + scroff, r->val.s + 6U, r->val.z - 6U);
+	r->val.s = scratch;
+	r->val.z += scroff - 6U;
+	scratch[r->val.z] = '\0';
+	return;
+}
+
+/* bulk requests */
+struct ser_blk_s {
+	/* the symbols as sent, \nul-separated */
+	char *syms;
+	/* series to serve, by rolf id, followed by the misses,
+	 * series found gone when they're opened join the misses */
+	size_t nent;
+	size_t nser;
+	size_t nmiss;
+	struct ser_ent_s {
+		dict_oid_t rid;
+		/* index in the list as sent */
+		size_t idx;
+		const char *sym;
+		/* why this one can't be served, NULL if it can */
+		const char *err;
+	} *ent;
+	/* next series to serve and next miss to report */
+	size_t iser;
+	size_t imiss;
+	/* whether the misses need a separator in front */
+	bool sep;
+	/* copies of prev's sym and date once their file is gone */
+	char *keep;
+	size_t zkeep;
+};
+
+/* series are streamed, this is the state kept between productions */
+struct ser_strm_s {
+	gandfn_t fx;
+	/* offset of the next line in FX and of the end of the slice */
+	size_t i;
+	size_t e;
+	enum {
+		SER_FRST,
+		SER_BODY,
+		SER_MISS,
+		SER_DONE,
+	} st;
+	gand_of_t of;
+	filter_f filter;
+	/* selected columns */
+	unsigned int sel;
+	struct flt_s f;
+	/* filter state */
+	struct rln_s prev;
+	/* for file:// substitution */
+	char *host;
+	/* date range, \nul-terminated, empty for no bound */
+	char from[32U];
+	char till[32U];
+	/* number of most recent lines, empty for all */
+	char last[24U];
+	/* cache key, the variant is format, encoding, host, dates,
+	 * line count, columns and filter */
+	gand_rkey_t k;
+	char var[2U + 256U + 32U + 32U + 24U + 1U + FLT_NSLOT];
+	/* columnar output and how much of it has been produced */
+	gand_col_t col;
+	size_t colo;
+	/* arrow encoder */
+	gand_arrow_t arw;
+	/* series to come and misses, for bulk requests */
+	struct ser_blk_s *blk;
+	/* series being filtered on the pool, for bulk requests */
+	struct ser_job_s *job;
+	/* slice being read into the page cache, if it was cold */
+	struct ser_warm_s *warm;
+	/* in-memory cache entry we're filling, if any */
+	gand_rbuf_t rb;
+#if defined HAVE_ZLIB_H
+	/* sidecar cache entry we're filling, if any */
+	gand_zent_t ze;
+#endif	/* HAVE_ZLIB_H */
+};
+
+/* bulk series filtered on the pool, one segment per series,
+ * segments are sent in order as they're done */
+struct ser_job_s {
+	pthread_mutex_t mtx;
+	/* the stream and every task in flight hold a reference */
+	size_t refs;
+	/* stream to wake when a segment's done, NULL once it's gone */
+	gand_strm_t strm;
+	/* filter, columns and dates, each task works on a copy */
+	struct ser_strm_s tpl;
+	/* segments handed to the pool so far, segment to send next */
+	size_t nsub;
+	size_t iseg;
+	size_t nseg;
+	struct ser_seg_s {
+		struct ser_job_s *job;
+		dict_oid_t rid;
+		/* first of the bulk request's entries for this series */
+		size_t ient;
+		/* set by the task, under MTX */
+		bool done;
+		bool err;
+		bool gone;
+		/* filtered lines and how much of them has been sent */
+		char *d;
+		size_t n;
+		size_t z;
+		size_t o;
+	} seg[];
+};
+
+/* cold slices are read in the background before they're filtered,
+ * bulk arrow requests have their series checked before they start */
+struct ser_warm_s {
+	pthread_mutex_t mtx;
+	/* the stream and the reader hold a reference each */
+	unsigned int refs;
+	bool done;
+	/* stream to wake when done, NULL once it's gone */
+	gand_strm_t strm;
+};
+
+/* number of segments per pool thread in flight, this bounds
+ * what's held in memory when the client is slow */
+#define BLK_WINDOW	(4U)
+
+static gand_pool_t gpool;
+
+static ssize_t
+ser_flush(
+	struct ser_strm_s *restrict s, gand_gbuf_t gb,
+	const char *buf, size_t tot)
+{
+/* send TOT bytes in BUF and keep them for the caches */
+	if (UNLIKELY(gand_gbuf_write(gb, buf, tot) < 0)) {
+		GAND_ERR_LOG("cannot write to gbuf");
+		return -1;
+	}
+	if (s->rb == NULL) {
+		;
+	} else if (UNLIKELY(gand_rbuf_write(s->rb, buf, tot) < 0) ||
+		   !gand_rcache_fits_p(gand_rbuf_size(s->rb))) {
+		/* too big to be kept in memory */
+		free_gand_rbuf(s->rb);
+		s->rb = NULL;
+	}
+#if defined HAVE_ZLIB_H
+	if (s->ze != NULL && UNLIKELY(gand_zcache_write(s->ze, buf, tot) < 0)) {
+		GAND_ERR_LOG("cannot write to cache, abandoning entry");
+		gand_zcache_abort(s->ze);
+		s->ze = NULL;
+	}
+#endif	/* HAVE_ZLIB_H */
+	return tot;
+}
+
+static int
+ser_open(struct ser_strm_s *restrict s, const char *fn)
+{
+/* map series file FN and slice it according to S's date range
+ * and number of lines */
+	if ((s->fx = mmapat_fn(trolf_dirfd, fn, O_RDONLY)).fd < 0) {
+		return -1;
+	}
+	s->i = 0U;
+	s->e = s->fx.fb.z;
+	if (*s->from || *s->till) {
+		/* the date index saves us most of the bisection */
+		gand_didx_t x = gand_didx_read(trolf_dirfd, fn, s->fx.fb);
+		size_t lo, hi;
+
+		if (*s->from) {
+			lo = 0U, hi = s->e;
+			if (x != NULL) {
+				gand_didx_bounds(x, s->from, &lo, &hi);
+			}
+			s->i = ser_bisect(s->fx.fb, lo, hi, s->from, false);
+		}
+		if (*s->till) {
+			lo = s->i, hi = s->e;
+			if (x != NULL) {
+				gand_didx_bounds(x, s->till, &lo, &hi);
+			}
+			s->e = ser_bisect(s->fx.fb, lo, hi, s->till, true);
+		}
+		if (x != NULL) {
+			gand_didx_free(x);
+		}
+	}
+	if (*s->last) {
+		const size_t n = strtoul(s->last, NULL, 10);
+
+		s->i = ser_last(s->fx.fb, s->i, s->e, n);
+	}
+	return 0;
+}
+
+static bool
+ser_resident_p(const struct ser_strm_s *s)
+{
+/* whether S's slice is in the page cache, i.e. whether filtering it
+ * won't have the loop wait for the disk */
+	const size_t pgsz = sysconf(_SC_PAGESIZE);
+	/* mincore() wants it non-const, it won't write to it though */
+	const uintptr_t dp = (uintptr_t)s->fx.fb.d;
+	unsigned char vec[1024U];
+
+	for (size_t o = s->i & ~(pgsz - 1U), z; o < s->e; o += z) {
+		z = s->e - o < sizeof(vec) * pgsz ? s->e - o : sizeof(vec) * pgsz;
+
+		if (UNLIKELY(mincore((void*)(dp + o), z, vec) < 0)) {
+			/* can't tell, don't bother */
+			return true;
+		}
+		for (size_t j = 0U; j < (z + pgsz - 1U) / pgsz; j++) {
+			if (!(vec[j] & 1U)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void
+free_ser_warm(struct ser_warm_s *w, bool done)
+{
+/* drop a reference to W, the reader's (DONE) or the stream's */
+	bool last;
+
+	pthread_mutex_lock(&w->mtx);
+	if (done) {
+		w->done = true;
+		if (w->strm != NULL) {
+			gand_strm_wake(w->strm);
+		}
+	} else {
+		w->strm = NULL;
+	}
+	last = !--w->refs;
+	pthread_mutex_unlock(&w->mtx);
+
+	if (last) {
+		pthread_mutex_destroy(&w->mtx);
+		free(w);
+	}
+	return;
+}
+
+static void
+warm_cb(void *clo)
+{
+	free_ser_warm(clo, true);
+	return;
+}
+
+static void
+ser_warm(struct ser_strm_s *restrict s, gand_strm_t strm)
+{
+/* have S's slice read into the page cache, S's producer will wait */
+	const size_t o = s->i & ~((size_t)sysconf(_SC_PAGESIZE) - 1U);
+	struct ser_warm_s *w;
+
+	if (UNLIKELY((w = calloc(1U, sizeof(*w))) == NULL)) {
+		return;
+	}
+	pthread_mutex_init(&w->mtx, NULL);
+	w->refs = 2U;
+	w->strm = strm;
+	s->warm = w;
+	if (gand_aio_warm(s->fx.fd, o, s->e - o, warm_cb, w) < 0) {
+		/* read them in the loop then */
+		s->warm = NULL;
+		pthread_mutex_destroy(&w->mtx);
+		free(w);
+	}
+	return;
+}
+
+static bool
+ser_cold_p(struct ser_strm_s *restrict s)
+{
+/* whether S's slice is still being read into the page cache */
+	bool done;
+
+	if (LIKELY(s->warm == NULL)) {
+		return false;
+	}
+	pthread_mutex_lock(&s->warm->mtx);
+	done = s->warm->done;
+	pthread_mutex_unlock(&s->warm->mtx);
+
+	if (!done) {
+		return true;
+	}
+	free_ser_warm(s->warm, false);
+	s->warm = NULL;
+	return false;
+}
+
+/* a bulk request's series checked for their files */
+struct ser_chk_s {
+	/* must come first, it goes the way of ser_warm_s */
+	struct ser_warm_s w;
+	/* the request's entries, only to be touched whilst W's stream is */
+	struct ser_blk_s *b;
+	size_t n;
+	struct {
+		dict_oid_t rid;
+		bool gone;
+	} ent[];
+};
+
+static void
+chk_task(void *clo)
+{
+/* see which of the series are gone, runs on the pool */
+	struct ser_chk_s *c = clo;
+
+	for (size_t i = 0U; i < c->n; i++) {
+		const char *fn = make_lateglu_name(c->ent[i].rid);
+
+		c->ent[i].gone = fn == NULL ||
+			faccessat(trolf_dirfd, fn, R_OK, 0) < 0;
+	}
+	pthread_mutex_lock(&c->w.mtx);
+	for (size_t i = 0U; c->w.strm != NULL && i < c->n; i++) {
+		if (c->ent[i].gone) {
+			c->b->ent[i].err = "Series not found";
+			c->b->nmiss++;
+		}
+	}
+	pthread_mutex_unlock(&c->w.mtx);
+	free_ser_warm(&c->w, true);
+	return;
+}
+
+static void
+blk_chk(struct ser_strm_s *restrict s, gand_strm_t strm)
+{
+/* have the series of bulk request S checked, S's producer will wait */
+	struct ser_blk_s *b = s->blk;
+	struct ser_chk_s *c;
+
+	c = calloc(1U, sizeof(*c) + b->nser * sizeof(*c->ent));
+	if (UNLIKELY(c == NULL)) {
+		/* they'll be skipped when opened then */
+		return;
+	}
+	pthread_mutex_init(&c->w.mtx, NULL);
+	c->w.refs = 2U;
+	c->w.strm = strm;
+	c->b = b;
+	c->n = b->nser;
+	for (size_t i = 0U; i < c->n; i++) {
+		c->ent[i].rid = b->ent[i].rid;
+	}
+	s->warm = &c->w;
+	if (gpool == NULL || UNLIKELY(gand_pool_push(gpool, chk_task, c) < 0)) {
+		/* do it ourselves then */
+		chk_task(c);
+	}
+	return;
+}
+
+static bool
+ser_next(struct ser_strm_s *restrict s)
+{
+/* move on to the next non-empty series of a bulk request,
+ * return false if there's none */
+	struct ser_blk_s *b = s->blk;
+
+	if (b == NULL) {
+		return false;
+	} else if (s->prev.sym.s != NULL && s->prev.sym.s != b->keep) {
+		/* the filters compare against the previous line,
+		 * keep its sym and date beyond the file's life time */
+		const size_t z = s->prev.sym.z + s->prev.dat.z;
+
+		if (UNLIKELY(z > b->zkeep)) {
+			char *nu;
+
+			if (UNLIKELY((nu = realloc(b->keep, z)) == NULL)) {
+				GAND_ERR_LOG("cannot keep previous line");
+				return false;
+			}
+			b->keep = nu;
+			b->zkeep = z;
+		}
+		memcpy(b->keep, s->prev.sym.s, s->prev.sym.z);
+		memcpy(b->keep + s->prev.sym.z, s->prev.dat.s, s->prev.dat.z);
+		s->prev.sym.s = b->keep;
+		s->prev.dat.s = b->keep + s->prev.sym.z;
+		s->prev.vrb = s->prev.val = (word_t){b->keep, 0U};
+	}
+	do {
+		struct ser_ent_s *e;
+		const char *fn;
+
+		munmap_fn(s->fx);
+		s->fx = (gandfn_t){.fd = -1};
+		s->i = s->e = 0U;
+		/* the filter's memo points into the mapping just gone */
+		s->f.run = (word_t){NULL};
+		s->f.runp = false;
+		if (b->iser >= b->nser) {
+			return false;
+		}
+		e = b->ent + b->iser++;
+		if (e->err != NULL) {
+			/* known to be gone */
+			continue;
+		} else if (b->iser > 1U && e[-1].rid == e->rid) {
+			/* asked for twice */
+			if (e[-1].err != NULL) {
+				e->err = e[-1].err;
+				b->nmiss++;
+			}
+			continue;
+		} else if (UNLIKELY((fn = make_lateglu_name(e->rid)) == NULL ||
+				    ser_open(s, fn) < 0)) {
+			if (fn != NULL && errno != ENOENT) {
+				GAND_ERR_LOG("cannot open series %08u: %s",
+					     e->rid, strerror(errno));
+			}
+			e->err = "Series not found";
+			b->nmiss++;
+		}
+	} while (s->i >= s->e);
+	return true;
+}
+
+static size_t
+ser_misses(struct ser_strm_s *restrict s, char *restrict buf, size_t bsz)
+{
+/* report the symbols of a bulk request that couldn't be served,
+ * as many as fit into BUF, csv ones as comments, json ones as
+ * array elements after the series */
+	struct ser_blk_s *b = s->blk;
+	size_t z = 0U;
+
+	for (; b->imiss < b->nent; b->imiss++) {
+		const struct ser_ent_s *e = b->ent + b->imiss;
+		int n;
+
+		if (e->err == NULL) {
+			continue;
+		} else if (s->of == OF_JSON) {
+			n = snprintf(buf + z, bsz - z,
+				     "%s{\"sym\":\"%s\",\"error\":\"%s\"}",
+				     b->sep ? ",\n" : "", e->sym, e->err);
+		} else {
+			n = snprintf(buf + z, bsz - z,
+				     "# %s\t%s\n", e->sym, e->err);
+		}
+		if (UNLIKELY(n < 0)) {
+			continue;
+		} else if ((size_t)n >= bsz - z && z) {
+			/* we'll be back for this one */
+			return z;
+		} else if (UNLIKELY((size_t)n >= bsz - z)) {
+			GAND_ERR_LOG("symbol too long, skipping");
+			continue;
+		}
+		z += n;
+		b->sep = true;
+	}
+	if (s->of == OF_JSON) {
+		if (UNLIKELY(bsz - z < 2U)) {
+			return z;
+		}
+		/* close the array */
+		buf[z++] = ']';
+		buf[z++] = '\n';
+	}
+	s->st = SER_DONE;
+	return z;
+}
+
+static bool
+ser_lines(
+	struct ser_strm_s *restrict s,
+	char *restrict buf, size_t bsz, size_t *restrict tot)
+{
+/* filter and rewrite S's lines into BUF after the TOT bytes there,
+ * return false if BUF filled up before the lines ran out */
+	while (s->i < s->e || ser_next(s)) {
+		const size_t o = s->i;
+		struct rln_s ln[64U];
+		size_t eol[countof(ln)];
+		size_t nln;
+
+		/* snarf a bunch of lines, v0 format, zero copy */
+		nln = snarf_rlns(
+			ln, eol, countof(ln),
+			(const char*)s->fx.fb.d + o, s->e - o);
+
+		for (size_t j = 0U; j < nln; j++) {
+			ssize_t z;
+
+			if (UNLIKELY(ln[j].val.z > 7U &&
+				     !memcmp(ln[j].val.s, "file://", 7U)) &&
+			    s->sel & SEL_VAL) {
+				subst_rln(ln + j, s->host);
+			}
+			/* filter, maybe */
+			z = s->filter(
+				buf + *tot, bsz - *tot,
+				ln[j], &s->f, &s->prev);
+			if (UNLIKELY(z < -1 && *tot)) {
+				/* buffer's full, we'll be back for this line */
+				return false;
+			} else if (UNLIKELY(z < -1)) {
+				GAND_ERR_LOG("line too long, skipping");
+			} else if (LIKELY(z > 0)) {
+				*tot += z;
+			}
+			s->i = o + eol[j];
+		}
+	}
+	return true;
+}
+
+static ssize_t
+ser_prod(void *clo, gand_gbuf_t gb)
+{
+	struct ser_strm_s *restrict s = clo;
+	char buf[4096U];
+	size_t tot = 0U;
+	ssize_t z;
+
+	if (ser_cold_p(s)) {
+		/* we'll be woken */
+		return GAND_STRM_AGAIN;
+	}
+	switch (s->st) {
+	case SER_FRST:
+		z = s->filter(buf, sizeof(buf), FILTER_FRST, nul_flt, &s->prev);
+		if (z > 0) {
+			tot += z;
+		}
+		s->st = SER_BODY;
+		break;
+	case SER_BODY:
+		break;
+	case SER_MISS:
+		goto miss;
+	case SER_DONE:
+	default:
+		return 0;
+	}
+
+	/* other streams might have used the subst'er in the meantime */
+	subst_rln(NULL, NULL);
+
+	/* traverse the lines, filter and rewrite them
+	 * until the buffer's full */
+	if (!ser_lines(s, buf, sizeof(buf), &tot)) {
+		goto flush;
+	}
+	/* flush filter */
+	with (const bool sep = s->prev.sym.s != NULL) {
+		z = s->filter(
+			buf + tot, sizeof(buf) - tot,
+			FILTER_LAST, nul_flt, &s->prev);
+		if (z < 0) {
+			goto flush;
+		}
+		tot += z;
+		s->st = SER_DONE;
+		if (s->blk == NULL || !s->blk->nmiss) {
+			break;
+		} else if (s->of == OF_JSON) {
+			/* misses go in the array, so reopen it */
+			tot -= 2U/*]\n*/;
+			s->blk->sep = sep;
+		}
+		s->st = SER_MISS;
+	}
+miss:
+	if (s->st == SER_MISS && !tot) {
+		/* misses get a buffer of their own */
+		tot = ser_misses(s, buf, sizeof(buf));
+	}
+flush:
+	return ser_flush(s, gb, buf, tot);
+}
+
+static int
+seg_write(struct ser_seg_s *restrict g, const char *buf, size_t z)
+{
+	if (UNLIKELY(!z)) {
+		return 0;
+	} else if (UNLIKELY(g->n + z > g->z)) {
+		size_t nuz = g->z ?: 16384U;
+		char *nu;
+
+		while ((nuz *= 2U) < g->n + z);
+		if (UNLIKELY((nu = realloc(g->d, nuz)) == NULL)) {
+			return -1;
+		}
+		g->d = nu;
+		g->z = nuz;
+	}
+	memcpy(g->d + g->n, buf, z);
+	g->n += z;
+	return 0;
+}
+
+static int
+blk_fill(struct ser_strm_s *restrict t, struct ser_seg_s *restrict g)
+{
+/* filter T's lines into segment G, json's brackets are left to
+ * the stream that stitches the segments together */
+	char buf[4096U];
+	size_t tot = 0U;
+	ssize_t z;
+
+	while (!ser_lines(t, buf, sizeof(buf), &tot)) {
+		if (UNLIKELY(seg_write(g, buf, tot) < 0)) {
+			return -1;
+		}
+		tot = 0U;
+	}
+	while ((z = t->filter(
+			buf + tot, sizeof(buf) - tot,
+			FILTER_LAST, nul_flt, &t->prev)) < 0 && tot) {
+		if (UNLIKELY(seg_write(g, buf, tot) < 0)) {
+			return -1;
+		}
+		tot = 0U;
+	}
+	if (z > 0 && t->of == OF_JSON) {
+		tot += z - 2U/*]\n*/;
+		if (!(t->sel & (SEL_SYM | SEL_DAT)) && z > 2) {
+			/* without groups the final newline is the stream's */
+			tot--;
+		}
+	} else if (z > 0) {
+		tot += z;
+	}
+	return seg_write(g, buf, tot);
+}
+
+static void
+free_ser_job(struct ser_job_s *j)
+{
+	for (size_t i = 0U; i < j->nseg; i++) {
+		free(j->seg[i].d);
+	}
+	if (j->tpl.host != NULL) {
+		free(j->tpl.host);
+	}
+	pthread_mutex_destroy(&j->mtx);
+	free(j);
+	return;
+}
+
+static void
+blk_task(void *clo)
+{
+/* filter one series of a bulk request, runs on the pool */
+	struct ser_seg_s *g = clo;
+	struct ser_job_s *j = g->job;
+	/* the filter memoises the last valflav, so work on a copy */
+	struct ser_strm_s t = j->tpl;
+	const char *fn;
+	bool gone;
+
+	/* other tasks might have used the subst'er in the meantime */
+	subst_rln(NULL, NULL);
+
+	pthread_mutex_lock(&j->mtx);
+	gone = j->strm == NULL;
+	pthread_mutex_unlock(&j->mtx);
+
+	if (gone) {
+		/* no one's listening */
+		;
+	} else if (UNLIKELY((fn = make_lateglu_name(g->rid)) == NULL ||
+			    ser_open(&t, fn) < 0)) {
+		if (fn != NULL && errno != ENOENT) {
+			GAND_ERR_LOG("cannot open series %08u: %s",
+				     g->rid, strerror(errno));
+		}
+		/* the stream will report it */
+		g->gone = true;
+	} else {
+		if (UNLIKELY(blk_fill(&t, g) < 0)) {
+			GAND_ERR_LOG("cannot keep series %08u", g->rid);
+			g->err = true;
+		}
+		munmap_fn(t.fx);
+	}
+
+	pthread_mutex_lock(&j->mtx);
+	g->done = true;
+	if (j->strm != NULL) {
+		gand_strm_wake(j->strm);
+	}
+	gone = !--j->refs;
+	pthread_mutex_unlock(&j->mtx);
+
+	if (gone) {
+		free_ser_job(j);
+	}
+	return;
+}
+
+static void
+blk_push(struct ser_job_s *j)
+{
+/* keep the pool busy with the segments after the one being sent */
+	const size_t w = j->iseg + BLK_WINDOW * gand_pool_nthr(gpool);
+
+	for (; j->nsub < j->nseg && j->nsub < w; j->nsub++) {
+		struct ser_seg_s *g = j->seg + j->nsub;
+
+		pthread_mutex_lock(&j->mtx);
+		j->refs++;
+		pthread_mutex_unlock(&j->mtx);
+		if (UNLIKELY(gand_pool_push(gpool, blk_task, g) < 0)) {
+			/* do it ourselves then */
+			blk_task(g);
+		}
+	}
+	return;
+}
+
+static struct ser_job_s*
+make_ser_job(const struct ser_strm_s *s)
+{
+/* prepare the segments of bulk stream S, one per series */
+	const struct ser_blk_s *b = s->blk;
+	struct ser_job_s *res;
+	size_t n = 0U;
+
+	for (size_t i = 0U; i < b->nser; i++) {
+		/* series asked for twice are served once */
+		n += !i || b->ent[i - 1U].rid != b->ent[i].rid;
+	}
+	if (UNLIKELY((res = calloc(
+			      1U, sizeof(*res) + n * sizeof(*res->seg))) == NULL)) {
+		return NULL;
+	}
+	res->tpl = *s;
+	res->tpl.blk = NULL;
+	res->tpl.host = NULL;
+	/* S's filter points into S, which may be gone before the tasks
+	 * are, so rebuild it on the copy's buffer */
+	if (res->tpl.f.str.s != NULL) {
+		res->tpl.f.str.s = res->tpl.f.buf;
+		memset(res->tpl.f.tbl, 0, sizeof(res->tpl.f.tbl));
+		flt_compile(&res->tpl.f);
+	}
+	res->tpl.f.run = (word_t){NULL};
+	res->tpl.f.runp = false;
+	if (s->host != NULL &&
+	    UNLIKELY((res->tpl.host = strdup(s->host)) == NULL)) {
+		free(res);
+		return NULL;
+	}
+	for (size_t i = 0U; i < b->nser; i++) {
+		if (!i || b->ent[i - 1U].rid != b->ent[i].rid) {
+			res->seg[res->nseg].job = res;
+			res->seg[res->nseg].ient = i;
+			res->seg[res->nseg++].rid = b->ent[i].rid;
+		}
+	}
+	pthread_mutex_init(&res->mtx, NULL);
+	res->refs = 1U;
+	return res;
+}
+
+static ssize_t
+blk_prod(void *clo, gand_gbuf_t gb)
+{
+/* like ser_prod() but the series come in segments off the pool */
+	struct ser_strm_s *restrict s = clo;
+	struct ser_job_s *j = s->job;
+	char buf[4096U];
+	size_t tot = 0U;
+
+	switch (s->st) {
+	case SER_FRST:
+		if (s->of == OF_JSON) {
+			buf[tot++] = '[';
+		}
+		s->st = SER_BODY;
+		break;
+	case SER_BODY:
+		break;
+	case SER_MISS:
+		goto miss;
+	case SER_DONE:
+	default:
+		return 0;
+	}
+
+	while (j->iseg < j->nseg) {
+		struct ser_seg_s *g = j->seg + j->iseg;
+
+		if (!g->o) {
+			bool done;
+
+			pthread_mutex_lock(&j->mtx);
+			done = g->done;
+			pthread_mutex_unlock(&j->mtx);
+
+			if (!done) {
+				/* we'll be woken when it is */
+				return tot ? ser_flush(s, gb, buf, tot)
+					: GAND_STRM_AGAIN;
+			} else if (UNLIKELY(g->err)) {
+				return -1;
+			} else if (g->gone) {
+				/* off to the misses, twice-asked ones too */
+				struct ser_blk_s *b = s->blk;
+
+				for (size_t k = g->ient;
+				     k < b->nser && b->ent[k].rid == g->rid; k++) {
+					b->ent[k].err = "Series not found";
+					b->nmiss++;
+				}
+			} else if (g->n && s->of == OF_JSON && s->blk->sep) {
+				buf[tot++] = ',';
+				buf[tot++] = '\n';
+				/* ungrouped pairs start on a new line already */
+				g->o = *g->d == '\n';
+			}
+			s->blk->sep = s->blk->sep || g->n;
+		}
+		if (g->o < g->n) {
+			/* send straight from the segment, a chunk at a time */
+			const size_t z = g->n - g->o < 16384U
+				? g->n - g->o : 16384U;
+
+			if (tot && UNLIKELY(ser_flush(s, gb, buf, tot) < 0)) {
+				return -1;
+			} else if (UNLIKELY(ser_flush(s, gb, g->d + g->o, z) < 0)) {
+				return -1;
+			}
+			g->o += z;
+			return tot + z;
+		}
+		/* segment's out, make room for the next ones */
+		free(g->d);
+		g->d = NULL;
+		j->iseg++;
+		blk_push(j);
+	}
+
+	/* all series are out */
+	if (s->of == OF_JSON && s->blk->sep &&
+	    !(s->sel & (SEL_SYM | SEL_DAT))) {
+		buf[tot++] = '\n';
+	}
+	s->st = SER_DONE;
+	if (s->blk->nmiss) {
+		s->st = SER_MISS;
+		if (!tot) {
+			goto miss;
+		}
+	} else if (s->of == OF_JSON) {
+		buf[tot++] = ']';
+		buf[tot++] = '\n';
+	}
+	return ser_flush(s, gb, buf, tot);
+
+miss:
+	tot = ser_misses(s, buf, sizeof(buf));
+	return ser_flush(s, gb, buf, tot);
+}
+
+static gand_col_t
+ser_col(struct ser_strm_s *restrict s)
+{
+/* collect S's lines into columns */
+	const char *const dp = (const char*)s->fx.fb.d;
+	gand_col_t c;
+
+	if (UNLIKELY((c = make_gand_col()) == NULL)) {
+		return NULL;
+	}
+	/* other streams might have used the subst'er in the meantime */
+	subst_rln(NULL, NULL);
+
+	for (size_t o = s->i; o < s->e;) {
+		struct rln_s ln[64U];
+		size_t eol[countof(ln)];
+		size_t nln;
+
+		nln = snarf_rlns(ln, eol, countof(ln), dp + o, s->e - o);
+		for (size_t j = 0U; j < nln; j++) {
+			if (UNLIKELY(ln[j].sym.s == NULL)) {
+				continue;
+			} else if (!flt_matches_p(&s->f, ln[j].vrb)) {
+				continue;
+			} else if (UNLIKELY(ln[j].val.z > 7U &&
+					    !memcmp(ln[j].val.s, "file://", 7U))) {
+				subst_rln(ln + j, s->host);
+			}
+			if (UNLIKELY(gand_col_add(
+					     c, ln[j].dat,
+					     ln[j].vrb, ln[j].val) < 0)) {
+				GAND_ERR_LOG("cannot add row to columns, skipping");
+			}
+		}
+		o += eol[nln - 1U];
+	}
+	return c;
+}
+
+static ssize_t
+col_prod(void *clo, gand_gbuf_t gb)
+{
+	struct ser_strm_s *restrict s = clo;
+	char buf[16384U];
+	size_t z;
+
+	if (ser_cold_p(s)) {
+		/* we'll be woken */
+		return GAND_STRM_AGAIN;
+	}
+	switch (s->st) {
+	case SER_FRST:
+		/* there's no columns before all lines have been seen */
+		if (UNLIKELY((s->col = ser_col(s)) == NULL)) {
+			GAND_ERR_LOG("cannot obtain columns");
+			return -1;
+		}
+		s->i = s->e;
+		s->st = SER_BODY;
+		break;
+	case SER_BODY:
+		break;
+	case SER_DONE:
+	default:
+		return 0;
+	}
+
+	z = gand_col_read(s->col, buf, sizeof(buf), s->colo);
+	if ((s->colo += z) >= gand_col_size(s->col)) {
+		s->st = SER_DONE;
+	}
+	return ser_flush(s, gb, buf, z);
+}
+
+/* rows per record batch */
+#define ARROW_NROW	(4096U)
+
+static char*
+blk_misses(const struct ser_blk_s *b)
+{
+/* the misses of B as SYM \t ERROR lines */
+	size_t z = 1U;
+	char *r, *rp;
+
+	for (size_t i = 0U; i < b->nent; i++) {
+		if (b->ent[i].err != NULL) {
+			z += strlen(b->ent[i].sym) + 1U +
+				strlen(b->ent[i].err) + 1U;
+		}
+	}
+	if (UNLIKELY((rp = r = malloc(z)) == NULL)) {
+		return NULL;
+	}
+	for (size_t i = 0U; i < b->nent; i++) {
+		if (b->ent[i].err == NULL) {
+			continue;
+		}
+		rp = stpcpy(rp, b->ent[i].sym);
+		*rp++ = '\t';
+		rp = stpcpy(rp, b->ent[i].err);
+		*rp++ = '\n';
+	}
+	*rp = '\0';
+	return r;
+}
+
+static ssize_t
+arrow_prod(void *clo, gand_gbuf_t gb)
+{
+	struct ser_strm_s *restrict s = clo;
+	const void *buf;
+	size_t z;
+
+	if (ser_cold_p(s)) {
+		/* we'll be woken */
+		return GAND_STRM_AGAIN;
+	}
+	switch (s->st) {
+	case SER_FRST:
+		if (UNLIKELY((s->arw = make_gand_arrow()) == NULL)) {
+			GAND_ERR_LOG("cannot obtain arrow encoder");
+			return -1;
+		} else if (s->blk != NULL && s->blk->nmiss) {
+			/* misses go to the schema's metadata */
+			char *m = blk_misses(s->blk);
+
+			if (UNLIKELY(m == NULL ||
+				     gand_arrow_meta(
+					     s->arw, "gandalf:errors", m) < 0)) {
+				GAND_ERR_LOG("cannot report misses");
+			}
+			free(m);
+		}
+		s->st = SER_BODY;
+		break;
+	case SER_BODY:
+		break;
+	case SER_DONE:
+	default:
+		return 0;
+	}
+
+	/* other streams might have used the subst'er in the meantime */
+	subst_rln(NULL, NULL);
+
+	/* one record batch per call */
+	while (gand_arrow_nrow(s->arw) < ARROW_NROW &&
+	       (s->i < s->e || ser_next(s))) {
+		/* bulk requests switch files underneath us */
+		const char *const dp = (const char*)s->fx.fb.d;
+		const size_t o = s->i;
+		struct rln_s ln[64U];
+		size_t eol[countof(ln)];
+		size_t nln;
+
+		nln = snarf_rlns(ln, eol, countof(ln), dp + o, s->e - o);
+		for (size_t j = 0U; j < nln; j++) {
+			if (UNLIKELY(ln[j].sym.s == NULL)) {
+				continue;
+			} else if (!flt_matches_p(&s->f, ln[j].vrb)) {
+				continue;
+			} else if (UNLIKELY(ln[j].val.z > 7U &&
+					    !memcmp(ln[j].val.s, "file://", 7U))) {
+				subst_rln(ln + j, s->host);
+			}
+			if (UNLIKELY(gand_arrow_add(s->arw, ln[j]) < 0)) {
+				GAND_ERR_LOG("cannot add row to batch, skipping");
+			}
+		}
+		s->i = o + eol[nln - 1U];
+	}
+	if (s->i >= s->e && !ser_next(s)) {
+		s->st = SER_DONE;
+	}
+	buf = gand_arrow_flush(s->arw, &z, s->st == SER_DONE);
+	if (UNLIKELY(buf == NULL)) {
+		GAND_ERR_LOG("cannot encode record batch");
+		/* don't leave a truncated stream in the caches */
+		s->st = SER_BODY;
+		return -1;
+	}
+	return ser_flush(s, gb, buf, z);
+}
+
+static void
+ser_fin(void *clo)
+{
+	struct ser_strm_s *restrict s = clo;
+
+	if (s->rb != NULL) {
+		if (s->st == SER_DONE) {
+			(void)gand_rcache_put(s->k, s->rb);
+		}
+		/* the cache holds its own reference */
+		free_gand_rbuf(s->rb);
+	}
+#if defined HAVE_ZLIB_H
+	if (s->ze == NULL) {
+		;
+	} else if (s->st == SER_DONE) {
+		/* complete response, keep it */
+		(void)gand_zcache_commit(s->ze);
+	} else {
+		gand_zcache_abort(s->ze);
+	}
+#endif	/* HAVE_ZLIB_H */
+	if (s->col != NULL) {
+		free_gand_col(s->col);
+	}
+	if (s->arw != NULL) {
+		free_gand_arrow(s->arw);
+	}
+	if (s->warm != NULL) {
+		free_ser_warm(s->warm, false);
+	}
+	if (s->job != NULL) {
+		struct ser_job_s *j = s->job;
+		bool last;
+
+		pthread_mutex_lock(&j->mtx);
+		/* tasks still in flight mustn't wake us any more */
+		j->strm = NULL;
+		last = !--j->refs;
+		pthread_mutex_unlock(&j->mtx);
+
+		if (last) {
+			free_ser_job(j);
+		}
+	}
+	if (s->blk != NULL) {
+		free(s->blk->syms);
+		free(s->blk->ent);
+		free(s->blk->keep);
+		free(s->blk);
+	}
+	munmap_fn(s->fx);
+	if (s->host != NULL) {
+		free(s->host);
+	}
+	free(s);
+	return;
+}
+
+#if defined HAVE_ZLIB_H
+static bool
+req_gzip_p(gand_httpd_req_t req)
+{
+	gand_word_t x = gand_req_get_xhdr(req, "Accept-Encoding");
+
+	return x.str != NULL && xmemmem(x.str, x.len, "gzip", 4U) != NULL;
+}
+
+static gand_zkey_t
+ser_zkey(const struct ser_strm_s *s)
+{
+/* the sidecar cache only has gzip'd responses */
+	return (gand_zkey_t){
+		.id = s->k.id,
+		.mtim = s->k.mtim,
+		.mtim_nsec = s->k.nsec,
+		.size = s->k.size,
+		.var = s->var,
+		.varz = s->k.varz,
+	};
+}
+#endif	/* HAVE_ZLIB_H */
+
+static size_t
+ser_var(struct ser_strm_s *restrict s, gand_of_t of, const char *host)
+{
+/* put S's response variant into S's key, i.e. format, encoding,
+ * host because of the file:// substitution and the filter,
+ * return its size or 0 if it's not to be cached */
+	size_t hz = host != NULL ? strlen(host) : 0U;
+	size_t z;
+
+	if (UNLIKELY(hz >= 256U)) {
+		return 0U;
+	}
+	s->var[0U] = (char)of;
+	/* identity encoding */
+	s->var[1U] = '\0';
+	memcpy(s->var + 2U, host, hz);
+	s->var[2U + hz] = '\0';
+	z = 2U + hz + 1U;
+	with (size_t fz = strlen(s->from), tz = strlen(s->till)) {
+		memcpy(s->var + z, s->from, fz + 1U);
+		z += fz + 1U;
+		memcpy(s->var + z, s->till, tz + 1U);
+		z += tz + 1U;
+	}
+	with (size_t lz = strlen(s->last)) {
+		memcpy(s->var + z, s->last, lz + 1U);
+		z += lz + 1U;
+	}
+	s->var[z++] = (char)s->sel;
+	if (s->f.str.s != NULL) {
+		memcpy(s->var + z, s->f.str.s, s->f.str.z);
+		z += s->f.str.z;
+	}
+	s->k.var = s->var;
+	return s->k.varz = z;
+}
+
+static gand_stmp_t
+ser_stmp(const struct ser_strm_s *s, const struct stat *st)
+{
+/* validators of S's response, the variant hash covers format, host
+ * and filter, the encoding is the client's business */
+	const uint64_t h = fnv1a(FNV1A_BASIS, s->var, s->k.varz);
+
+	return (gand_stmp_t){
+		.ino = st->st_ino,
+		.size = st->st_size,
+		.mtim = st->st_mtime,
+		.nsec = st->st_mtim.tv_nsec,
+		.var = (unsigned int)(h ^ h >> 32U),
+	};
+}
+
+static gand_rbuf_t
+ser_slurp(int fd)
+{
+/* read FD into an rbuf if it's small enough to be kept in memory */
+	struct stat st;
+	gand_rbuf_t rb;
+	char buf[16384U];
+	ssize_t nrd;
+
+	if (fstat(fd, &st) < 0) {
+		return NULL;
+	} else if (!gand_rcache_fits_p(st.st_size)) {
+		return NULL;
+	} else if ((rb = make_gand_rbuf(st.st_size)) == NULL) {
+		return NULL;
+	}
+	while ((nrd = read(fd, buf, sizeof(buf))) > 0) {
+		if (UNLIKELY(gand_rbuf_write(rb, buf, nrd) < 0)) {
+			break;
+		}
+	}
+	if (UNLIKELY(nrd != 0)) {
+		free_gand_rbuf(rb);
+		return NULL;
+	}
+	return rb;
+}
+
+static gand_httpd_res_t
+ser_cached(struct ser_strm_s *restrict s, gand_httpd_req_t req)
+{
+/* return the cached response for S, if any, rc is 0 otherwise */
+	gand_httpd_res_t res = {
+		.rc = 200U/*OK*/,
+		.clen = CLEN_UNKNOWN,
+		.rd = {DTYP_RBUF},
+	};
+	gand_rbuf_t rb;
+
+#if defined HAVE_ZLIB_H
+	if (req_gzip_p(req)) {
+		int fd;
+
+		s->var[1U] = 'z';
+		if ((rb = gand_rcache_get(s->k)) != NULL) {
+			goto gzip;
+		} else if ((fd = gand_zcache_get(ser_zkey(s))) < 0) {
+			;
+		} else if ((rb = ser_slurp(fd)) != NULL) {
+			/* keep it in memory from now on */
+			close(fd);
+			(void)gand_rcache_put(s->k, rb);
+			goto gzip;
+		} else {
+			/* sendfile() it then */
+			res.rd = (gand_res_data_t){
+				DTYP_SOCK, GAND_RES_DATA(sock) = fd
+			};
+			res.cenc = "gzip";
+			return res;
+		}
+		s->var[1U] = '\0';
+	}
+#endif	/* HAVE_ZLIB_H */
+	if ((rb = gand_rcache_get(s->k)) != NULL) {
+		res.rd GAND_RES_DATA(rbuf) = rb;
+		return res;
+	}
+	return (gand_httpd_res_t){0U};
+
+#if defined HAVE_ZLIB_H
+gzip:
+	s->var[1U] = '\0';
+	res.rd GAND_RES_DATA(rbuf) = rb;
+	res.cenc = "gzip";
+	return res;
+#endif	/* HAVE_ZLIB_H */
 }
 
-static gand_of_t
-__gand_of(const char *s, size_t z)
+typedef ssize_t(*prod_f)(void *clo, gand_gbuf_t);
+
+static prod_f
+ser_init(struct ser_strm_s *restrict s, gand_httpd_req_t req, gand_of_t of)
 {
-	if (z < sizeof(OF(CSV)) - 1U) {
-		;
-	} else if (!memcmp(OF(CSV), s, sizeof(OF(CSV)) - 1U)) {
-		return OF_CSV;
-	} else if (z < sizeof(OF(JSON)) - 1U) {
-		;
-	} else if (!memcmp(OF(JSON), s, sizeof(OF(JSON)) - 1U)) {
-		return OF_JSON;
-	}
-	return OF_UNK;
+/* set S up as per REQ's query parameters for output format OF,
+ * return the producer to go with it */
+
+	/* obtain the filter and the columns to go with it */
+	ser_get_filter(&s->f, req);
+	s->sel = ser_get_sel(req);
+	/* and the date range */
+	(void)ser_get_date(s->from, sizeof(s->from), req, "from=");
+	(void)ser_get_date(s->till, sizeof(s->till), req, "till=");
+	/* and the number of lines */
+	if (ser_get_date(s->last, sizeof(s->last), req, "last=") &&
+	    !strtoul(s->last, NULL, 10)) {
+		/* all of them then */
+		*s->last = '\0';
+	}
+
+	switch ((s->of = of)) {
+	default:
+	case OF_CSV:
+		s->of = OF_CSV;
+		s->filter = filter_csv[s->sel];
+		break;
+	case OF_JSON:
+		s->filter = filter_json[s->sel];
+		break;
+	case OF_COL:
+		/* columns are what they are */
+		s->sel = SEL_ALL;
+		return col_prod;
+	case OF_ARROW:
+		/* so is the arrow schema */
+		s->sel = SEL_ALL;
+		return arrow_prod;
+	}
+	return ser_prod;
 }
 
-static __attribute__((const, pure)) gand_ep_t
-req_get_endpoint(gand_httpd_req_t req)
+static int
+blk_ent_cmp(const void *x, const void *y)
 {
-	const char *cmd;
-	size_t cmz;
+/* servable ones by rolf id first, then the misses as sent */
+	const struct ser_ent_s *a = x, *b = y;
 
-	if (UNLIKELY((cmd = req.path) == NULL)) {
-		return EP_UNK;
-	} else if (UNLIKELY((cmz = strlen(cmd)) == 0U)) {
-		return EP_UNK;
-	} else if (UNLIKELY(cmz == 1U && *cmd == '/')) {
-		return EP_V0_MAIN;
+	if ((a->err != NULL) != (b->err != NULL)) {
+		return a->err != NULL ? 1 : -1;
+	} else if (a->err == NULL && a->rid != b->rid) {
+		return a->rid < b->rid ? -1 : 1;
 	}
-	return __gand_ep(cmd, cmz);
+	return a->idx < b->idx ? -1 : a->idx > b->idx;
 }
 
-static gand_of_t
-req_get_outfmt(gand_httpd_req_t req)
+static gand_httpd_res_t
+work_blk(gand_httpd_req_t req)
 {
-	gand_word_t acc = gand_req_get_xhdr(req, "Accept");
-	gand_of_t of = OF_UNK;
-	const char *on;
+/* serve the series of a list of symbols in one go */
+	static const char sep[] = ",; \t\r\n";
+	gand_word_t w;
+	gand_of_t of;
+	struct ser_strm_s *s;
+	struct ser_blk_s *b;
+	prod_f prod;
+	gand_strm_t strm;
+	unsigned int gen;
+	unsigned int tag;
+	size_t nmiss = 0U;
+	dict_t d;
+
+	if ((of = req_get_outfmt(req)) == OF_UNK || of == OF_COL) {
+		/* our columns have no room for symbols */
+		of = OF_CSV;
+	}
+	if (req.verb == VERB_POST && req.data.len) {
+		w = req.data;
+	} else {
+		w = gand_req_get_xqry(req, "sym=");
+		w.str += 4U, w.len -= 4U;
+	}
 
-	if (UNLIKELY(acc.str == NULL)) {
-		return OF_UNK;
+	if (UNLIKELY((s = calloc(1U, sizeof(*s))) == NULL)) {
+		goto interr;
 	}
-	/* otherwise */
-	do {
-		if ((on = strchr(acc.str, ',')) != NULL) {
-			acc.len = on++ - acc.str;
-		}
-		/* check if there's semicolon specs */
-		with (const char *sc = strchr(acc.str, ';')) {
-			if (sc && on && sc < on || sc) {
-				acc.len = sc - acc.str;
+	s->fx = (gandfn_t){.fd = -1};
+	if (UNLIKELY((s->blk = b = calloc(1U, sizeof(*b))) == NULL)) {
+		goto interr_fin;
+	} else if (UNLIKELY((b->syms = strndup(w.str, w.len)) == NULL)) {
+		goto interr_fin;
+	}
+	/* count the symbols, then split them */
+	for (const char *p = b->syms; *(p += strspn(p, sep));
+	     p += strcspn(p, sep)) {
+		b->nent++;
+	}
+	if (UNLIKELY(!b->nent)) {
+		static const char errmsg[] = "Bad Request\n";
+
+		ser_fin(s);
+		GAND_INFO_LOG(":rsp [400 Bad request]: no symbols");
+		return (gand_httpd_res_t){
+			.rc = 400U/*BAD REQUEST*/,
+			.ctyp = OF(UNK),
+			.clen = sizeof(errmsg)- 1U,
+			.rd = {DTYP_DATA, GAND_RES_DATA(data) = errmsg},
+		};
+	} else if (UNLIKELY((b->ent = calloc(
+				     b->nent, sizeof(*b->ent))) == NULL)) {
+		goto interr_fin;
+	}
+	with (size_t i = 0U) {
+		for (char *p = b->syms, *eot; *(p += strspn(p, sep)); p = eot) {
+			eot = p + strcspn(p, sep);
+			b->ent[i].idx = i;
+			b->ent[i++].sym = p;
+			if (*eot) {
+				*eot++ = '\0';
 			}
 		}
+	}
 
-		if (LIKELY((of = __gand_of(acc.str, acc.len)) != OF_UNK)) {
-			/* first one wins */
-			break;
+	/* hot symbols come from the cache, one trip to the dict for the rest */
+	tag = dict_cache_tag();
+	for (size_t i = 0U; i < b->nent; i++) {
+		if ((b->ent[i].rid = dict_cache_get(b->ent[i].sym)) ==
+		    DICT_CACHE_NONE) {
+			nmiss++;
 		}
-	} while ((acc.str = on));
-	return of;
-}
+	}
+	if (nmiss) {
+		const char **msym;
+		dict_oid_t *mrid;
 
-static flt_t
-ser_get_filter(gand_httpd_req_t r)
-{
-	static const char Qf[] = "filter";
-	static char _f[256U];
-	gand_word_t w;
+		msym = malloc(nmiss * (sizeof(*msym) + sizeof(*mrid)));
+		if (UNLIKELY(msym == NULL)) {
+			goto interr_fin;
+		}
+		mrid = (dict_oid_t*)(msym + nmiss);
+		for (size_t i = 0U, j = 0U; i < b->nent; i++) {
+			if (b->ent[i].rid == DICT_CACHE_NONE) {
+				msym[j++] = b->ent[i].sym;
+			}
+		}
 
-	if ((w = gand_req_get_xqry(r, Qf)).str == NULL) {
-		/* just go with the flow */
-		return (flt_t){NULL};
-	} else if ((w.str += sizeof(Qf), w.len -= sizeof(Qf), false)) {
-		/* not reached */
-		;
-	} else if (w.len > sizeof(_f) - 2U) {
-		GAND_ERR_LOG("filter string too long, truncating?");
-		w.len = sizeof(_f) - 2U;
-	}
-	_f[0U] = '\0';
-	memcpy(_f + 1U, w.str, w.len);
-	_f[1U + w.len] = '\0';
-	/* massage the filter string a little */
-	for (char *fp = _f + 1U, *const ef = fp + w.len; fp < ef; fp++) {
-		if (*fp == ',') {
-			*fp = '\0';
+		d = gsymdb_acq(&gen);
+		(void)dict_get_syms(d, mrid, msym, nmiss);
+		gsymdb_rel(gen);
+
+		for (size_t i = 0U, j = 0U; i < b->nent; i++) {
+			if (b->ent[i].rid == DICT_CACHE_NONE) {
+				b->ent[i].rid = mrid[j];
+				if (LIKELY(mrid[j] != ERR_OID)) {
+					dict_cache_put(msym[j], mrid[j], tag);
+				}
+				j++;
+			}
 		}
+		free(msym);
 	}
-	return (flt_t){_f, w.len + 2U};
-}
 
-static void
-subst_rln(struct rln_s *restrict r, const char *host)
-{
-	static char *scratch;
-	static size_t zcratch;
-	static size_t scroff;
+	/* whether their files are there is seen to as they're opened */
+	for (size_t i = 0U; i < b->nent; i++) {
+		struct ser_ent_s *e = b->ent + i;
 
-	if (UNLIKELY(host == NULL)) {
-		/* reset request */
-		scroff = 0U;
-		return;
+		if (!e->rid) {
+			e->err = "Symbol not found";
+		} else if (UNLIKELY(e->rid == ERR_OID)) {
+			e->err = "Symbol lookup failed";
+		} else {
+			b->nser++;
+		}
 	}
-	if (UNLIKELY(!scroff)) {
-		/* construct URI prefix */
-		size_t hlen = strlen(host);
+	b->nmiss = b->nent - b->nser;
+	/* serve in rolf id order, that's show_lateglu/'s order too */
+	qsort(b->ent, b->nent, sizeof(*b->ent), blk_ent_cmp);
 
-		if (7U + hlen + sizeof(_eps_V0_FILES) + r->val.z > zcratch) {
-			zcratch = 7U + hlen + sizeof(_eps_V0_FILES) + r->val.z;
-			zcratch += 64U;
-			zcratch &= ~(64U - 1U);
+	prod = ser_init(s, req, of);
 
-			scratch = realloc(scratch, zcratch);
+	/* the request buffer won't outlive this call, the stream will */
+	if (req.host != NULL && UNLIKELY((s->host = strdup(req.host)) == NULL)) {
+		goto interr_fin;
+	}
+
+	if (gpool != NULL && prod == ser_prod && b->nser > 1U) {
+		/* filter them on the pool, arrow's dictionaries are
+		 * shared across series so that one stays in line */
+		if (UNLIKELY((s->job = make_ser_job(s)) == NULL)) {
+			goto interr_fin;
 		}
-		/* bang http:// */
-		memcpy(scratch, "http://", 7U);
-		scroff = 7U;
-		memcpy(scratch + scroff, host, hlen);
-		scroff += hlen;
-		memcpy(scratch + scroff, _eps_V0_FILES, sizeof(_eps_V0_FILES));
-		scroff += sizeof(_eps_V0_FILES) - 1U;
+		prod = blk_prod;
 	}
-	if (scroff + r->val.z > zcratch) {
-		zcratch = scroff + r->val.z;
-		zcratch += 64U;
-		zcratch &= ~(64U - 1U);
 
-		scratch = realloc(scratch, zcratch);
+	/* series are opened one after the other as the socket drains */
+	if (UNLIKELY((strm = make_gand_strm(prod, ser_fin, s)) == NULL)) {
+		GAND_ERR_LOG("cannot obtain stream");
+		goto interr_fin;
+	} else if (s->job != NULL) {
+		/* get the pool going */
+		s->job->strm = strm;
+		blk_push(s->job);
+	} else if (prod == arrow_prod) {
+		/* misses go before the first batch, find them now */
+		blk_chk(s, strm);
 	}
-	/* now actually subst file:// */
-	memcpy(scratch + scroff, r->val.s + 6U, r->val.z - 6U);
-	r->val.s = scratch;
-	r->val.z += scroff - 6U;
-	scratch[r->val.z] = '\0';
-	return;
+
+	GAND_INFO_LOG(":rsp [200 OK]: %zu series, %zu misses",
+		      b->nser, b->nent - b->nser);
+	return (gand_httpd_res_t){
+		.rc = 200U/*OK*/,
+		.ctyp = _ofs[s->of],
+		.clen = CLEN_UNKNOWN,
+		.rd = {DTYP_STRM, GAND_RES_DATA(strm) = strm},
+	};
+
+interr_fin:
+	ser_fin(s);
+interr:
+	GAND_INFO_LOG(":rsp [500 Internal Error]");
+	return (gand_httpd_res_t){
+		.rc = 500U/*INTERNAL ERROR*/,
+		.ctyp = OF(UNK),
+		.clen = 0U,
+		.rd = {DTYP_NONE},
+	};
 }
 
 static gand_httpd_res_t
 work_ser(gand_httpd_req_t req)
 {
-	char buf[4096U];
 	const char *sym;
 	dict_oid_t rid;
 	gand_of_t of;
 	const char *fn;
-	gandfn_t fx;
-	ssize_t(*filter)(char *restrict, size_t, struct rln_s ln, flt_t f);
-	gand_gbuf_t gb;
-	flt_t f;
+	struct ser_strm_s *s;
+	prod_f prod;
+	gand_strm_t strm;
+	gand_stmp_t stmp = {0U};
 
 	if ((of = req_get_outfmt(req)) == OF_UNK) {
 		of = OF_CSV;
 	}
-	if ((sym = req.path + sizeof(EP(V0_SERIES)))[-1] != '/') {
+	if ((sym = req.path + sizeof(EP(V0_SERIES)))[-1] == '\0' ||
+	    *sym == '\0') {
+		/* no symbol in the path, maybe they sent a list */
+		if ((req.verb == VERB_POST && req.data.len) ||
+		    gand_req_get_xqry(req, "sym=").str != NULL) {
+			return work_blk(req);
+		}
+	}
+	if (sym[-1] != '/') {
 		static const char errmsg[] = "Bad Request\n";
 
 		GAND_INFO_LOG(":rsp [400 Bad request]");
@@ -693,7 +2541,17 @@ work_ser(gand_httpd_req_t req)
 			.clen = sizeof(errmsg)- 1U,
 			.rd = {DTYP_DATA, GAND_RES_DATA(data) = errmsg},
 		};
-	} else if (!(rid = dict_get_sym(gsymdb, sym))) {
+	} else if (UNLIKELY((rid = gsymdb_get_sym(sym)) == ERR_OID)) {
+		static const char errmsg[] = "Symbol lookup failed\n";
+
+		GAND_INFO_LOG(":rsp [503 Service Unavailable]: lookup failed");
+		return (gand_httpd_res_t){
+			.rc = 503U/*SERVICE UNAVAILABLE*/,
+			.ctyp = OF(UNK),
+			.clen = sizeof(errmsg)- 1U,
+			.rd = {DTYP_DATA, GAND_RES_DATA(data) = errmsg},
+		};
+	} else if (!rid) {
 		static const char errmsg[] = "Symbol not found\n";
 
 		GAND_INFO_LOG(":rsp [409 Conflict]: Symbol not found");
@@ -708,124 +2566,121 @@ work_ser(gand_httpd_req_t req)
 	/* otherwise we've got some real yacka to do */
 	if (UNLIKELY((fn = make_lateglu_name(rid)) == NULL)) {
 		goto interr;
-	} else if ((fx = mmapat_fn(trolf_dirfd, fn, O_RDONLY)).fd < 0) {
+	} else if (UNLIKELY((s = calloc(1U, sizeof(*s))) == NULL)) {
 		goto interr;
 	}
 
-	/* obtain the filter */
-	f = ser_get_filter(req);
+	prod = ser_init(s, req, of);
+	of = s->of;
 
-	switch (of) {
-	default:
-	case OF_CSV:
-		of = OF_CSV;
-		filter = filter_csv;
-		break;
-	case OF_JSON:
-		filter = filter_json;
-		break;
-	}
+	/* maybe we've served this very response before */
+	with (struct stat st) {
+		gand_httpd_res_t res;
 
-	/* obtain the buffer we can send bytes to */
-	const gandf_t fb = fx.fb;
-	size_t tot = 0U;
-	if (UNLIKELY((gb = make_gand_gbuf(fb.z)) == NULL)) {
-		GAND_ERR_LOG("cannot obtain gbuf");
-		goto interr_unmap;
+		if (fstatat(trolf_dirfd, fn, &st, 0) < 0) {
+			/* let mmapat_fn() fail */
+			break;
+		} else if (!ser_var(s, of, req.host)) {
+			break;
+		}
+		s->k.id = rid;
+		s->k.mtim = st.st_mtime;
+		s->k.nsec = st.st_mtim.tv_nsec;
+		s->k.size = st.st_size;
+		stmp = ser_stmp(s, &st);
+		if (gand_req_fresh_p(req, stmp)) {
+			/* they've got it already */
+			free(s);
+
+			GAND_INFO_LOG(":rsp [304 Not Modified]: series %08u", rid);
+			return (gand_httpd_res_t){
+				.rc = 304U/*NOT MODIFIED*/,
+				.ctyp = _ofs[of],
+				.clen = 0U,
+				.rd = {DTYP_NONE},
+				.stmp = stmp,
+			};
+		} else if ((res = ser_cached(s, req)).rc) {
+			free(s);
+
+			GAND_INFO_LOG(":rsp [200 OK]: series %08u, cached", rid);
+			res.ctyp = _ofs[of];
+			res.stmp = stmp;
+			return res;
+		}
 	}
 
-	/* traverse the lines, filter and rewrite them */
-	with (ssize_t z) {
-	bfilt:
-		z = filter(buf + tot, sizeof(buf) - tot, FILTER_FRST, nul_flt);
-
-		if (z < -1) {
-			/* flush buffer */
-			if (UNLIKELY(gand_gbuf_write(gb, buf, tot) < 0)) {
-				GAND_ERR_LOG("cannot write to gbuf");
-				goto interr_unmap_unbuf;
-			}
-			tot = 0U;
-			goto bfilt;
-		} else if (z >= 0) {
-			tot += z;
-		}
+	if (ser_open(s, fn) < 0) {
+		goto interr_free;
 	}
-	for (size_t i = 0U; i < fb.z; i++) {
-		const char *const bol = (const char*)fb.d + i;
-		const size_t max = fb.z - i;
-		const char *eol;
-		struct rln_s ln;
-		ssize_t z;
 
-		if (UNLIKELY((eol = memchr(bol, '\n', max)) == NULL)) {
-			eol = bol + max;
+	/* fill the caches as we go */
+	with (struct stat st) {
+		if (!s->k.varz) {
+			/* not to be cached */
+			break;
+		} else if (UNLIKELY(fstat(s->fx.fd, &st) < 0)) {
+			break;
 		}
-		/* snarf the line, v0 format, zero copy */
-		ln = snarf_rln(bol, eol - bol);
-
-		if (UNLIKELY(ln.val.z > 7U &&
-			     !memcmp(ln.val.s, "file://", 7U))) {
-			subst_rln(&ln, req.host);
-		}
-	filt:
-		/* filter, maybe */
-		z = filter(buf + tot, sizeof(buf) - tot, ln, f);
-		if (UNLIKELY(z < -1)) {
-			/* flush buffer */
-			if (UNLIKELY(gand_gbuf_write(gb, buf, tot) < 0)) {
-				GAND_ERR_LOG("cannot write to gbuf");
-				goto interr_unmap_unbuf;
-			}
-			tot = 0U;
-			goto filt;
-		} else if (UNLIKELY(z < 0)) {
-			/* `just' an error */
-			goto next;
+		/* this is what we're actually serving */
+		s->k.mtim = st.st_mtime;
+		s->k.nsec = st.st_mtim.tv_nsec;
+		s->k.size = st.st_size;
+		stmp = ser_stmp(s, &st);
+		if (gand_rcache_fits_p(s->fx.fb.z)) {
+			s->rb = make_gand_rbuf(s->fx.fb.z);
+		} else if (gand_rcache_fits_p(0U)) {
+			/* might still fit once filtered */
+			s->rb = make_gand_rbuf(0U);
 		}
-		tot += z;
-	next:
-		i += eol - bol;
-	}
-	/* flush filter */
-	with (ssize_t z) {
-	efilt:
-		z = filter(buf + tot, sizeof(buf) - tot, FILTER_LAST, nul_flt);
-
-		if (z < -1) {
-			/* flush buffer */
-			if (UNLIKELY(gand_gbuf_write(gb, buf, tot) < 0)) {
-				GAND_ERR_LOG("cannot write to gbuf");
-				goto interr_unmap_unbuf;
-			}
-			tot = 0U;
-			goto efilt;
-		} else if (z >= 0) {
-			tot += z;
+#if defined HAVE_ZLIB_H
+		if (req_gzip_p(req)) {
+			s->var[1U] = 'z';
+			s->ze = gand_zcache_put(ser_zkey(s));
+			s->var[1U] = '\0';
 		}
+#endif	/* HAVE_ZLIB_H */
 	}
-	/* reset subst'er */
-	subst_rln(NULL, NULL);
 
-	/* flush */
-	if (UNLIKELY(gand_gbuf_write(gb, buf, tot) < 0)) {
-		GAND_ERR_LOG("cannot write to gbuf");
-		goto interr_unmap_unbuf;
+	/* the request buffer won't outlive this call, the stream will */
+	if (req.host != NULL && UNLIKELY((s->host = strdup(req.host)) == NULL)) {
+		goto interr_unmap;
+	}
+
+	/* lines are filtered and rewritten as the socket drains */
+	if (UNLIKELY((strm = make_gand_strm(
+			      prod, ser_fin, s)) == NULL)) {
+		GAND_ERR_LOG("cannot obtain stream");
+		goto interr_unmap;
+	} else if (!ser_resident_p(s)) {
+		/* don't have the loop wait for the disk */
+		ser_warm(s, strm);
 	}
 
-	munmap_fn(fx);
 	GAND_INFO_LOG(":rsp [200 OK]: series %08u", rid);
 	return (gand_httpd_res_t){
 		.rc = 200U/*OK*/,
 		.ctyp = _ofs[of],
 		.clen = CLEN_UNKNOWN,
-		.rd = {DTYP_GBUF, GAND_RES_DATA(gbuf) = gb},
+		.rd = {DTYP_STRM, GAND_RES_DATA(strm) = strm},
+		.stmp = stmp,
 	};
 
-interr_unmap_unbuf:
-	free_gand_gbuf(gb);
 interr_unmap:
-	munmap_fn(fx);
+	if (s->rb != NULL) {
+		free_gand_rbuf(s->rb);
+	}
+#if defined HAVE_ZLIB_H
+	if (s->ze != NULL) {
+		gand_zcache_abort(s->ze);
+	}
+#endif	/* HAVE_ZLIB_H */
+	munmap_fn(s->fx);
+	if (s->host != NULL) {
+		free(s->host);
+	}
+interr_free:
+	free(s);
 interr:
 	GAND_INFO_LOG(":rsp [500 Internal Error]");
 	return (gand_httpd_res_t){
@@ -890,8 +2745,12 @@ work_src(gand_httpd_req_t req)
 	const char *src;
 	gand_of_t of;
 	gand_gbuf_t gb;
+	unsigned int gen;
+	dict_t d;
 
-	if ((of = req_get_outfmt(req)) == OF_UNK) {
+	if ((of = req_get_outfmt(req)) == OF_UNK ||
+	    of == OF_COL || of == OF_ARROW) {
+		/* sources don't come in columns */
 		of = OF_CSV;
 	}
 	if ((src = req.path + sizeof(EP(V0_SOURCES)))[-1] == '\0' ||
@@ -915,7 +2774,9 @@ work_src(gand_httpd_req_t req)
 		GAND_ERR_LOG("cannot obtain gbuf");
 		goto interr_unmap;
 	}
-	for (dict_si_t si; (si = dict_src_iter(gsymdb, src)).sid;) {
+	/* the iterators keep static state, hold the dict throughout */
+	d = gsymdb_acq(&gen);
+	for (dict_si_t si; (si = dict_src_iter(d, src)).sid;) {
 		char sym[256U];
 		size_t len = strlen(si.sym);
 
@@ -927,6 +2788,7 @@ work_src(gand_httpd_req_t req)
 		sym[len++] = '\n';
 		gand_gbuf_write(gb, sym, len);
 	}
+	gsymdb_rel(gen);
 
 	GAND_INFO_LOG(":rsp [200 OK]: source %s", src);
 	return (gand_httpd_res_t){
@@ -1116,6 +2978,34 @@ static void
 stat_cb(EV_P_ ev_stat *e, int UNUSED(revents))
 {
 	GAND_NOTI_LOG("symbol index file `%s' changed ...", e->path);
+#if defined USE_MPH
+	with (dict_t nu, old) {
+		unsigned int g;
+
+		if ((nu = open_dict(e->path, O_RDONLY)) == NULL) {
+			/* keep serving from the old index */
+			GAND_ERR_LOG("cannot open symbol index file `%s': %s",
+				     e->path, strerror(errno));
+			break;
+		}
+		old = __sync_lock_test_and_set(&gsymdb, nu);
+		g = __sync_fetch_and_add(&gsymdb_gen, 1U);
+		/* lookups are short, just wait for the old readers */
+		while (gsymdb_nrd[g & 1U]) {
+			sched_yield();
+		}
+		if (old != NULL) {
+			close_dict(old);
+		}
+		dict_cache_flush();
+		GAND_INFO_LOG(":inot symbol index file reloaded");
+	}
+#else  /* !USE_MPH */
+# if defined USE_VIRTUOSO
+	pthread_rwlock_wrlock(&gsymdb_rwl);
+# else  /* !USE_VIRTUOSO */
+	pthread_mutex_lock(&gsymdb_mtx);
+# endif	/* USE_VIRTUOSO */
 	if (gsymdb != NULL) {
 		close_dict(gsymdb);
 	}
@@ -1125,6 +3015,28 @@ stat_cb(EV_P_ ev_stat *e, int UNUSED(revents))
 	} else {
 		GAND_INFO_LOG(":inot symbol index file reloaded");
 	}
+# if defined USE_VIRTUOSO
+	pthread_rwlock_unlock(&gsymdb_rwl);
+# else  /* !USE_VIRTUOSO */
+	pthread_mutex_unlock(&gsymdb_mtx);
+# endif	/* USE_VIRTUOSO */
+	dict_cache_flush();
+#endif	/* USE_MPH */
+	return;
+}
+
+static void
+sighup_cb(EV_P_ ev_signal *UNUSED(w), int UNUSED(revents))
+{
+	const gand_rcache_stats_t st = gand_rcache_stats();
+	const dict_cache_stats_t ds = dict_cache_stats();
+
+	GAND_NOTI_LOG("\
+response cache: %zu hits, %zu misses, %zu evictions, %zu entries (%zu bytes)",
+		      st.hits, st.misses, st.evictions, st.nent, st.curz);
+	GAND_NOTI_LOG("\
+symbol cache: %zu hits, %zu misses, %zu evictions, %zu entries",
+		      ds.hits, ds.misses, ds.evictions, ds.nent);
 	return;
 }
 
@@ -1139,6 +3051,9 @@ main(int argc, char *argv[])
 	gand_httpd_t h = NULL;
 	int daemonisep = 0;
 	short unsigned int port = 8080;
+	unsigned int nwrk = 1U;
+	size_t max_hdr = 0U;
+	size_t max_body = 0U;
 	/* paths and files */
 	const char *pidf = NULL;
 	const char *wwwd;
@@ -1147,6 +3062,8 @@ main(int argc, char *argv[])
 	const char *dictf = NULL;
 	/* inotify watcher */
 	ev_stat dict_watcher;
+	/* cache statistics */
+	ev_signal hup_watcher;
 	cfg_t cfg = NULL;
 	int rc = 0;
 
@@ -1290,14 +3207,111 @@ cannot open database file `%s'", dictf);
 		}
 	}
 
+	/* threads to filter bulk requests on */
+	with (long int njob = sysconf(_SC_NPROCESSORS_ONLN)) {
+		if (argi->jobs_arg) {
+			/* command line has precedence */
+			njob = strtol(argi->jobs_arg, NULL, 10);
+		} else if (cfg && cfg_glob_lookup_i(cfg, "jobs") > 0) {
+			njob = cfg_glob_lookup_i(cfg, "jobs");
+		}
+		if (njob > 0 && (gpool = make_gand_pool(njob)) == NULL) {
+			GAND_ERR_LOG("\
+cannot spawn pool, filtering bulk requests in the event loop");
+		}
+	}
+#if defined HAVE_ZLIB_H
+	/* sidecar cache for compressed responses */
+	with (const char *cchd) {
+		size_t cchz = 1024U;
+
+		if ((cchd = argi->cachedir_arg) ||
+		    (cfg && cfg_glob_lookup_s(&cchd, cfg, "cachedir") > 0)) {
+			/* command line has precedence */
+			;
+		} else {
+			/* no cache then */
+			break;
+		}
+		if (argi->cachesize_arg) {
+			cchz = strtoul(argi->cachesize_arg, NULL, 10);
+		} else if (cfg && cfg_glob_lookup_i(cfg, "cachesize") > 0) {
+			cchz = cfg_glob_lookup_i(cfg, "cachesize");
+		}
+		if (gand_zcache_init(cchd, cchz << 20U, gpool) < 0) {
+			GAND_ERR_LOG("cannot use cache directory `%s': %s",
+				     cchd, strerror(errno));
+		}
+	}
+#endif	/* HAVE_ZLIB_H */
+
+	/* in-memory cache for responses */
+	with (size_t cchz = 128U) {
+		if (argi->memcache_arg) {
+			/* command line has precedence */
+			cchz = strtoul(argi->memcache_arg, NULL, 10);
+		} else if (cfg && cfg_glob_lookup_i(cfg, "memcache") > 0) {
+			cchz = cfg_glob_lookup_i(cfg, "memcache");
+		}
+		(void)gand_rcache_init(cchz << 20U);
+	}
+
+	/* lookup cache in front of the dict */
+	with (size_t nsym = 65536U, ttl = 300U) {
+		if (argi->symcache_arg) {
+			/* command line has precedence */
+			nsym = strtoul(argi->symcache_arg, NULL, 10);
+		} else if (cfg && cfg_glob_lookup_i(cfg, "symcache") > 0) {
+			nsym = cfg_glob_lookup_i(cfg, "symcache");
+		}
+		if (argi->symttl_arg) {
+			ttl = strtoul(argi->symttl_arg, NULL, 10);
+		} else if (cfg && cfg_glob_lookup_i(cfg, "symttl") > 0) {
+			ttl = cfg_glob_lookup_i(cfg, "symttl");
+		}
+		if (dict_cache_init(nsym, ttl) < 0) {
+			GAND_ERR_LOG("cannot set up symbol cache");
+		}
+	}
+
 	/* server config */
 	port = gand_get_port(cfg);
+	if (argi->workers_arg) {
+		/* command line has precedence */
+		nwrk = strtoul(argi->workers_arg, NULL, 10);
+	} else if (cfg) {
+		nwrk = cfg_glob_lookup_i(cfg, "workers");
+	}
+	if (nwrk < 1U) {
+		nwrk = 1U;
+	}
+
+	/* request limits, 0 means the server's defaults */
+	if (argi->max_header_arg) {
+		/* command line has precedence */
+		max_hdr = strtoul(argi->max_header_arg, NULL, 10);
+	} else if (cfg && cfg_glob_lookup_i(cfg, "max-header") > 0) {
+		max_hdr = cfg_glob_lookup_i(cfg, "max-header");
+	}
+	if (argi->max_body_arg) {
+		max_body = strtoul(argi->max_body_arg, NULL, 10);
+	} else if (cfg && cfg_glob_lookup_i(cfg, "max-body") > 0) {
+		max_body = cfg_glob_lookup_i(cfg, "max-body");
+	}
+
+	/* cold series are read in the background */
+	if (gand_aio_init(gpool) < 0) {
+		GAND_NOTI_LOG("cold series will be read in the event loop");
+	}
 #define make_gand_httpd(p...)	make_gand_httpd((gand_httpd_param_t){p})
 	/* configure the gand server */
 	h = make_gand_httpd(
 		.port = port, .timeout = 500000U,
 		.www_dir = wwwd,
-		.workf = work);
+		.workf = work,
+		.nworkers = nwrk,
+		.max_hdr = max_hdr,
+		.max_body = max_body);
 #undef make_gand_httpd
 
 	if (UNLIKELY(h == NULL)) {
@@ -1310,6 +3324,9 @@ cannot open database file `%s'", dictf);
 	with (void *loop = ev_default_loop(EVFLAG_AUTO)) {
 		ev_stat_init(&dict_watcher, stat_cb, dictf, 0);
 		ev_stat_start(EV_A_ &dict_watcher);
+
+		ev_signal_init(&hup_watcher, sighup_cb, SIGHUP);
+		ev_signal_start(EV_A_ &hup_watcher);
 	}
 
 	/* main loop */
@@ -1325,9 +3342,17 @@ cannot open database file `%s'", dictf);
 	/* also we need an inotify on this guy */
 	with (void *loop = ev_default_loop(EVFLAG_AUTO)) {
 		ev_stat_stop(EV_A_ &dict_watcher);
+		ev_signal_stop(EV_A_ &hup_watcher);
 	}
 
 clos:
+	/* collect background work, it might still wake streams,
+	 * the ring hands its failures to the pool, so the pool goes last */
+	gand_aio_fini();
+	if (gpool != NULL) {
+		free_gand_pool(gpool);
+	}
+
 	/* away with the http */
 	if (h != NULL) {
 		free_gand_httpd(h);
@@ -1344,6 +3369,11 @@ clos:
 	if (trolf_dirfd >= 0) {
 		close(trolf_dirfd);
 	}
+	gand_rcache_fini();
+	dict_cache_fini();
+#if defined HAVE_ZLIB_H
+	gand_zcache_fini();
+#endif	/* HAVE_ZLIB_H */
 
 	/* dictf was strdup'd */
 	if (dictf != NULL) {
@@ -49,11 +49,10 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/stat.h>
-#if defined USE_REDLAND
-# include <sys/types.h>
-# include <dirent.h>
-#endif	/* USE_REDLAND */
+#include <sys/types.h>
+#include <dirent.h>
 #include "gand-dict.h"
+#include "gand-didx.h"
 #include "nifty.h"
 
 typedef unsigned int dict_id_t;
@@ -61,6 +60,9 @@ typedef unsigned int dict_id_t;
 static char *idxf = DICT_DEFAULT;
 static char *idxp;
 
+/* symbols per dict_get_syms() call */
+#define GET_BATCH	(512U)
+
 
 static __attribute__((format(printf, 1, 2))) void
 serror(const char *fmt, ...)
@@ -125,7 +127,10 @@ add_sym(dict_t d, const char *sym)
 /* add SYM with id SID (or if 0 generate one) and return the SID. */
 	dict_oid_t sid;
 
-	if ((sid = dict_get_sym(d, sym))) {
+	if (UNLIKELY((sid = dict_get_sym(d, sym)) == ERR_OID)) {
+		/* can't tell if it's there, leave it */
+		sid = NUL_OID;
+	} else if (sid) {
 		/* ok, nothing to do */
 		;
 	} else if (UNLIKELY(!(sid = dict_next_oid(d)))) {
@@ -139,6 +144,27 @@ add_sym(dict_t d, const char *sym)
 	return sid;
 }
 
+static void
+prnt_syms(dict_t d, const char *const *syms, size_t n)
+{
+/* resolve N symbols, at most GET_BATCH, in one go and print their ids */
+	dict_oid_t sids[GET_BATCH];
+
+	(void)dict_get_syms(d, sids, syms, n);
+	for (size_t i = 0U; i < n; i++) {
+		if (UNLIKELY(sids[i] == ERR_OID)) {
+			fprintf(stderr, "\
+cannot look up symbol `%s'\n", syms[i]);
+			sids[i] = NUL_OID;
+		} else if (!sids[i]) {
+			fprintf(stderr, "\
+no symbol `%s' in index file\n", syms[i]);
+		}
+		printf("%08u\n", sids[i]);
+	}
+	return;
+}
+
 
 #include "gandaux.yucc"
 
@@ -166,20 +192,45 @@ cmd_addget(const struct yuck_cmd_get_s argi[static 1U], bool addp)
 		goto out;
 	}
 
-	if (argi->nargs) {
+	if (argi->nargs && !addp) {
+		const char *const *syms = (const char*const*)argi->args;
+
+		for (size_t i = 0U; i < argi->nargs; i += GET_BATCH) {
+			size_t n = argi->nargs - i;
+
+			prnt_syms(d, syms + i, n < GET_BATCH ? n : GET_BATCH);
+		}
+	} else if (argi->nargs) {
 		for (unsigned int i = 0U; i < argi->nargs; i++) {
 			const char *sym = argi->args[i];
 			dict_id_t id;
 
-			if (addp && !(id = add_sym(d, sym))) {
+			if (!(id = add_sym(d, sym))) {
 				fprintf(stderr, "\
 cannot add symbol `%s'\n", sym);
-			} else if (!addp && !(id = dict_get_sym(d, sym))) {
-				fprintf(stderr, "\
-no symbol `%s' in index file\n", sym);
 			}
 			printf("%08u\n", id);
 		}
+	} else if (!addp) {
+		/* get symlist from stdin, GET_BATCH lines at a time */
+		char *line[GET_BATCH] = {NULL};
+		size_t llen[GET_BATCH] = {0UL};
+		size_t n = 0U;
+		ssize_t nrd;
+
+		while ((nrd = getline(line + n, llen + n, stdin)) > 0) {
+			line[n][nrd - 1U] = '\0';
+			if (++n >= GET_BATCH) {
+				prnt_syms(d, (const char*const*)line, n);
+				n = 0U;
+			}
+		}
+		if (n) {
+			prnt_syms(d, (const char*const*)line, n);
+		}
+		for (size_t i = 0U; i < GET_BATCH; i++) {
+			free(line[i]);
+		}
 	} else {
 		/* get symlist from stdin */
 		char *line = NULL;
@@ -192,12 +243,9 @@ no symbol `%s' in index file\n", sym);
 			dict_id_t id;
 
 			line[ssz] = '\0';
-			if (addp && !(id = add_sym(d, sym))) {
+			if (!(id = add_sym(d, sym))) {
 				fprintf(stderr, "\
 cannot add symbol `%s'\n", sym);
-			} else if (!addp && !(id = dict_get_sym(d, sym))) {
-				fprintf(stderr, "\
-no symbol `%s' in index file\n", sym);
 			}
 			printf("%08u\n", id);
 		}
@@ -354,6 +402,88 @@ out:
 	return rc;
 }
 
+static int
+idx_trolf(const char *trlf, unsigned int step)
+{
+/* index all series files in TRLF/show_lateglu/NNNN/ */
+	DIR *d;
+	int tfd;
+	int dfd;
+	int rc = 0;
+
+	if ((tfd = open(trlf, O_RDONLY | O_DIRECTORY)) < 0) {
+		goto err;
+	}
+	dfd = openat(tfd, "show_lateglu", O_RDONLY | O_DIRECTORY);
+	close(tfd);
+	if (dfd < 0) {
+		goto err;
+	} else if ((d = fdopendir(dfd)) == NULL) {
+		close(dfd);
+		goto err;
+	}
+	for (struct dirent *de; (de = readdir(d)) != NULL;) {
+		DIR *sd;
+		int sfd;
+
+		if (de->d_name[0U] == '.') {
+			continue;
+		} else if ((sfd = openat(
+				    dfd, de->d_name,
+				    O_RDONLY | O_DIRECTORY)) < 0) {
+			continue;
+		} else if ((sd = fdopendir(sfd)) == NULL) {
+			close(sfd);
+			continue;
+		}
+		for (struct dirent *se; (se = readdir(sd)) != NULL;) {
+			/* sidecars and temporaries have dots in them */
+			if (strchr(se->d_name, '.') != NULL) {
+				continue;
+			} else if (gand_didx_build(sfd, se->d_name, step) < 0) {
+				serror("\
+cannot index `%s/show_lateglu/%s/%s'", trlf, de->d_name, se->d_name);
+				rc = 1;
+			}
+		}
+		closedir(sd);
+	}
+	closedir(d);
+	return rc;
+
+err:
+	serror("cannot access series files in `%s'", trlf);
+	return 1;
+}
+
+static int
+cmd_index(const struct yuck_cmd_index_s argi[static 1U])
+{
+	unsigned int step = 64U;
+	int rc = 0;
+
+	if (!argi->nargs && argi->trolfdir_arg == NULL) {
+		yuck_auto_help((const void*)argi);
+		return 1;
+	} else if (argi->every_arg &&
+		   !(step = strtoul(argi->every_arg, NULL, 10))) {
+		errno = 0;
+		serror("invalid value for --every: `%s'", argi->every_arg);
+		return 1;
+	}
+
+	for (size_t i = 0U; i < argi->nargs; i++) {
+		if (gand_didx_build(AT_FDCWD, argi->args[i], step) < 0) {
+			serror("cannot index `%s'", argi->args[i]);
+			rc = 1;
+		}
+	}
+	if (argi->trolfdir_arg != NULL) {
+		rc |= idx_trolf(argi->trolfdir_arg, step);
+	}
+	return rc;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -399,6 +529,9 @@ main(int argc, char *argv[])
 	case GANDAUX_CMD_DUMP:
 		rc = cmd_dump((const void*)argi);
 		break;
+	case GANDAUX_CMD_INDEX:
+		rc = cmd_index((const void*)argi);
+		break;
 	}
 
 out:
@@ -39,6 +39,7 @@
 #endif	/* HAVE_CONFIG_H */
 #include <stdlib.h>
 #include <unistd.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -48,6 +49,8 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/resource.h>
 #if defined HAVE_SYS_SENDFILE_H
 # include <sys/sendfile.h>
 #endif	/* HAVE_SYS_SENDFILE_H */
@@ -69,10 +72,30 @@ struct _httpd_ctx_s {
 
 	/* this is the header with the server line appended */
 	off_t off_ctyp;
-	char proto[256U];
+	char proto[512U];
 };
 typedef struct _httpd_ctx_s *restrict _httpd_ctx_t;
 
+/* worker, i.e. an event loop with its own listener socket */
+struct _httpd_wrk_s {
+	/* private copy of the context, proto is scribbled on per request */
+	struct _httpd_ctx_s ctx[1U];
+
+	struct ev_loop *loop;
+
+	ev_io sock;
+	/* to unroll worker loops from the main thread */
+	ev_async quit;
+	/* to resume parked streams, see gand_strm_wake() */
+	ev_async kick;
+	/* streams whose producer has nothing to offer yet */
+	struct gand_strm_s *park;
+	/* the server we work for */
+	struct _httpd_s *srv;
+
+	pthread_t thr;
+};
+
 /* private version of struct gand_httpd_s */
 struct _httpd_s {
 	/* the context is the bit we pass around */
@@ -85,7 +108,14 @@ struct _httpd_s {
 
 	struct ev_loop *loop;
 
-	ev_io sock;
+	/* connection counts across all workers */
+	size_t max_conns;
+	size_t cur_conns;
+	size_t peak_conns;
+
+	/* worker 0 runs on the default loop in the main thread */
+	size_t nwrk;
+	struct _httpd_wrk_s wrk[];
 };
 
 /* massage the EV macroes a bit */
@@ -106,6 +136,9 @@ Server: ";
 #define OFF_STATUS	sizeof("HTTP/1.1")
 #define OFF_DATE	32U
 #define OFF_CLEN	103U
+/* beginning and end of the Content-Length line */
+#define BOL_CLEN	(OFF_CLEN - sizeof("Content-Length: ") + 1U)
+#define EOL_CLEN	(OFF_CLEN + sizeof("01234567\r\n") - 1U)
 
 
 /* our take on memmem() */
@@ -193,10 +226,55 @@ xstrlcpy(char *restrict dst, const char *src, size_t dsz)
 	return ssz;
 }
 
+static size_t
+xfmtetag(char *restrict buf, size_t bsz, gand_stmp_t st)
+{
+/* print ST as ETag, weak because compressed and uncompressed
+ * representations share it */
+	int z;
+
+	z = snprintf(
+		buf, bsz, "W/\"%llx-%llx-%llx.%lx",
+		(unsigned long long)st.ino,
+		(unsigned long long)st.size,
+		(unsigned long long)st.mtim,
+		(unsigned long)st.nsec);
+	if (st.var && z > 0 && (size_t)z < bsz) {
+		z += snprintf(buf + z, bsz - z, "-%x", st.var);
+	}
+	if (z > 0 && (size_t)z < bsz) {
+		z += snprintf(buf + z, bsz - z, "\"");
+	}
+	if (UNLIKELY(z < 0 || (size_t)z >= bsz)) {
+		return 0U;
+	}
+	return z;
+}
+
+static int
+xparsedate(time_t *restrict tgt, const char *str, size_t len)
+{
+/* parse http dates (IMF-fixdate only) */
+	struct tm tm = {0};
+	char buf[64U];
+
+	if (len >= sizeof(buf)) {
+		return -1;
+	}
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	if (strptime(buf, "%a, %d %b %Y %H:%M:%S", &tm) == NULL) {
+		return -1;
+	}
+	*tgt = timegm(&tm);
+	return 0;
+}
+
 
 /* socket goodness */
 #if !defined MAX_DCCP_CONNECTION_BACK_LOG
-# define MAX_DCCP_CONNECTION_BACK_LOG	(5U)
+/* bursts of hundreds of clients connecting at once are common */
+# define MAX_DCCP_CONNECTION_BACK_LOG	(SOMAXCONN)
 #endif  /* !MAX_DCCP_CONNECTION_BACK_LOG */
 
 static int
@@ -209,6 +287,8 @@ make_tcp(void)
 	}
 	/* reuse addr in case we quickly need to turn the server off and on */
 	setsock_reuseaddr(s);
+	/* have the kernel distribute connections among our workers */
+	setsock_reuseport(s);
 	/* turn lingering on */
 	setsock_linger(s, 1);
 	return s;
@@ -236,16 +316,22 @@ log_conn(int fd, ud_sockaddr_t sa)
 }
 
 
-/* gbuf buffers, at the moment this is just a wrapper around malloc() */
+/* gbuf buffers, at the moment this is just a wrapper around malloc()
+ * buffers are per worker thread, they're obtained in the worker's
+ * workf() and returned upon dequeuing the response in the same thread
+ * streams hold on to theirs for as long as they're sent, so once the
+ * MAX_GBUFS are taken gbufs come off the heap and go back there */
 #define MAX_GBUFS	(256U)
 #define _X_GBUFS	(32U)
 /* roughly a tcp packet minus http header */
 #define GBUF_MINZ	(1024U)
-static uint32_t used_gbufs[MAX_GBUFS / _X_GBUFS];
-static struct gand_gbuf_s {
+static __thread uint32_t used_gbufs[MAX_GBUFS / _X_GBUFS];
+static __thread struct gand_gbuf_s {
 	unsigned int zbuf;
 	unsigned int ibuf;
 	uint8_t *data;
+	/* set for gbufs off the heap */
+	unsigned int heap;
 } gbufs[MAX_GBUFS];
 
 enum gand_cmpr_e {
@@ -267,7 +353,12 @@ make_gand_gbuf(size_t estz)
 			goto found;
 		}
 	}
-	return NULL;
+	/* all taken, overflow to the heap */
+	if (UNLIKELY((res = calloc(1U, sizeof(*res))) == NULL)) {
+		return NULL;
+	}
+	res->heap = 1U;
+	goto shape;
 
 found:
 	/* toggle bit in used_gbufs */
@@ -275,6 +366,7 @@ found:
 	used_gbufs[i] ^= 1UL << k;
 	res = gbufs + (i * _X_GBUFS) + k;
 
+shape:
 	/* now check if we fulfill the size requirements */
 	if (UNLIKELY(estz < GBUF_MINZ)) {
 		/* grrr, our users are too indecisive */
@@ -285,6 +377,9 @@ found:
 		res->data = realloc(res->data, res->zbuf = estz);
 		if (UNLIKELY(res->data == NULL)) {
 			res->zbuf = 0U;
+			if (res->heap) {
+				free(res);
+			}
 			return NULL;
 		}
 	}
@@ -296,7 +391,12 @@ free_gand_gbuf(gand_gbuf_t gb)
 {
 	const size_t k = gb - gbufs;
 
-	if (UNLIKELY(k >= countof(gbufs))) {
+	if (gb->heap) {
+		/* overflow buffer, no pooling */
+		free(gb->data);
+		free(gb);
+		return;
+	} else if (UNLIKELY(k >= countof(gbufs))) {
 		/* that's not our buffer */
 		GAND_CRIT_LOG("unknown gbuf passed to free_gand_gbuf()");
 		return;
@@ -324,10 +424,10 @@ free_gand_gbuf(gand_gbuf_t gb)
 	return;
 }
 
-ssize_t
-gand_gbuf_write(gand_gbuf_t gb, const void *p, size_t z)
+static int
+_gbuf_resv(gand_gbuf_t gb, size_t z)
 {
-/* just like write(3) but to a resizable gbuf */
+/* make sure there's room for Z more bytes in GB */
 	if (gb->ibuf + z > gb->zbuf) {
 		/* calculate the new size
 		 * along with the halving upon free() this
@@ -340,6 +440,16 @@ gand_gbuf_write(gand_gbuf_t gb, const void *p, size_t z)
 			return -1;
 		}
 	}
+	return 0;
+}
+
+ssize_t
+gand_gbuf_write(gand_gbuf_t gb, const void *p, size_t z)
+{
+/* just like write(3) but to a resizable gbuf */
+	if (UNLIKELY(_gbuf_resv(gb, z) < 0)) {
+		return -1;
+	}
 	/* and copy we go */
 	if (LIKELY(z > 0U)) {
 		memcpy(gb->data + gb->ibuf, p, z);
@@ -350,131 +460,627 @@ gand_gbuf_write(gand_gbuf_t gb, const void *p, size_t z)
 	return z;
 }
 
+
+/* refcounted buffers, unlike gbufs these are malloc()'d individually
+ * and may be referenced by any number of responses in any thread,
+ * used for responses that are kept around, e.g. in caches */
+struct gand_rbuf_s {
+	size_t refc;
+	size_t zbuf;
+	size_t ibuf;
+	uint8_t *data;
+};
+
+gand_rbuf_t
+make_gand_rbuf(size_t estz)
+{
+	gand_rbuf_t res;
+
+	if (UNLIKELY(estz < GBUF_MINZ)) {
+		estz = GBUF_MINZ;
+	}
+	if (UNLIKELY((res = malloc(sizeof(*res))) == NULL)) {
+		return NULL;
+	} else if (UNLIKELY((res->data = malloc(estz)) == NULL)) {
+		free(res);
+		return NULL;
+	}
+	res->refc = 1U;
+	res->zbuf = estz;
+	res->ibuf = 0U;
+	return res;
+}
+
+void
+free_gand_rbuf(gand_rbuf_t rb)
+{
+	if (__sync_sub_and_fetch(&rb->refc, 1U) > 0U) {
+		/* still in use */
+		return;
+	}
+	free(rb->data);
+	free(rb);
+	return;
+}
+
+gand_rbuf_t
+gand_rbuf_ref(gand_rbuf_t rb)
+{
+	__sync_add_and_fetch(&rb->refc, 1U);
+	return rb;
+}
+
+ssize_t
+gand_rbuf_write(gand_rbuf_t rb, const void *p, size_t z)
+{
+	if (rb->ibuf + z > rb->zbuf) {
+		size_t nu = rb->zbuf;
+		uint8_t *tmp;
+
+		for (; rb->ibuf + z > nu; nu *= 2U);
+		if (UNLIKELY((tmp = realloc(rb->data, nu)) == NULL)) {
+			return -1;
+		}
+		rb->data = tmp;
+		rb->zbuf = nu;
+	}
+	if (LIKELY(z > 0U)) {
+		memcpy(rb->data + rb->ibuf, p, z);
+		rb->ibuf += z;
+	}
+	return z;
+}
+
+size_t
+gand_rbuf_size(gand_rbuf_t rb)
+{
+	return rb->ibuf;
+}
+
+
+/* streams, data is produced chunk by chunk into a staging gbuf
+ * whenever the socket is writable, each chunk is framed for
+ * chunked transfer encoding right away
+ *
+ * compressed streams have the producer write to a raw buffer instead
+ * which is deflated into the staging buffer, the compressor state
+ * lives as long as the response, this way compressing big responses
+ * never blocks the event loop for longer than a chunk's worth */
+#define STRM_CHUNKZ	(16384U)
+
+struct gand_strm_s {
+	ssize_t(*prod)(void *clo, gand_gbuf_t);
+	void(*fin)(void *clo);
+	void *clo;
+	/* staging buffer with the chunk in flight, framing included */
+	gand_gbuf_t stg;
+	/* how much of STG has been sent */
+	size_t so;
+	/* set once everything's been staged */
+	unsigned int eos;
+	/* set when the producer had nothing to offer yet */
+	unsigned int stall;
+	/* set by gand_strm_wake(), possibly from another thread */
+	volatile unsigned int woke;
+	/* worker to kick upon waking, and the write watcher and
+	 * links into its list of parked streams whilst parked */
+	struct _httpd_wrk_s *volatile wrk;
+	ev_io *w;
+	struct gand_strm_s **prev, *next;
+
+	enum gand_cmpr_e cmpr;
 #if defined HAVE_ZLIB_H
-static int
-cmpr_gbuf(gand_gbuf_t gb, enum gand_cmpr_e cl)
+	/* set once the producer is exhausted */
+	unsigned int eoi;
+	/* current compression level */
+	int lvl;
+	/* what the producer wrote, yet to be compressed */
+	gand_gbuf_t raw;
+	z_stream *z;
+#endif	/* HAVE_ZLIB_H */
+};
+
+gand_strm_t
+make_gand_strm(
+	ssize_t(*prod)(void *clo, gand_gbuf_t),
+	void(*fin)(void *clo), void *clo)
+{
+	gand_strm_t res;
+
+	if (UNLIKELY((res = calloc(1U, sizeof(*res))) == NULL)) {
+		return NULL;
+	} else if (UNLIKELY((res->stg = make_gand_gbuf(STRM_CHUNKZ)) == NULL)) {
+		free(res);
+		return NULL;
+	}
+	res->prod = prod;
+	res->fin = fin;
+	res->clo = clo;
+	return res;
+}
+
+void
+free_gand_strm(gand_strm_t s)
 {
-	z_stream zstr = {
-		.next_in = gb->data,
-		.avail_in = gb->ibuf,
-		.total_in = 0UL,
+	if (s->fin != NULL) {
+		s->fin(s->clo);
+	}
+	if (s->w != NULL) {
+		/* still parked, unlink */
+		if ((*s->prev = s->next) != NULL) {
+			s->next->prev = s->prev;
+		}
+	}
+#if defined HAVE_ZLIB_H
+	if (s->z != NULL) {
+		(void)deflateEnd(s->z);
+		free(s->z);
+	}
+	if (s->raw != NULL) {
+		free_gand_gbuf(s->raw);
+	}
+#endif	/* HAVE_ZLIB_H */
+	free_gand_gbuf(s->stg);
+	free(s);
+	return;
+}
 
-		.total_out = 0UL,
+void
+gand_strm_wake(gand_strm_t s)
+{
+	struct _httpd_wrk_s *k;
 
-		.zalloc = Z_NULL,
-		.zfree = Z_NULL,
+	/* only the first wake-up after parking needs a kick */
+	if (!__sync_fetch_and_or(&s->woke, 1U) && (k = s->wrk) != NULL) {
+		ev_async_send(k->loop, &k->kick);
+	}
+	return;
+}
 
-		.data_type = Z_TEXT,
-	};
+#if defined HAVE_ZLIB_H
+static int
+_cmpr_lvl(size_t z)
+{
+/* compression level for responses of size Z (so far),
+ * we favour speed the bigger the response, levels are compared
+ * so spell out zlib's default rather than Z_DEFAULT_COMPRESSION (-1) */
+	if (z < 65536U) {
+		return 6;
+	} else if (z < 1048576U) {
+		return 3;
+	}
+	return Z_BEST_SPEED;
+}
+
+static int
+_strm_deflate(gand_strm_t s, enum gand_cmpr_e cl, size_t estz)
+{
+/* have S's data compressed as it's produced,
+ * ESTZ is the size of the data if known beforehand, 0 otherwise */
+	z_stream *z;
 	int rc;
 
-	if (cl == CMPR_NONE) {
-		/* nothing to do, is there */
-		return 0;
+	if (s->raw == NULL && (s->raw = make_gand_gbuf(STRM_CHUNKZ)) == NULL) {
+		return -1;
+	} else if (UNLIKELY((z = calloc(1U, sizeof(*z))) == NULL)) {
+		return -1;
 	}
 
+	s->lvl = _cmpr_lvl(estz);
 	rc = deflateInit2(
-		&zstr, Z_BEST_SPEED, Z_DEFLATED,
-		(cl == CMPR_GZIP ? 16 : 0) + 15, 9, Z_DEFAULT_STRATEGY);
+		z, s->lvl, Z_DEFLATED,
+		(cl == CMPR_GZIP ? 16 : 0) + 15, 8, Z_DEFAULT_STRATEGY);
 	if (UNLIKELY(rc != Z_OK)) {
+		free(z);
 		return -1;
 	}
-	/* reset the length of our gbuf */
-	gb->ibuf = 0UL;
-	/* here's the actual compression, do it all in one go */
-	do {
-		unsigned char b[4096U];
-		size_t n;
+	z->next_in = s->raw->data;
+	z->avail_in = s->raw->ibuf;
+	s->z = z;
+	s->cmpr = cl;
+	return 0;
+}
+
+/* producer over an rbuf, for compression */
+struct _rbuf_rd_s {
+	gand_rbuf_t rb;
+	size_t o;
+	size_t z;
+};
+
+static ssize_t
+_rbuf_prod(void *clo, gand_gbuf_t gb)
+{
+	struct _rbuf_rd_s *rd = clo;
+	size_t z = rd->z - rd->o;
+
+	if (z > STRM_CHUNKZ) {
+		z = STRM_CHUNKZ;
+	}
+	if (UNLIKELY(gand_gbuf_write(gb, rd->rb->data + rd->o, z) < 0)) {
+		return -1;
+	}
+	rd->o += z;
+	return z;
+}
+
+static void
+_rbuf_fin(void *clo)
+{
+	struct _rbuf_rd_s *rd = clo;
+
+	free_gand_rbuf(rd->rb);
+	free(rd);
+	return;
+}
+
+static void
+_cmpr_res(gand_httpd_res_t *restrict r, enum gand_cmpr_e cl)
+{
+/* have R's data compressed as it's sent, gbufs and rbufs are turned
+ * into streams for that matter, anything else is sent as is */
+	gand_strm_t s;
 
-		zstr.next_out = b;
-		zstr.avail_out = sizeof(b);
-		if ((rc = deflate(&zstr, Z_FINISH)) < 0) {
+	switch (r->rd.dtyp) {
+	case DTYP_GBUF:
+		if (UNLIKELY((s = make_gand_strm(NULL, NULL, NULL)) == NULL)) {
 			break;
-		} else if ((n = sizeof(b) - zstr.avail_out) > zstr.total_in) {
-			/* uh oh, we actually inflated the stream,
-			 * best to go then and leave the whole shebang
-			 * uncompressed */
-			if (!gb->ibuf) {
-				/* re-establish the original size iff
-				 * we haven't copied anything yet */
-				gb->ibuf = zstr.avail_in + zstr.total_in;
+		}
+		/* the gbuf is our raw data and there won't be more */
+		with (gand_gbuf_t gb = r->rd GAND_RES_DATA(gbuf)) {
+			if (r->clen != CLEN_UNKNOWN && r->clen < gb->ibuf) {
+				gb->ibuf = r->clen;
 			}
+			s->raw = gb;
+			s->eoi = 1U;
+		}
+		if (UNLIKELY(_strm_deflate(s, cl, s->raw->ibuf) < 0)) {
+			/* best to send the buffer uncompressed then aye? */
+			GAND_ERR_LOG("cannot compress response");
+			s->raw = NULL;
+			free_gand_strm(s);
 			break;
 		}
+		r->rd.dtyp = DTYP_STRM;
+		r->rd GAND_RES_DATA(strm) = s;
+		break;
+
+	case DTYP_RBUF:
+		/* rbufs are shared, feed the compressor bit by bit */
+		with (struct _rbuf_rd_s *rd) {
+			if (UNLIKELY((rd = malloc(sizeof(*rd))) == NULL)) {
+				break;
+			}
+			rd->rb = r->rd GAND_RES_DATA(rbuf);
+			rd->o = 0U;
+			rd->z = rd->rb->ibuf;
+			if (r->clen != CLEN_UNKNOWN && r->clen < rd->z) {
+				rd->z = r->clen;
+			}
+			s = make_gand_strm(_rbuf_prod, _rbuf_fin, rd);
+			if (UNLIKELY(s == NULL)) {
+				free(rd);
+				break;
+			} else if (UNLIKELY(_strm_deflate(s, cl, rd->z) < 0)) {
+				/* send it uncompressed, our reference stays */
+				GAND_ERR_LOG("cannot compress response");
+				s->fin = NULL;
+				free_gand_strm(s);
+				free(rd);
+				break;
+			}
+		}
+		r->rd.dtyp = DTYP_STRM;
+		r->rd GAND_RES_DATA(strm) = s;
+		break;
 
-		/* copy back to our buffer */
-		memcpy(gb->data + gb->ibuf, b, n);
-		gb->ibuf += n;
-	} while (zstr.avail_out == 0U);
+	case DTYP_STRM:
+		if ((s = r->rd GAND_RES_DATA(strm)) == NULL) {
+			break;
+		} else if (UNLIKELY(_strm_deflate(s, cl, 0U) < 0)) {
+			GAND_ERR_LOG("cannot compress response");
+		}
+		break;
 
-	/* finalise, return code doesn't matter */
-	(void)deflateEnd(&zstr);
-	return rc;
+	default:
+		break;
+	}
+	return;
 }
+
+static int
+_stg_zdata(gand_strm_t s)
+{
+/* have the producer's data deflated into the staging buffer,
+ * stop after a chunk's worth of output or a few chunks' worth of
+ * input, whichever comes first, so as to not hog the event loop with
+ * highly compressible data */
+	gand_gbuf_t gb = s->stg;
+	const size_t o = gb->ibuf;
+	z_stream *z = s->z;
+	const uLong i = z->total_in;
+
+	do {
+		int lvl;
+		int rc;
+
+		if (!z->avail_in && !s->eoi) {
+			/* refill the raw buffer */
+			ssize_t n;
+
+			s->raw->ibuf = 0U;
+			if ((n = s->prod(s->clo, s->raw)) == GAND_STRM_AGAIN) {
+				/* flush what we've got so far */
+				s->stall = 1U;
+			} else if (UNLIKELY(n < 0)) {
+				return -1;
+			} else if (!n) {
+				s->eoi = 1U;
+			}
+			z->next_in = s->raw->data;
+			z->avail_in = s->raw->ibuf;
+		}
+
+		/* make sure the compressor's got room to write to */
+		if (UNLIKELY(_gbuf_resv(gb, 4096U) < 0)) {
+			return -1;
+		}
+		z->next_out = gb->data + gb->ibuf;
+		z->avail_out = gb->zbuf - gb->ibuf;
+
+		/* bigger responses get cheaper levels */
+		if ((lvl = _cmpr_lvl(z->total_in)) < s->lvl &&
+		    deflateParams(z, lvl, Z_DEFAULT_STRATEGY) == Z_OK) {
+			s->lvl = lvl;
+		}
+		rc = deflate(z, s->eoi && !z->avail_in ? Z_FINISH :
+			     s->stall ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+		gb->ibuf = z->next_out - gb->data;
+
+		if (rc == Z_STREAM_END) {
+			s->eos = 1U;
+			break;
+		} else if (UNLIKELY(rc < 0 && rc != Z_BUF_ERROR)) {
+			return -1;
+		}
+	} while (!(s->stall && !z->avail_in && z->avail_out) &&
+		 gb->ibuf - o < STRM_CHUNKZ &&
+		 z->total_in - i < 4U * STRM_CHUNKZ);
+	return 0;
+}
+#endif	/* HAVE_ZLIB_H */
+
+static int
+_stg_data(gand_strm_t s)
+{
+/* have the producer write into the staging buffer directly */
+	gand_gbuf_t gb = s->stg;
+	const size_t o = gb->ibuf;
+
+	do {
+		ssize_t z;
+
+		if ((z = s->prod(s->clo, gb)) == GAND_STRM_AGAIN) {
+			/* come back when we're woken */
+			s->stall = 1U;
+			break;
+		} else if (UNLIKELY(z < 0)) {
+			return -1;
+		} else if (!z) {
+			s->eos = 1U;
+			break;
+		}
+	} while (gb->ibuf - o < STRM_CHUNKZ);
+	return 0;
+}
+
+static int
+_stg_chunk(gand_strm_t s)
+{
+/* have the producer fill S's staging buffer with the next chunk */
+	static const char eoc[] = "0\r\n\r\n";
+	gand_gbuf_t gb = s->stg;
+	const size_t o = gb->ibuf;
+	size_t n;
+	int rc;
+
+	/* reserve room for the chunk size, 8 hex digits and CRLF */
+	s->stall = 0U;
+	if (UNLIKELY(gand_gbuf_write(gb, "00000000\r\n", 10U) < 0)) {
+		return -1;
+	}
+#if defined HAVE_ZLIB_H
+	rc = s->z != NULL ? _stg_zdata(s) : _stg_data(s);
+#else  /* !HAVE_ZLIB_H */
+	rc = _stg_data(s);
 #endif	/* HAVE_ZLIB_H */
+	if (UNLIKELY(rc < 0)) {
+		return -1;
+	}
+
+	if (!(n = gb->ibuf - o - 10U)) {
+		/* don't send empty chunks, they mean something else */
+		gb->ibuf = o;
+	} else if (UNLIKELY(n > 0xffffffffU)) {
+		/* won't fit the 8 digits reserved */
+		return -1;
+	} else {
+		/* fill in the chunk size */
+		snprintf((char*)gb->data + o, 9U, "%08x", (unsigned int)n);
+		gb->data[o + 8U] = '\r';
+		if (UNLIKELY(gand_gbuf_write(gb, "\r\n", 2U) < 0)) {
+			return -1;
+		}
+	}
+	if (s->eos && UNLIKELY(gand_gbuf_write(gb, eoc, sizeof(eoc) - 1U) < 0)) {
+		return -1;
+	}
+	return 0;
+}
+
 
 
-/* libev conn handling */
-#define MAX_CONNS	(sizeof(free_conns) * 8U)
-#define MAX_QUEUE	MAX_CONNS
-static uint64_t free_conns = -1;
-static struct gand_conn_s {
+/* libev conn handling
+ * connections are carved from slabs of CONN_SLAB entries, each worker
+ * thread keeps its own slabs and a free list of unused connections,
+ * the total number of connections is bounded by RLIMIT_NOFILE only
+ *
+ * the write queue is a ring of INL_QUEUE items inside the connection,
+ * should more responses be pipelined the ring is moved to an overflow
+ * block of MAX_QUEUE items from the (per-thread) pool and handed back
+ * once the queue runs dry */
+#define CONN_SLAB	(64U)
+#define INL_QUEUE	(4U)
+#define MAX_QUEUE	(64U)
+struct gand_wrqi_s {
+	gand_httpd_res_t res;
+	/* in case of sendfile this is the source socket */
+	int fd;
+	/* how much have we sent already */
+	off_t o;
+	/* what's left to transmit */
+	size_t z;
+	/* byte ranges of the file to transmit, NULL for all of it */
+	struct gand_rng_s *rng;
+};
+
+static __thread union gand_wrqx_u {
+	union gand_wrqx_u *next;
+	struct gand_wrqi_s q[MAX_QUEUE];
+} *free_wrqx;
+
+static __thread struct gand_conn_s {
 	ev_io r;
 	ev_io w;
 	unsigned int nwr;
 	unsigned int iwr;
-	struct gand_wrqi_s {
-		gand_httpd_res_t res;
-		/* in case of sendfile this is the source socket */
-		int fd;
-		/* how much have we sent already */
-		off_t o;
-		/* what's left to transmit */
-		size_t z;
-	} queue[MAX_QUEUE];
-} conns[MAX_CONNS];
-
-/* compression support hack */
-#define DTYP_GBUF_DEFLATE	(enum gand_dtyp_e)(DTYP_GBUF + CMPR_DEFLATE)
-#define DTYP_GBUF_GZIP		(enum gand_dtyp_e)(DTYP_GBUF + CMPR_GZIP)
+	/* overflow queue, if non-NULL it supersedes the inline one */
+	union gand_wrqx_u *xq;
+	/* input buffer, requests are accumulated here until complete,
+	 * IBO is the beginning of the current request, IBN the fill level,
+	 * ISC the offset (relative to IBO) to resume header scanning */
+	char *ibuf;
+	size_t ibz;
+	size_t ibo;
+	size_t ibn;
+	size_t isc;
+	/* next connection on the free list */
+	struct gand_conn_s *next;
+	/* must come last, it's not cleared by free_conn() */
+	struct gand_wrqi_s queue[INL_QUEUE];
+} *free_conns;
+
+static __thread struct gand_conn_slab_s {
+	struct gand_conn_slab_s *next;
+	struct gand_conn_s c[CONN_SLAB];
+} *conn_slabs;
+
+/* connections hand back their input buffer once it's drained, the
+ * last one of minimum size is kept for the next read on this thread */
+static __thread char *spare_ibuf;
 
 static struct gand_conn_s*
-make_conn(void)
+make_conn(struct _httpd_s *h)
 {
-	int i = ffs(free_conns & 0xffffffffU)
-		?: ffs(free_conns >> 32U & 0xffffffffU);
+	struct gand_conn_s *res;
+	size_t n;
+
+	if (UNLIKELY((n = __sync_add_and_fetch(&h->cur_conns, 1U)) >
+		     h->max_conns)) {
+		goto fail;
+	} else if (UNLIKELY(free_conns == NULL)) {
+		/* get a new slab and chain its connections up */
+		struct gand_conn_slab_s *s;
 
-	if (LIKELY(i-- > 0)) {
-		/* toggle bit in free conns */
-		free_conns ^= 1ULL << i;
-		return conns + i;
+		if (UNLIKELY((s = calloc(1, sizeof(*s))) == NULL)) {
+			goto fail;
+		}
+		s->next = conn_slabs;
+		conn_slabs = s;
+		for (size_t i = CONN_SLAB; i-- > 0U;) {
+			s->c[i].next = free_conns;
+			free_conns = s->c + i;
+		}
 	}
+	/* pop one off the free list */
+	res = free_conns;
+	free_conns = res->next;
+	res->next = NULL;
+
+	/* keep track of the high-water mark */
+	for (size_t p; (p = h->peak_conns) < n &&
+		     !__sync_bool_compare_and_swap(&h->peak_conns, p, n););
+	return res;
+
+fail:
+	__sync_sub_and_fetch(&h->cur_conns, 1U);
 	return NULL;
 }
 
 static void
 free_conn(struct gand_conn_s *c)
 {
-	size_t i = c - conns;
+	/* the context is the first slot of the worker */
+	const struct _httpd_wrk_s *k = c->r.data;
 
-	if (UNLIKELY(i >= MAX_CONNS)) {
-		/* huh? */
-		GAND_CRIT_LOG("unknown connection passed to free_conn()");
-		return;
+	if (UNLIKELY(c->xq != NULL)) {
+		/* return overflow queue to the pool */
+		c->xq->next = free_wrqx;
+		free_wrqx = c->xq;
 	}
-	/* toggle C-th bit */
-	free_conns ^= 1ULL << i;
-	memset(c, 0, sizeof(*c));
+	if (c->ibuf != NULL) {
+		free(c->ibuf);
+	}
+	/* queue items are initialised upon enqueuing, leave them be */
+	memset(c, 0, offsetof(struct gand_conn_s, queue));
+	/* push onto free list */
+	c->next = free_conns;
+	free_conns = c;
+	__sync_sub_and_fetch(&k->srv->cur_conns, 1U);
 	return;
 }
 
-static inline __attribute__((const, pure)) struct gand_wrqi_s*
+static inline unsigned int
+_q_size(const struct gand_conn_s *c)
+{
+	return LIKELY(c->xq == NULL) ? INL_QUEUE : MAX_QUEUE;
+}
+
+static inline struct gand_wrqi_s*
+_q_item(struct gand_conn_s *c, unsigned int i)
+{
+	if (LIKELY(c->xq == NULL)) {
+		return c->queue + i % INL_QUEUE;
+	}
+	return c->xq->q + i % MAX_QUEUE;
+}
+
+static int
+_q_spill(struct gand_conn_s *restrict c)
+{
+/* move the inline queue to an overflow block */
+	union gand_wrqx_u *x;
+
+	if (LIKELY((x = free_wrqx) != NULL)) {
+		free_wrqx = x->next;
+	} else if (UNLIKELY((x = malloc(sizeof(*x))) == NULL)) {
+		return -1;
+	}
+	for (unsigned int i = 0U; i < c->nwr; i++) {
+		x->q[i] = c->queue[(c->iwr + i) % INL_QUEUE];
+	}
+	c->iwr = 0U;
+	c->xq = x;
+	return 0;
+}
+
+static inline __attribute__((pure)) struct gand_wrqi_s*
 _top_resp(struct gand_conn_s *c)
 {
 	if (UNLIKELY(c->nwr == 0U)) {
 		return NULL;
 	}
-	return c->queue + c->iwr;
+	return _q_item(c, c->iwr);
 }
 
 static inline struct gand_wrqi_s*
@@ -482,18 +1088,272 @@ _bot_resp(struct gand_conn_s *restrict c)
 {
 	if (UNLIKELY(c->nwr >= MAX_QUEUE)) {
 		return NULL;
+	} else if (UNLIKELY(c->nwr >= _q_size(c) && _q_spill(c) < 0)) {
+		return NULL;
 	}
-	return c->queue + (c->iwr + c->nwr) % MAX_QUEUE;
+	return _q_item(c, c->iwr + c->nwr);
 }
 
+/* byte ranges, files are sent as a list of segments then, each either
+ * a bit of file or, for multipart responses, a bit of memory holding
+ * part headers */
+#define MAX_RANGES	(16U)
+
+struct gand_rng_s {
+	/* number of segments and the one in flight */
+	unsigned int n;
+	unsigned int i;
+	/* Content-Range line for single ranges and 416s */
+	char crng[64U];
+	/* content type of multipart responses */
+	char ctyp[64U];
+	struct gand_rseg_s {
+		/* memory if non-NULL, file data at offset O otherwise */
+		const char *p;
+		off_t o;
+		size_t z;
+	} s[];
+};
+
 static int
-_enq_resp(_httpd_ctx_t ctx, struct gand_conn_s *restrict c, gand_httpd_res_t r)
+_rng_parse(off_t rs[static MAX_RANGES][2U], const char *str, size_t len, off_t fz)
+{
+/* parse a byte range set, return the number of satisfiable ranges
+ * or -1 if the set is malformed or too long */
+	const char *sp = str, *const ep = str + len;
+	int n = 0;
+
+	for (int i = 0; sp < ep; i++) {
+		unsigned long long a, b;
+		char *on;
+
+		for (; sp < ep && xisspace(*sp); sp++);
+		if (UNLIKELY(i >= (int)MAX_RANGES)) {
+			return -1;
+		} else if (sp < ep && *sp == '-') {
+			/* suffix range */
+			b = strtoull(++sp, &on, 10);
+			if (on == sp || on > ep) {
+				return -1;
+			} else if (!b || !fz) {
+				/* unsatisfiable */
+				goto next;
+			}
+			a = b < (unsigned long long)fz ? fz - b : 0U;
+			b = fz - 1;
+		} else {
+			a = strtoull(sp, &on, 10);
+			if (on == sp || on >= ep || *on != '-') {
+				return -1;
+			}
+			sp = on + 1U;
+			b = strtoull(sp, &on, 10);
+			if (on > ep) {
+				return -1;
+			} else if (on == sp) {
+				/* open ended */
+				b = fz - 1;
+			} else if (b < a) {
+				return -1;
+			}
+			if (a >= (unsigned long long)fz) {
+				/* unsatisfiable */
+				goto next;
+			} else if (b >= (unsigned long long)fz) {
+				b = fz - 1;
+			}
+		}
+		rs[n][0U] = a;
+		rs[n][1U] = b;
+		n++;
+	next:
+		for (sp = on; sp < ep && xisspace(*sp); sp++);
+		if (sp < ep && *sp++ != ',') {
+			return -1;
+		}
+	}
+	return n;
+}
+
+static int
+_rng_res(
+	struct gand_wrqi_s *restrict x, gand_httpd_res_t *restrict r,
+	const struct stat *st, gand_httpd_req_t q)
+{
+/* set X up to send the ranges of R's file that Q asks for,
+ * return non-0 if it's a ranged response, i.e. a 206 or 416 */
+	static const char pfx[] = "bytes=";
+	off_t rs[MAX_RANGES][2U];
+	struct gand_rng_s *rng;
+	gand_word_t w;
+	int n;
+
+	if (r->rc != 200U || r->cenc != NULL || !S_ISREG(st->st_mode)) {
+		return 0;
+	} else if ((w = gand_req_get_xhdr(q, "Range")).str == NULL) {
+		return 0;
+	} else if (w.len < sizeof(pfx) || memcmp(w.str, pfx, sizeof(pfx) - 1U)) {
+		/* only know bytes */
+		return 0;
+	} else if ((n = _rng_parse(
+			    rs, w.str + sizeof(pfx) - 1U,
+			    w.len - (sizeof(pfx) - 1U), st->st_size)) < 0) {
+		/* ignore the lot */
+		return 0;
+	}
+	/* ranges of a file that has changed since are no good */
+	with (gand_word_t ir = gand_req_get_xhdr(q, "If-Range")) {
+		time_t t;
+
+		if (ir.str == NULL) {
+			;
+		} else if (xparsedate(&t, ir.str, ir.len) < 0 ||
+			   t != st->st_mtime) {
+			/* our etags are weak and never match */
+			return 0;
+		}
+	}
+
+	if (!n) {
+		/* nothing satisfiable */
+		if (UNLIKELY((rng = malloc(sizeof(*rng))) == NULL)) {
+			return 0;
+		}
+		rng->n = rng->i = 0U;
+		snprintf(rng->crng, sizeof(rng->crng),
+			 "Content-Range: bytes */%llu\r\n",
+			 (unsigned long long)st->st_size);
+		r->rc = 416U;
+		x->z = 0U;
+	} else if (n == 1) {
+		/* just the one */
+		if (UNLIKELY((rng = malloc(
+				      sizeof(*rng) + sizeof(*rng->s))) == NULL)) {
+			return 0;
+		}
+		rng->n = 1U;
+		rng->i = 0U;
+		rng->s->p = NULL;
+		rng->s->o = rs[0U][0U];
+		rng->s->z = rs[0U][1U] - rs[0U][0U] + 1U;
+		snprintf(rng->crng, sizeof(rng->crng),
+			 "Content-Range: bytes %llu-%llu/%llu\r\n",
+			 (unsigned long long)rs[0U][0U],
+			 (unsigned long long)rs[0U][1U],
+			 (unsigned long long)st->st_size);
+		r->rc = 206U;
+		x->z = rng->s->z;
+	} else {
+		/* multipart, part headers go right behind the segments */
+		const size_t phz = 160U + strlen(r->ctyp);
+		const size_t nseg = 2U * n + 1U;
+		char bnd[24U];
+		char *bp;
+
+		if (UNLIKELY((rng = malloc(
+				      sizeof(*rng) + nseg * sizeof(*rng->s) +
+				      (n + 1U) * phz)) == NULL)) {
+			return 0;
+		}
+		bp = (char*)(rng->s + nseg);
+		snprintf(bnd, sizeof(bnd), "%016llx",
+			 (unsigned long long)st->st_mtime ^
+			 (unsigned long long)st->st_ino << 20U ^
+			 (unsigned long long)(uintptr_t)rng);
+		snprintf(rng->ctyp, sizeof(rng->ctyp),
+			 "multipart/byteranges; boundary=%s", bnd);
+		rng->crng[0U] = '\0';
+		rng->n = nseg;
+		rng->i = 0U;
+		x->z = 0U;
+		for (int i = 0; i < n; i++) {
+			int z = snprintf(
+				bp, phz, "\r\n--%s\r\n\
+Content-Type: %s\r\n\
+Content-Range: bytes %llu-%llu/%llu\r\n\r\n",
+				bnd, r->ctyp,
+				(unsigned long long)rs[i][0U],
+				(unsigned long long)rs[i][1U],
+				(unsigned long long)st->st_size);
+
+			rng->s[2U * i].p = bp;
+			rng->s[2U * i].z = z;
+			rng->s[2U * i + 1U].p = NULL;
+			rng->s[2U * i + 1U].o = rs[i][0U];
+			rng->s[2U * i + 1U].z = rs[i][1U] - rs[i][0U] + 1U;
+			x->z += z + rng->s[2U * i + 1U].z;
+			bp += z;
+		}
+		/* closing delimiter */
+		rng->s[nseg - 1U].p = bp;
+		rng->s[nseg - 1U].z = snprintf(bp, phz, "\r\n--%s--\r\n", bnd);
+		x->z += rng->s[nseg - 1U].z;
+		r->rc = 206U;
+		r->ctyp = rng->ctyp;
+	}
+	x->o = 0U;
+	x->rng = rng;
+	return 1;
+}
+
+static ssize_t
+_tx_rng(int fd, struct gand_wrqi_s *restrict x)
+{
+/* send (some of) the segment in flight */
+	struct gand_rng_s *rng = x->rng;
+	ssize_t z;
+
+	for (; rng->i < rng->n && !rng->s[rng->i].z; rng->i++);
+	if (rng->i >= rng->n) {
+		return 0;
+	}
+	with (struct gand_rseg_s *sg = rng->s + rng->i) {
+		if (sg->p != NULL) {
+			if ((z = send(fd, sg->p, sg->z, 0)) > 0) {
+				sg->p += z;
+			}
+		} else {
+			/* sendfile() advances the offset */
+			z = sendfile(fd, x->fd, &sg->o, sg->z);
+		}
+		if (z > 0) {
+			sg->z -= z;
+		}
+	}
+	return z;
+}
+
+static int
+_cond_res(gand_httpd_res_t *restrict r, const struct stat *st, gand_httpd_req_t q)
+{
+/* stamp R with ST's validators unless it's been stamped already,
+ * return non-0 if Q can be answered with a 304 */
+	if (r->rc != 200U) {
+		return 0;
+	} else if (!S_ISREG(st->st_mode)) {
+		return 0;
+	} else if (!r->stmp.mtim) {
+		r->stmp = (gand_stmp_t){
+			.ino = st->st_ino,
+			.size = st->st_size,
+			.mtim = st->st_mtime,
+			.nsec = st->st_mtim.tv_nsec,
+		};
+	}
+	return gand_req_fresh_p(q, r->stmp);
+}
+
+static int
+_enq_resp(
+	_httpd_ctx_t ctx, struct gand_conn_s *restrict c,
+	gand_httpd_res_t r, gand_httpd_req_t q)
 {
 	struct gand_wrqi_s *x;
 
 	if (UNLIKELY((x = _bot_resp(c)) == NULL)) {
 		return -1;
 	}
+	x->rng = NULL;
 
 	switch (r.rd.dtyp) {
 		const char *fn;
@@ -524,11 +1384,15 @@ _enq_resp(_httpd_ctx_t ctx, struct gand_conn_s *restrict c, gand_httpd_res_t r)
 			goto fail;
 		} else if (st.st_size < 0) {
 			goto fail;
+		} else if (r.rd.dtyp == DTYP_FILE && _cond_res(&r, &st, q)) {
+			goto notmod;
 		}
 		/* enqueue the request */
-		x->z = st.st_size;
-		x->o = 0U;
 		x->fd = fd;
+		if (r.rd.dtyp == DTYP_TMPF || !_rng_res(x, &r, &st, q)) {
+			x->z = st.st_size;
+			x->o = 0U;
+		}
 		break;
 
 	case DTYP_SOCK:
@@ -538,11 +1402,15 @@ _enq_resp(_httpd_ctx_t ctx, struct gand_conn_s *restrict c, gand_httpd_res_t r)
 			goto fail;
 		} else if (st.st_size < 0) {
 			goto fail;
+		} else if (_cond_res(&r, &st, q)) {
+			goto notmod;
 		}
 		/* enqueue now */
-		x->z = st.st_size;
-		x->o = 0U;
 		x->fd = fd;
+		if (!_rng_res(x, &r, &st, q)) {
+			x->z = st.st_size;
+			x->o = 0U;
+		}
 		break;
 
 	fail:
@@ -550,6 +1418,27 @@ _enq_resp(_httpd_ctx_t ctx, struct gand_conn_s *restrict c, gand_httpd_res_t r)
 		close(fd);
 		return -1;
 
+	notmod:
+		/* client's copy is still good */
+		close(fd);
+		r.rc = 304U;
+		r.cenc = NULL;
+		r.rd.dtyp = DTYP_NONE;
+		x->z = 0U;
+		x->o = 0U;
+		x->fd = -1;
+		break;
+
+	case DTYP_STRM:
+		if (UNLIKELY(r.rd GAND_RES_DATA(strm) == NULL)) {
+			return -1;
+		}
+		/* length is unknown, streams are sent chunked */
+		x->z = 0U;
+		x->o = 0U;
+		x->fd = -1;
+		break;
+
 	case DTYP_DATA:
 		x->z = r.clen;
 		x->o = 0U;
@@ -565,19 +1454,10 @@ _enq_resp(_httpd_ctx_t ctx, struct gand_conn_s *restrict c, gand_httpd_res_t r)
 		x->fd = -1;
 		break;
 
-	case DTYP_GBUF_DEFLATE:
-	case DTYP_GBUF_GZIP:
-#if defined HAVE_ZLIB_H
-	{
-		enum gand_cmpr_e cl = (enum gand_cmpr_e)(r.rd.dtyp - DTYP_GBUF);
-
-		if (UNLIKELY(cmpr_gbuf(r.rd GAND_RES_DATA(gbuf), cl) < 0)) {
-			/* best to send the buffer uncompressed then aye? */
-			GAND_ERR_LOG("cannot compress response");
+	case DTYP_RBUF:
+		if (LIKELY((x->z = r.clen) == CLEN_UNKNOWN)) {
+			x->z = r.rd GAND_RES_DATA(rbuf)->ibuf;
 		}
-	}
-#endif	/* HAVE_ZLIB_H */
-		x->z = r.rd GAND_RES_DATA(gbuf)->ibuf;
 		x->o = 0U;
 		x->fd = -1;
 		break;
@@ -609,22 +1489,38 @@ _deq_resp(struct gand_conn_s *restrict c)
 	case DTYP_SOCK:
 		/* close the source descriptor in either case */
 		close(x->fd);
+		if (x->rng != NULL) {
+			free(x->rng);
+		}
+		break;
+
+	case DTYP_STRM:
+		free_gand_strm(x->res.rd GAND_RES_DATA(strm));
 		break;
 
 	case DTYP_GBUF:
-	case DTYP_GBUF_GZIP:
-	case DTYP_GBUF_DEFLATE:
 		/* free gand buffers */
 		free_gand_gbuf(x->res.rd GAND_RES_DATA(gbuf));
 		break;
+
+	case DTYP_RBUF:
+		/* others might still be sending it */
+		free_gand_rbuf(x->res.rd GAND_RES_DATA(rbuf));
+		break;
 	}
 
 	/* now actually dequeue */
-	if (UNLIKELY(++c->iwr >= MAX_QUEUE)) {
+	if (UNLIKELY(++c->iwr >= _q_size(c))) {
 		/* modulo */
 		c->iwr = 0U;
 	}
-	c->nwr--;
+	if (!--c->nwr && UNLIKELY(c->xq != NULL)) {
+		/* back to the inline queue, overflow block goes to the pool */
+		c->xq->next = free_wrqx;
+		free_wrqx = c->xq;
+		c->xq = NULL;
+		c->iwr = 0U;
+	}
 	return 0;
 }
 
@@ -659,15 +1555,55 @@ shut_conn(struct gand_conn_s *c)
 		/* all's shut down and closed already, bugger off */
 		return;
 	}
-	close(fd);
-	free_conn(c);
+	close(fd);
+	free_conn(c);
+	return;
+}
+
+static void
+fini_conns(EV_P)
+{
+/* close this thread's live connections, their queued responses and
+ * parked streams go with them, then give back the slabs */
+	for (struct gand_conn_slab_s *s = conn_slabs; s; s = s->next) {
+		for (size_t i = 0U; i < countof(s->c); i++) {
+			struct gand_conn_s *c = s->c + i;
+			/* the read end might be shut already */
+			const int fd = c->r.fd > 0 ? c->r.fd : c->w.fd;
+
+			if (fd <= 0) {
+				/* on the free list */
+				continue;
+			}
+			ev_io_stop(EV_A_ &c->r);
+			ev_io_stop(EV_A_ &c->w);
+			_deq_conn(c);
+			close(fd);
+			free_conn(c);
+		}
+	}
+	for (struct gand_conn_slab_s *s = conn_slabs, *n; s; s = n) {
+		n = s->next;
+		free(s);
+	}
+	conn_slabs = NULL;
+	free_conns = NULL;
+
+	free(spare_ibuf);
+	spare_ibuf = NULL;
+
+	for (union gand_wrqx_u *x = free_wrqx, *n; x; x = n) {
+		n = x->next;
+		free(x);
+	}
+	free_wrqx = NULL;
 	return;
 }
 
-static int
-_tx_hdr(int fd, _httpd_ctx_t ctx, const struct gand_wrqi_s *x)
+static size_t
+_fill_hdr(_httpd_ctx_t ctx, const struct gand_wrqi_s *x)
 {
-	struct tm *t;
+	struct tm t[1U];
 	time_t now;
 	size_t z;
 
@@ -677,7 +1613,7 @@ _tx_hdr(int fd, _httpd_ctx_t ctx, const struct gand_wrqi_s *x)
 
 	/* fill in Date */
 	time(&now);
-	t = gmtime(&now);
+	gmtime_r(&now, t);
 	strftime(ctx->proto + OFF_DATE, 30U, "%b, %d %a %Y %H:%M:%S UTC", t);
 	ctx->proto[OFF_DATE + 29U] = '\r';
 
@@ -692,20 +1628,74 @@ _tx_hdr(int fd, _httpd_ctx_t ctx, const struct gand_wrqi_s *x)
 	ctx->proto[z++] = '\n';
 
 	/* (maybe) fill in content encoding */
-	if (x->res.rd.dtyp > DTYP_GBUF) {
+	if (x->res.cenc != NULL) {
+		static const char ce[] = "Content-Encoding: ";
+
+		z += xstrlcpy(ctx->proto + z, ce, sizeof(ctx->proto) - z);
+		z += xstrlcpy(ctx->proto + z, x->res.cenc, sizeof(ctx->proto) - z);
+		ctx->proto[z++] = '\r';
+		ctx->proto[z++] = '\n';
+	} else if (x->res.rd.dtyp == DTYP_STRM &&
+		   x->res.rd GAND_RES_DATA(strm)->cmpr != CMPR_NONE) {
 		static const char *const _encs[] = {
 			[CMPR_DEFLATE] = "Content-Encoding: deflate\r\n",
 			[CMPR_GZIP] = "Content-Encoding: gzip\r\n",
 		};
-		const unsigned int e = x->res.rd.dtyp - DTYP_GBUF;
+		const unsigned int e = x->res.rd GAND_RES_DATA(strm)->cmpr;
 
 		z += xstrlcpy(ctx->proto + z, _encs[e], sizeof(ctx->proto) - z);
 	}
 
+	/* (maybe) fill in ranges */
+	if (x->rng != NULL) {
+		z += xstrlcpy(ctx->proto + z, x->rng->crng, sizeof(ctx->proto) - z);
+	} else if ((x->res.rd.dtyp == DTYP_FILE ||
+		    x->res.rd.dtyp == DTYP_SOCK) &&
+		   x->res.rc == 200U && x->res.cenc == NULL) {
+		static const char ar[] = "Accept-Ranges: bytes\r\n";
+
+		z += xstrlcpy(ctx->proto + z, ar, sizeof(ctx->proto) - z);
+	}
+
+	/* (maybe) fill in validators */
+	if (x->res.stmp.mtim) {
+		static const char et[] = "ETag: ";
+		static const char lm[] = "Last-Modified: ";
+		struct tm m[1U];
+
+		z += xstrlcpy(ctx->proto + z, et, sizeof(ctx->proto) - z);
+		z += xfmtetag(ctx->proto + z, sizeof(ctx->proto) - z, x->res.stmp);
+		ctx->proto[z++] = '\r';
+		ctx->proto[z++] = '\n';
+		z += xstrlcpy(ctx->proto + z, lm, sizeof(ctx->proto) - z);
+		gmtime_r(&x->res.stmp.mtim, m);
+		z += strftime(
+			ctx->proto + z, sizeof(ctx->proto) - z,
+			"%a, %d %b %Y %H:%M:%S GMT\r\n", m);
+	}
+
 	ctx->proto[z++] = '\r';
 	ctx->proto[z++] = '\n';
+	return z;
+}
+
+static int
+_tx_hdr(int fd, _httpd_ctx_t ctx, const struct gand_wrqi_s *x)
+{
+	const size_t z = _fill_hdr(ctx, x);
 
-	if (UNLIKELY(send(fd, ctx->proto, z, 0) < (ssize_t)z)) {
+	if (x->res.rc == 304U) {
+		/* no Content-Length, there's no content */
+		if (UNLIKELY(send(fd, ctx->proto, BOL_CLEN, MSG_MORE) <
+			     (ssize_t)BOL_CLEN)) {
+			return -1;
+		} else if (UNLIKELY(send(fd, ctx->proto + EOL_CLEN,
+					 z - EOL_CLEN, 0) <
+				    (ssize_t)(z - EOL_CLEN))) {
+			return -1;
+		}
+		return 0;
+	} else if (UNLIKELY(send(fd, ctx->proto, z, 0) < (ssize_t)z)) {
 		/* oh my god, lucky we didn't send this,
 		 * just ask to close the socket */
 		return -1;
@@ -713,12 +1703,70 @@ _tx_hdr(int fd, _httpd_ctx_t ctx, const struct gand_wrqi_s *x)
 	return 0;
 }
 
+static int
+_stg_hdr(_httpd_ctx_t ctx, const struct gand_wrqi_s *x, gand_gbuf_t gb)
+{
+/* like _tx_hdr() but into GB and with the Content-Length line
+ * swapped for a Transfer-Encoding one */
+	static const char te[] = "Transfer-Encoding: chunked\r\n";
+	const size_t z = _fill_hdr(ctx, x);
+
+	if (UNLIKELY(gand_gbuf_write(gb, ctx->proto, BOL_CLEN) < 0)) {
+		return -1;
+	} else if (UNLIKELY(gand_gbuf_write(gb, te, sizeof(te) - 1U) < 0)) {
+		return -1;
+	} else if (UNLIKELY(gand_gbuf_write(
+				    gb, ctx->proto + EOL_CLEN,
+				    z - EOL_CLEN) < 0)) {
+		return -1;
+	}
+	return 0;
+}
+
+static int
+_tx_strm(int fd, _httpd_ctx_t ctx, struct gand_wrqi_s *restrict x)
+{
+	gand_strm_t s = x->res.rd GAND_RES_DATA(strm);
+	gand_gbuf_t gb = s->stg;
+	ssize_t z;
+
+	if (s->so >= gb->ibuf) {
+		/* staging buffer's drained */
+		if (s->eos) {
+			return 1;
+		}
+		/* produce the next chunk, header first if need be */
+		gb->ibuf = 0U;
+		s->so = 0U;
+		if (UNLIKELY(!x->o && _stg_hdr(ctx, x, gb) < 0)) {
+			return -1;
+		} else if (UNLIKELY(_stg_chunk(s) < 0)) {
+			return -1;
+		} else if (!gb->ibuf) {
+			/* compressor's holding on to everything, come back */
+			return 0;
+		}
+	}
+
+	if (UNLIKELY((z = send(fd, gb->data + s->so, gb->ibuf - s->so, 0)) < 0)) {
+		/* try again when the socket's writable again */
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+	}
+	/* adjust offsets */
+	s->so += z;
+	x->o += z;
+	return s->eos && s->so >= gb->ibuf;
+}
+
 static int
 _tx_resp(int fd, _httpd_ctx_t ctx, struct gand_wrqi_s *restrict x)
 {
 	ssize_t z;
 
-	if (LIKELY(!x->o)) {
+	if (x->res.rd.dtyp == DTYP_STRM) {
+		/* streams take care of headers themselves */
+		return _tx_strm(fd, ctx, x);
+	} else if (LIKELY(!x->o)) {
 		/* cork ... */
 		tcp_cork(fd);
 
@@ -739,7 +1787,14 @@ _tx_resp(int fd, _httpd_ctx_t ctx, struct gand_wrqi_s *restrict x)
 	case DTYP_FILE:
 	case DTYP_TMPF:
 	case DTYP_SOCK:
-		z = sendfile(fd, x->fd, &x->o, x->z);
+		if (x->rng != NULL) {
+			z = _tx_rng(fd, x);
+			break;
+		}
+		/* sendfile() would advance X's offset, we do that below */
+		with (off_t o = x->o) {
+			z = sendfile(fd, x->fd, &o, x->z);
+		}
 		break;
 	case DTYP_DATA:
 		with (const char *data = x->res.rd GAND_RES_DATA(data)) {
@@ -747,12 +1802,15 @@ _tx_resp(int fd, _httpd_ctx_t ctx, struct gand_wrqi_s *restrict x)
 		}
 		break;
 	case DTYP_GBUF:
-	case DTYP_GBUF_DEFLATE:
-	case DTYP_GBUF_GZIP:
 		with (gand_gbuf_t gbuf = x->res.rd GAND_RES_DATA(gbuf)) {
 			z = send(fd, gbuf->data + x->o, x->z, 0);
 		}
 		break;
+	case DTYP_RBUF:
+		with (gand_rbuf_t rbuf = x->res.rd GAND_RES_DATA(rbuf)) {
+			z = send(fd, rbuf->data + x->o, x->z, 0);
+		}
+		break;
 	}
 
 	tcp_uncork(fd);
@@ -789,6 +1847,12 @@ parse_hdr(const char *str, size_t len)
 	gand_httpd_req_t res = {VERB_UNSUPP};
 	const char *const ep = str + len;
 	char *eox;
+	char *eoh;
+
+	/* find the end of the headers before we start scribbling */
+	if (UNLIKELY((eoh = xmemmem(str, len, "\r\n\r\n", 4U)) == NULL)) {
+		return res;
+	}
 
 	/* guess the verb first */
 	if (UNLIKELY((eox = memchr(str, ' ', len)) == NULL)) {
@@ -801,42 +1865,42 @@ parse_hdr(const char *str, size_t len)
 	if (UNLIKELY((str = ++eox) >= ep)) {
 		/* don't bother */
 		return res;
-	} else if (UNLIKELY((eox = memchr(str, ' ', ep - str)) == NULL)) {
+	} else if (UNLIKELY((eox = memchr(str, ' ', eoh - str)) == NULL)) {
 		/* no path then */
 		return res;
 	} else if (UNLIKELY(!memcmp(str, "http", 4U) &&
 			    (str[4U] == ':' ||
 			     str[4U] == 's' && str[5U] == ':'))) {
-		char *eoh;
+		char *eop;
 
 		/* absolute form, read over / and : */
 		for (str += 5U; *str == '/' || *str == ':'; str++);
 		/* save this reference as host */
 		res.host = str;
 		/* find the path */
-		if (UNLIKELY((eoh = memchr(str, '/', eox - str)) == NULL)) {
+		if (UNLIKELY((eop = memchr(str, '/', eox - str)) == NULL)) {
 			return res;
 		}
 		/* we need to squeeze a separator between host and path */
-		memmove(eoh + 1U, eoh, eox++ - str);
-		*eoh++ = '\0';
-		res.path = eoh;
+		memmove(eop + 1U, eop, eox++ - str);
+		*eop++ = '\0';
+		res.path = eop;
 	} else {
-		char *ho, *eoh;
+		char *ho, *eol;
 
 		/* path is trivial otherwise */
 		res.path = str;
 
 		/* but we have to snarf the Host: line */
-		if ((ho = xmemmem(eox, ep - eox, "Host:", 5U)) != NULL &&
-		    (eoh = memchr(ho, '\n', ep - ho)) != NULL) {
+		if ((ho = xmemmem(eox, eoh - eox, "Host:", 5U)) != NULL &&
+		    (eol = memchr(ho, '\n', eoh + 2U - ho)) != NULL) {
 			/* read over leading whitespace */
-			for (ho += 5U, eoh--; ho < eoh && xisspace(*ho); ho++);
+			for (ho += 5U, eol--; ho < eol && xisspace(*ho); ho++);
 			/* shrink trailing whitespace */
-			for (; eoh > ho && xisspace(eoh[-1]); eoh--);
+			for (; eol > ho && xisspace(eol[-1]); eol--);
 			/* and assign */
 			res.host = ho;
-			*eoh = '\0';
+			*eol = '\0';
 		}
 	}
 
@@ -851,25 +1915,21 @@ parse_hdr(const char *str, size_t len)
 	}
 
 	/* and finally find beginning of actual headers */
-	if (LIKELY((eox = memchr(eox, '\n', ep - eox)) != NULL)) {
+	if (LIKELY((eox = memchr(eox, '\n', eoh + 2U - eox)) != NULL)) {
 		static const char _cl[] = "\nContent-Length:";
 		long unsigned int z;
 		const char *cl;
-		char *eoh;
 
 		/* overread trailing/leading whitespace */
-		for (eox++; xisspace(*eox); eox++);
-		/* also find a proper header ending */
-		eoh = xmemmem(eox, ep - eox, "\r\n\r\n", 4U);
-		if (UNLIKELY(eoh == NULL)) {
-			return res;
-		}
+		for (eox++; eox < eoh && xisspace(*eox); eox++);
 		/* finalise this string then */
 		eoh[2U] = '\0';
 		res.hdr = (gand_word_t){eox, eoh + 2U - eox};
 
-		/* now then, how about a Content-Length line? */
-		cl = xmemmem(res.hdr.str, res.hdr.len, _cl, sizeof(_cl) - 1U);
+		/* now then, how about a Content-Length line?
+		 * start at the newline that precedes the headers */
+		cl = xmemmem(res.hdr.str - 1U, res.hdr.len + 1U,
+			     _cl, sizeof(_cl) - 1U);
 		if (LIKELY(cl == NULL)) {
 			return res;
 		}
@@ -959,6 +2019,37 @@ nul:
 	return (gand_word_t){NULL};
 }
 
+int
+gand_req_fresh_p(gand_httpd_req_t req, gand_stmp_t st)
+{
+	gand_word_t x;
+
+	if (!st.mtim) {
+		/* no validators, no chance */
+		return 0;
+	} else if ((x = gand_req_get_xhdr(req, "If-None-Match")).str) {
+		/* this one takes precedence, weak comparison */
+		char et[96U];
+		size_t ez;
+
+		if (x.len == 1U && *x.str == '*') {
+			return 1;
+		} else if (!(ez = xfmtetag(et, sizeof(et), st))) {
+			return 0;
+		}
+		/* skip W/ on our side, the client may have dropped it */
+		return xmemmem(x.str, x.len, et + 2U, ez - 2U) != NULL;
+	} else if ((x = gand_req_get_xhdr(req, "If-Modified-Since")).str) {
+		time_t ims;
+
+		if (xparsedate(&ims, x.str, x.len) < 0) {
+			return 0;
+		}
+		return st.mtim <= ims;
+	}
+	return 0;
+}
+
 static void
 _build_proto(_httpd_ctx_t ctx, const char *srv)
 {
@@ -998,8 +2089,216 @@ _build_wwwd(_httpd_ctx_t ctx, const char *wwwd)
 	return;
 }
 
+/* request reassembly */
+#define IBUF_MINZ	(4096U)
+#define DFLT_MAX_HDR	(8192U)
+#define DFLT_MAX_BODY	(1048576U)
+
+static int
+_ibuf_grow(struct gand_conn_s *restrict c, _httpd_ctx_t ctx)
+{
+	const size_t maxz = ctx->param.max_hdr + ctx->param.max_body;
+	size_t nuz = c->ibz ? c->ibz * 2U : IBUF_MINZ;
+	char *nu;
+
+	if (c->ibuf == NULL && spare_ibuf != NULL) {
+		c->ibuf = spare_ibuf;
+		c->ibz = IBUF_MINZ;
+		spare_ibuf = NULL;
+		return 0;
+	} else if (UNLIKELY(c->ibz >= maxz)) {
+		return -1;
+	} else if (nuz > maxz) {
+		nuz = maxz;
+	}
+	if (UNLIKELY((nu = realloc(c->ibuf, nuz)) == NULL)) {
+		return -1;
+	}
+	c->ibuf = nu;
+	c->ibz = nuz;
+	return 0;
+}
+
+static void
+_ibuf_drop(struct gand_conn_s *restrict c)
+{
+/* give back C's input buffer, there's nothing left in it */
+	if (c->ibz == IBUF_MINZ && spare_ibuf == NULL) {
+		spare_ibuf = c->ibuf;
+	} else {
+		free(c->ibuf);
+	}
+	c->ibuf = NULL;
+	c->ibz = c->ibn = c->isc = 0U;
+	return;
+}
+
+static ssize_t
+_ibuf_req(struct gand_conn_s *restrict c, _httpd_ctx_t ctx)
+{
+/* return the length of the complete request at the front of C's input
+ * buffer, 0 if the request is incomplete or -1 if it's oversized */
+	static const char _cl[] = "\nContent-Length:";
+	const char *const bp = c->ibuf + c->ibo;
+	const size_t bz = c->ibn - c->ibo;
+	const char *eoh;
+	const char *cl;
+	size_t hz;
+	size_t z = 0U;
+
+	/* resume where the last scan stopped */
+	if ((eoh = xmemmem(bp + c->isc, bz - c->isc, "\r\n\r\n", 4U)) == NULL) {
+		if (UNLIKELY(bz > ctx->param.max_hdr)) {
+			return -1;
+		}
+		/* the terminator might have been cut in half */
+		c->isc = bz > 3U ? bz - 3U : 0U;
+		return 0;
+	} else if (UNLIKELY((hz = eoh + 4U - bp) > ctx->param.max_hdr)) {
+		return -1;
+	}
+	/* headers are complete, make sure we've got the body too */
+	if ((cl = xmemmem(bp, hz, _cl, sizeof(_cl) - 1U)) != NULL) {
+		z = strtoul(cl + sizeof(_cl) - 1U, NULL, 10U);
+	}
+	if (UNLIKELY(z > ctx->param.max_body)) {
+		return -1;
+	} else if (bz < hz + z) {
+		/* no need to scan for the header end again */
+		c->isc = eoh - bp;
+		return 0;
+	}
+	c->isc = 0U;
+	return hz + z;
+}
+
 
 /* callbacks */
+static void sock_resp_cb(EV_P_ ev_io *w, int revents);
+
+static int
+_ibuf_disp(EV_P_ struct gand_conn_s *restrict c, _httpd_ctx_t ctx)
+{
+/* dispatch the requests in C's input buffer to the worker */
+	const int fd = c->r.fd;
+	ssize_t nrq = 0;
+
+	/* process all complete requests, partial ones stay in the buffer
+	 * and so do complete ones once the write queue is full */
+	while (c->nwr < MAX_QUEUE && (nrq = _ibuf_req(c, ctx)) > 0) {
+		gand_httpd_req_t req;
+		enum gand_cmpr_e cmpr = CMPR_NONE;
+
+		/* now get all them headers parsed */
+		req = parse_hdr(c->ibuf + c->ibo, nrq);
+		c->ibo += nrq;
+
+		if (UNLIKELY(req.verb == VERB_UNSUPP)) {
+			/* don't deal with deliquents, we speak HTTP/1.1 only */
+			return -1;
+		} else if (UNLIKELY(req.hdr.str == NULL)) {
+			/* malformed request line */
+			return -1;
+		}
+
+		/* check for encoding header */
+		with (gand_word_t x) {
+			if ((x = gand_req_get_xhdr(req, "Accept-Encoding")).str) {
+				if (xmemmem(x.str, x.len, "gzip", 4U)) {
+					cmpr = CMPR_GZIP;
+				} else if (xmemmem(x.str, x.len, "deflate", 7U)) {
+					cmpr = CMPR_DEFLATE;
+				}
+			}
+		}
+
+		with (gand_httpd_res_t(*workf)() = ctx->param.workf) {
+			gand_httpd_res_t res = workf(req);
+
+			if (c->w.fd <= 0) {
+				/* initialise write watcher */
+				c->w.data = ctx;
+				ev_io_init(&c->w, sock_resp_cb, fd, EV_WRITE);
+				assert(c->nwr == 0U);
+			}
+			if (LIKELY(!c->nwr)) {
+				/* restart the write watcher */
+				ev_io_start(EV_A_ &c->w);
+			} else {
+				/* already started it seems */
+				assert(c->w.fd > 0);
+			}
+
+#if defined HAVE_ZLIB_H
+			/* check if compression was requested */
+			if (cmpr != CMPR_NONE && res.cenc == NULL) {
+				_cmpr_res(&res, cmpr);
+			}
+#endif	/* HAVE_ZLIB_H */
+
+			/* enqueue the request */
+			if (UNLIKELY(_enq_resp(ctx, c, res, req) < 0)) {
+				/* fuck */
+				GAND_ERR_LOG("\
+cannot enqueue response for %d", c->w.fd);
+				return -1;
+			}
+		}
+	}
+	if (UNLIKELY(nrq < 0)) {
+		GAND_ERR_LOG("request on socket %d too large", fd);
+		return -1;
+	}
+	/* move what's left of the buffer to the front */
+	if (c->ibo > 0U) {
+		memmove(c->ibuf, c->ibuf + c->ibo, c->ibn -= c->ibo);
+		c->ibo = 0U;
+	}
+	if (!c->ibn && c->ibuf != NULL) {
+		/* idle connections hold no buffer */
+		_ibuf_drop(c);
+	}
+	return 0;
+}
+
+static void
+_strm_park(EV_P_ gand_strm_t s, ev_io *w, struct _httpd_wrk_s *k)
+{
+/* stop writing S to W until it's woken */
+	s->wrk = k;
+	if (__sync_fetch_and_and(&s->woke, 0U)) {
+		/* woken in the meantime, keep going */
+		return;
+	}
+	ev_io_stop(EV_A_ w);
+	s->w = w;
+	if ((s->next = k->park) != NULL) {
+		s->next->prev = &s->next;
+	}
+	s->prev = &k->park;
+	k->park = s;
+	return;
+}
+
+static void
+kick_cb(EV_P_ ev_async *w, int UNUSED(revents))
+{
+	struct _httpd_wrk_s *k = w->data;
+
+	for (gand_strm_t s = k->park, n; s != NULL; s = n) {
+		n = s->next;
+		if (__sync_fetch_and_and(&s->woke, 0U)) {
+			/* unlink and resume writing */
+			if ((*s->prev = n) != NULL) {
+				n->prev = s->prev;
+			}
+			ev_io_start(EV_A_ s->w);
+			s->w = NULL;
+		}
+	}
+	return;
+}
+
 static void
 sock_resp_cb(EV_P_ ev_io *w, int revents)
 {
@@ -1020,6 +2319,22 @@ sock_resp_cb(EV_P_ ev_io *w, int revents)
 			/* -1 indicates error, 1 indicates complete
 			 * in either case dequeue the write queue item */
 			_deq_resp(c);
+		} else if (x->res.rd.dtyp == DTYP_STRM) {
+			gand_strm_t s = x->res.rd GAND_RES_DATA(strm);
+
+			if (s->stall && s->so >= s->stg->ibuf) {
+				/* the producer's got nothing for us yet,
+				 * the context is the first slot of our worker */
+				_strm_park(EV_A_ s, w, (void*)ctx);
+			}
+		}
+	}
+	if (c->r.fd > 0 && !ev_is_active(&c->r) && c->nwr < MAX_QUEUE) {
+		/* reading was paused on a full queue, catch up */
+		if (UNLIKELY(_ibuf_disp(EV_A_ c, ctx) < 0)) {
+			shut_conn(c);
+		} else if (c->nwr < MAX_QUEUE) {
+			ev_io_start(EV_A_ &c->r);
 		}
 	}
 
@@ -1034,104 +2349,44 @@ sock_resp_cb(EV_P_ ev_io *w, int revents)
 static void
 sock_data_cb(EV_P_ ev_io *w, int revents)
 {
-	char buf[4096U];
-	char *bp = buf;
+	struct gand_conn_s *c = (void*)w;
 	const int fd = w->fd;
 	_httpd_ctx_t ctx = w->data;
 	ssize_t nrd;
-	gand_httpd_req_t req;
-	enum gand_cmpr_e cmpr = CMPR_NONE;
 
 	if (UNLIKELY(!(revents & EV_READ))) {
 		/* huh? */
 		goto clo;
 	}
 
-	/* read some data into our tiny buffer */
-	if (UNLIKELY((nrd = read(fd, buf, sizeof(buf))) <= 0)) {
-		/* EOF or some other failure */
+	/* make sure there's room in the input buffer */
+	if (UNLIKELY(c->ibn >= c->ibz && _ibuf_grow(c, ctx) < 0)) {
+		GAND_ERR_LOG("request on socket %d too large", fd);
 		goto clo;
 	}
-
-again:
-	/* now get all them headers parsed */
-	req = parse_hdr(bp, nrd);
-
-	if (UNLIKELY(req.verb == VERB_UNSUPP)) {
-		/* don't deal with deliquents, we speak HTTP/1.1 only */
+	/* read some data into our input buffer */
+	if (UNLIKELY((nrd = read(fd, c->ibuf + c->ibn, c->ibz - c->ibn)) <= 0)) {
+		/* EOF or some other failure */
 		goto clo;
-	} else if (UNLIKELY(req.hdr.str == NULL)) {
-		/* wait for more data then? */
-		return;
-	}
-
-	/* check for encoding header */
-	with (gand_word_t x) {
-		if ((x = gand_req_get_xhdr(req, "Accept-Encoding")).str) {
-			if (xmemmem(x.str, x.len, "gzip", 4U)) {
-				cmpr = CMPR_GZIP;
-			} else if (xmemmem(x.str, x.len, "deflate", 7U)) {
-				cmpr = CMPR_DEFLATE;
-			}
-		}
-	}
-
-	with (gand_httpd_res_t(*workf)() = ctx->param.workf) {
-		gand_httpd_res_t res = workf(req);
-		struct gand_conn_s *c = (void*)w;
-
-		if (c->w.fd <= 0) {
-			/* initialise write watcher */
-			c->w.data = ctx;
-			ev_io_init(&c->w, sock_resp_cb, fd, EV_WRITE);
-			assert(c->nwr == 0U);
-		}
-		if (LIKELY(!c->nwr)) {
-			/* restart the write watcher */
-			ev_io_start(EV_A_ &c->w);
-		} else if (UNLIKELY(c->nwr >= MAX_QUEUE)) {
-			GAND_ERR_LOG("transmission queue for socket %d full",
-				     c->w.fd);
-			goto clo;
-		} else {
-			/* already started it seems */
-			assert(c->w.fd > 0);
-		}
-
-		/* check if compression was requested and data is gbuf */
-		if (res.rd.dtyp == DTYP_GBUF) {
-			/* add the compression level */
-			res.rd.dtyp = (enum gand_dtyp_e)(res.rd.dtyp + cmpr);
-		}
-
-		/* enqueue the request */
-		if (UNLIKELY(_enq_resp(ctx, c, res) < 0)) {
-			/* fuck */
-			GAND_ERR_LOG("cannot enqueue response for %d", c->w.fd);
-			goto clo;
-		}
-	}
-	if (UNLIKELY(req.data.str != NULL)) {
-		bp += req.data.str + req.data.len - buf;
-		nrd -= bp - buf;
-	} else {
-		bp += req.hdr.str + req.hdr.len + 2U - buf;
-		nrd -= bp - buf;
-	}
-	if (UNLIKELY(nrd > 0)) {
-		goto again;
+	} else if (c->ibn += nrd, UNLIKELY(_ibuf_disp(EV_A_ c, ctx) < 0)) {
+		goto clo;
+	} else if (UNLIKELY(c->nwr >= MAX_QUEUE)) {
+		/* stop reading until the write queue drains */
+		ev_io_stop(EV_A_ w);
 	}
 	return;
 
 clo:
 	ev_io_stop(EV_A_ w);
-	shut_conn((struct gand_conn_s*)w);
+	shut_conn(c);
 	return;
 }
 
 static void
 sock_cb(EV_P_ ev_io *w, int UNUSED(revents))
 {
+	/* the context is the first slot of our worker */
+	const struct _httpd_wrk_s *k = w->data;
 	ud_sockaddr_t sa;
 	socklen_t z = sizeof(sa);
 	struct gand_conn_s *nio;
@@ -1143,7 +2398,7 @@ sock_cb(EV_P_ ev_io *w, int UNUSED(revents))
 	}
 	log_conn(s, sa);
 
-	if (UNLIKELY((nio = make_conn()) == NULL)) {
+	if (UNLIKELY((nio = make_conn(k->srv)) == NULL)) {
 		GAND_ERR_LOG("too many concurrent connections");
 		close(s);
 		return;
@@ -1158,17 +2413,33 @@ sock_cb(EV_P_ ev_io *w, int UNUSED(revents))
 }
 
 static void
-sigint_cb(EV_P_ ev_signal *UNUSED(w), int UNUSED(revents))
+quit_cb(EV_P_ ev_async *UNUSED(w), int UNUSED(revents))
+{
+	ev_unloop(EV_A_ EVUNLOOP_ALL);
+	return;
+}
+
+static void
+sigint_cb(EV_P_ ev_signal *w, int UNUSED(revents))
 {
+	struct _httpd_s *h = w->data;
+
 	GAND_NOTI_LOG("C-c caught unrolling everything");
+	/* tell the other workers */
+	for (size_t i = 1U; i < h->nwrk; i++) {
+		ev_async_send(h->wrk[i].loop, &h->wrk[i].quit);
+	}
 	ev_unloop(EV_A_ EVUNLOOP_ALL);
 	return;
 }
 
 static void
-sighup_cb(EV_P_ ev_signal *UNUSED(w), int UNUSED(revents))
+sighup_cb(EV_P_ ev_signal *w, int UNUSED(revents))
 {
-	GAND_NOTI_LOG("SIGHUP caught, doing nothing");
+	const struct _httpd_s *h = w->data;
+
+	GAND_NOTI_LOG("SIGHUP caught, %zu connections (peak %zu)",
+		      h->cur_conns, h->peak_conns);
 	return;
 }
 
@@ -1177,16 +2448,21 @@ sigpipe_cb(EV_P_ ev_signal *UNUSED(w), int UNUSED(revents))
 {
 	GAND_NOTI_LOG("SIGPIPE caught, checking connections ...");
 
-	/* check for half-open shit */
-	for (size_t i = 0U; i < countof(conns); i++) {
-		if (conns[i].r.fd < 0 && conns[i].w.fd > 0 &&
-		    conns[i].iwr > conns[i].nwr) {
-			GAND_INFO_LOG("connection %zu seems buggered", i);
-			ev_io_stop(EV_A_ &conns[i].w);
-			shut_conn(conns + i);
-		} else if (conns[i].r.fd < 0 && conns[i].w.fd < 0) {
-			/* is this possible? */
-			;
+	/* check for half-open shit,
+	 * other workers block signals and see EPIPE instead */
+	for (struct gand_conn_slab_s *s = conn_slabs; s; s = s->next) {
+		for (size_t i = 0U; i < countof(s->c); i++) {
+			struct gand_conn_s *c = s->c + i;
+
+			if (c->r.fd < 0 && c->w.fd > 0 && c->iwr > c->nwr) {
+				GAND_INFO_LOG("connection %d seems buggered",
+					      c->w.fd);
+				ev_io_stop(EV_A_ &c->w);
+				shut_conn(c);
+			} else if (c->r.fd < 0 && c->w.fd < 0) {
+				/* is this possible? */
+				;
+			}
 		}
 	}
 	return;
@@ -1194,60 +2470,166 @@ sigpipe_cb(EV_P_ ev_signal *UNUSED(w), int UNUSED(revents))
 
 
 
+static int
+make_wrk(struct _httpd_wrk_s *w, const struct _httpd_ctx_s *ctx, EV_P)
+{
+	ud_sockaddr_t addr = {
+		.s6.sin6_family = AF_INET6,
+		.s6.sin6_addr = in6addr_any,
+		.s6.sin6_port = htons(ctx->param.port),
+	};
+	int s;
+
+	/* get the socket on the way */
+	if (UNLIKELY((s = make_tcp()) < 0)) {
+		/* big bugger */
+		GAND_ERR_LOG("cannot obtain a tcp socket: %s",
+			     strerror(errno));
+		return -1;
+	} else if (make_listener(s, &addr) < 0 ||
+		   setsock_rcvtimeo(s, ctx->param.timeout) < 0 ||
+		   setsock_sndtimeo(s, ctx->param.timeout) < 0) {
+		GAND_ERR_LOG("cannot listen on tcp socket: %s",
+			     strerror(errno));
+		/* even bigger bugger */
+		close(s);
+		return -1;
+	}
+
+	/* yay, take a private copy of the context */
+	*w->ctx = *ctx;
+	w->loop = loop;
+	w->sock.data = w->ctx;
+	ev_io_init(&w->sock, sock_cb, s, EV_READ);
+	ev_io_start(EV_A_ &w->sock);
+
+	ev_async_init(&w->quit, quit_cb);
+	ev_async_start(EV_A_ &w->quit);
+	w->kick.data = w;
+	ev_async_init(&w->kick, kick_cb);
+	ev_async_start(EV_A_ &w->kick);
+	return s;
+}
+
+static void
+free_wrk(struct _httpd_wrk_s *w)
+{
+	if (UNLIKELY(w->loop == NULL)) {
+		return;
+	}
+	with (struct ev_loop *loop = w->loop) {
+		ev_async_stop(EV_A_ &w->kick);
+		ev_async_stop(EV_A_ &w->quit);
+		ev_io_stop(EV_A_ &w->sock);
+	}
+	close(w->sock.fd);
+	if (!ev_is_default_loop(w->loop)) {
+		ev_loop_destroy(w->loop);
+	}
+	w->loop = NULL;
+	return;
+}
+
+static void*
+wrk_run(void *clo)
+{
+	struct _httpd_wrk_s *w = clo;
+	sigset_t ss[1U];
+
+	/* signals are the main thread's business */
+	sigfillset(ss);
+	pthread_sigmask(SIG_BLOCK, ss, NULL);
+
+	ev_loop(w->loop, 0);
+	fini_conns(w->loop);
+	return NULL;
+}
+
+
 gand_httpd_t
 make_gand_httpd(const gand_httpd_param_t p)
 {
 	struct ev_loop *loop = ev_default_loop(EVFLAG_AUTO);
-	struct _httpd_s *res = calloc(1, sizeof(*res));
+	const size_t nwrk = p.nworkers ?: 1U;
+	struct _httpd_s *res;
+
+	res = calloc(1, sizeof(*res) + nwrk * sizeof(*res->wrk));
+	if (UNLIKELY(res == NULL)) {
+		return NULL;
+	}
 
 	/* populate public bit */
 	res->ctx->param = p;
 
-	/* get the socket on the way */
-	{
-		ud_sockaddr_t addr = {
-			.s6.sin6_family = AF_INET6,
-			.s6.sin6_addr = in6addr_any,
-			.s6.sin6_port = htons(p.port),
-		};
-		int s;
+	/* we can serve as many connections as we have descriptors */
+	res->max_conns = -1;
+	with (struct rlimit lim) {
+		if (getrlimit(RLIMIT_NOFILE, &lim) < 0) {
+			break;
+		} else if (lim.rlim_cur < lim.rlim_max) {
+			/* try and go for the hard limit */
+			lim.rlim_cur = lim.rlim_max;
+			(void)setrlimit(RLIMIT_NOFILE, &lim);
+			(void)getrlimit(RLIMIT_NOFILE, &lim);
+		}
+		if (lim.rlim_cur != RLIM_INFINITY) {
+			res->max_conns = lim.rlim_cur;
+		}
+	}
 
-		if (UNLIKELY((s = make_tcp()) < 0)) {
-			/* big bugger */
-			GAND_ERR_LOG("cannot obtain a tcp socket: %s",
-				     strerror(errno));
-			goto foul;
-		} else if (make_listener(s, &addr) < 0 ||
-			   setsock_rcvtimeo(s, p.timeout) < 0 ||
-			   setsock_sndtimeo(s, p.timeout) < 0) {
-			GAND_ERR_LOG("cannot listen on tcp socket: %s",
-				     strerror(errno));
-			/* even bigger bugger */
-			close(s);
+	/* request size limits */
+	if (!res->ctx->param.max_hdr) {
+		res->ctx->param.max_hdr = DFLT_MAX_HDR;
+	}
+	if (!res->ctx->param.max_body) {
+		res->ctx->param.max_body = DFLT_MAX_BODY;
+	}
+
+	/* get the proto buffer ready */
+	_build_proto(res->ctx, p.server);
+	_build_wwwd(res->ctx, p.www_dir);
+
+	/* the first worker lives on the default loop */
+	with (int s) {
+		if (UNLIKELY((s = make_wrk(res->wrk, res->ctx, loop)) < 0)) {
 			goto foul;
-		} else {
+		}
+		with (ud_sockaddr_t addr) {
 			socklen_t z = sizeof(addr);
 
-			/* yay */
-			res->sock.data = res->ctx;
-			ev_io_init(&res->sock, sock_cb, s, EV_READ);
-			ev_io_start(EV_A_ &res->sock);
-
 			/* make sure we post back the port number */
-                        getsockname(s, &addr.sa, &z);
+			getsockname(s, &addr.sa, &z);
 			res->ctx->param.port = ntohs(addr.s6.sin6_port);
 		}
+		res->nwrk++;
 	}
+	/* ... all others bind to the same port but get their own loop */
+	for (; res->nwrk < nwrk; res->nwrk++) {
+		struct _httpd_wrk_s *w = res->wrk + res->nwrk;
+		struct ev_loop *wl;
 
-	/* get the proto buffer ready */
-	_build_proto(res->ctx, p.server);
-	_build_wwwd(res->ctx, p.www_dir);
+		if (UNLIKELY((wl = ev_loop_new(EVFLAG_AUTO)) == NULL)) {
+			GAND_ERR_LOG("cannot create event loop for worker");
+			goto foul;
+		} else if (UNLIKELY(make_wrk(w, res->ctx, wl) < 0)) {
+			ev_loop_destroy(wl);
+			goto foul;
+		}
+	}
+	/* make sure the worker contexts carry the final port too */
+	for (size_t i = 0U; i < res->nwrk; i++) {
+		res->wrk[i].ctx->param.port = res->ctx->param.port;
+		res->wrk[i].srv = res;
+	}
 
 	/* initialise private bits */
+	res->sigint.data = res;
 	ev_signal_init(&res->sigint, sigint_cb, SIGINT);
 	ev_signal_start(EV_A_ &res->sigint);
+	res->sighup.data = res;
 	ev_signal_init(&res->sighup, sighup_cb, SIGHUP);
 	ev_signal_start(EV_A_ &res->sighup);
+	res->sigterm.data = res;
 	ev_signal_init(&res->sigterm, sigint_cb, SIGTERM);
 	ev_signal_start(EV_A_ &res->sigterm);
 	ev_signal_init(&res->sigpipe, sigpipe_cb, SIGPIPE);
@@ -1256,6 +2638,12 @@ make_gand_httpd(const gand_httpd_param_t p)
 	return (gand_httpd_t)res;
 
 foul:
+	for (size_t i = 0U; i < res->nwrk; i++) {
+		free_wrk(res->wrk + i);
+	}
+	if (!(res->ctx->www_dirfd < 0)) {
+		close(res->ctx->www_dirfd);
+	}
 	free(res);
 	return NULL;
 }
@@ -1267,6 +2655,9 @@ free_gand_httpd(gand_httpd_t s)
 		return;
 	}
 	with (struct _httpd_s *_ = (void*)s) {
+		for (size_t i = 0U; i < _->nwrk; i++) {
+			free_wrk(_->wrk + i);
+		}
 		if (!(_->ctx->www_dirfd < 0)) {
 			close(_->ctx->www_dirfd);
 		}
@@ -1280,10 +2671,44 @@ gand_httpd_run(gand_httpd_t s)
 {
 	struct _httpd_s *this = (void*)s;
 
-	GAND_NOTI_LOG("httpd ready");
+	/* spawn the auxiliary workers */
+	for (size_t i = 1U; i < this->nwrk; i++) {
+		struct _httpd_wrk_s *w = this->wrk + i;
+
+		if (UNLIKELY(pthread_create(&w->thr, NULL, wrk_run, w))) {
+			GAND_ERR_LOG("cannot spawn worker %zu", i);
+			/* make sure we don't try joining him */
+			free_wrk(w);
+		}
+	}
+
+	GAND_NOTI_LOG("httpd ready, %zu worker(s), %zu connections max",
+		      this->nwrk, this->max_conns);
 	ev_loop(this->loop, 0);
+	fini_conns(this->loop);
+
+	/* unroll and collect the workers */
+	for (size_t i = 1U; i < this->nwrk; i++) {
+		struct _httpd_wrk_s *w = this->wrk + i;
+
+		if (LIKELY(w->loop != NULL)) {
+			ev_async_send(w->loop, &w->quit);
+			pthread_join(w->thr, NULL);
+		}
+	}
 	GAND_NOTI_LOG("httpd unwound");
 	return;
 }
 
+size_t
+gand_httpd_nconns(gand_httpd_t s, size_t *peak)
+{
+	const struct _httpd_s *this = (const void*)s;
+
+	if (peak != NULL) {
+		*peak = this->peak_conns;
+	}
+	return this->cur_conns;
+}
+
 /* httpd.c ends here */
@@ -64,6 +64,12 @@ typedef struct {
 /* just an ordinary pointer but managed by ourselves. */
 typedef struct gand_gbuf_s *gand_gbuf_t;
 
+/* immutable buffers that can be shared between responses */
+typedef struct gand_rbuf_s *gand_rbuf_t;
+
+/* data produced on demand, see make_gand_strm() */
+typedef struct gand_strm_s *gand_strm_t;
+
 /* just wrap the OS's file descriptors */
 typedef int gand_sock_t;
 
@@ -81,6 +87,9 @@ typedef struct {
 		DTYP_TMPF,
 		/* send contents of file descriptor, close after use */
 		DTYP_SOCK,
+		/* send whatever STRM produces, chunked, as the socket
+		 * drains and free the stream afterwards */
+		DTYP_STRM,
 
 		/* send contents of buffer DATA,
 		 * this should be static or otherwise managed because
@@ -90,13 +99,17 @@ typedef struct {
 		DTYP_DATA,
 		/* send contents of buffer GBUF and free it afterwards */
 		DTYP_GBUF,
+		/* send contents of buffer RBUF and drop our reference */
+		DTYP_RBUF,
 	} dtyp;
 	union {
 		const void *ptr;
 		const char *file;
 		gand_sock_t sock;
+		gand_strm_t strm;
 		const char *data;
 		gand_gbuf_t gbuf;
+		gand_rbuf_t rbuf;
 	}
 #if !defined HAVE_ANON_STRUCTS_INIT
 		data
@@ -119,6 +132,20 @@ typedef struct {
 	const char *query;
 } gand_httpd_req_t;
 
+/* validators of response data, for ETag and Last-Modified */
+typedef struct {
+	/** inode and size of the file the data stems from */
+	ino_t ino;
+	off_t size;
+	/** its modification time, 0 if there's no such file */
+	time_t mtim;
+	/** and the nanoseconds thereof, rewrites within the same second
+	 * may keep the size but not these */
+	long int nsec;
+	/** hash of the variant, for data derived from the file, 0 otherwise */
+	unsigned int var;
+} gand_stmp_t;
+
 typedef struct {
 	/** http response code */
 	unsigned int rc;
@@ -131,6 +158,14 @@ typedef struct {
 #define CLEN_UNKNOWN	(0U)
 	/** response data */
 	gand_res_data_t rd;
+	/** content encoding if the data is encoded already, e.g. "gzip",
+	 * NULL otherwise, such responses won't be compressed again */
+	const char *cenc;
+	/** validators of the data, if left empty they're derived
+	 * from regular files passed as DTYP_FILE or DTYP_SOCK,
+	 * such responses are turned into 304s for requests that
+	 * are conditional on them */
+	gand_stmp_t stmp;
 } gand_httpd_res_t;
 
 /* parameter struct for make_gand_httpd() */
@@ -143,8 +178,18 @@ typedef struct {
 	const char *www_dir;
 	/** name of the server and version */
 	const char *server;
-	/** routine to respond to a request. */
+	/** routine to respond to a request.
+	 * With more than one worker this is called concurrently from
+	 * all worker threads and must be reentrant. */
 	gand_httpd_res_t(*workf)(gand_httpd_req_t);
+	/** number of worker threads, each with its own event loop and
+	 * listener socket (SO_REUSEPORT), 0 means 1 */
+	unsigned int nworkers;
+	/** maximum size of request headers in bytes, 0 for 8 KiB,
+	 * connections sending larger headers are closed */
+	size_t max_hdr;
+	/** maximum size of request bodies in bytes, 0 for 1 MiB */
+	size_t max_body;
 } gand_httpd_param_t;
 
 /* public part of gand_httpd_s */
@@ -166,6 +211,11 @@ extern void free_gand_httpd(gand_httpd_t);
  * Main loop. */
 extern void gand_httpd_run(gand_httpd_t);
 
+/**
+ * Return the number of open connections of the server across all workers,
+ * and, if PEAK is non-NULL, the peak number of connections seen so far. */
+extern size_t gand_httpd_nconns(gand_httpd_t, size_t *peak);
+
 /**
  * Helper getter for gand requests. */
 extern gand_word_t gand_req_get_xhdr(gand_httpd_req_t req, const char *hdr);
@@ -174,6 +224,12 @@ extern gand_word_t gand_req_get_xhdr(gand_httpd_req_t req, const char *hdr);
  * Helper getter for gand requests. */
 extern gand_word_t gand_req_get_xqry(gand_httpd_req_t req, const char *fld);
 
+/**
+ * Return non-0 if REQ carries an If-None-Match or If-Modified-Since
+ * header that is satisfied by data stamped STMP, i.e. if the data
+ * needn't be sent and a 304 will do. */
+extern int gand_req_fresh_p(gand_httpd_req_t req, gand_stmp_t stmp);
+
 
 /* buffer goodness */
 /**
@@ -192,4 +248,59 @@ extern void free_gand_gbuf(gand_gbuf_t);
  * Write (i.e. copy) Z bytes from P to the internal buffer GB. */
 extern ssize_t gand_gbuf_write(gand_gbuf_t, const void *p, size_t z);
 
+
+/* refcounted buffer goodness */
+/**
+ * Obtain a buffer with one reference to it, ESTIMATE is like the
+ * estimate of make_gand_gbuf().
+ * The buffer can be written to as long as it isn't shared, once it's
+ * been handed out, i.e. referenced, it must be considered immutable.
+ * Unlike gbufs, rbufs aren't bound to the thread they were made in. */
+extern gand_rbuf_t make_gand_rbuf(size_t estimate);
+
+/**
+ * Drop a reference to RB, the last one frees it. */
+extern void free_gand_rbuf(gand_rbuf_t rb);
+
+/**
+ * Obtain another reference to RB and return it. */
+extern gand_rbuf_t gand_rbuf_ref(gand_rbuf_t rb);
+
+/**
+ * Write (i.e. copy) Z bytes from P to the (yet unshared) buffer RB. */
+extern ssize_t gand_rbuf_write(gand_rbuf_t rb, const void *p, size_t z);
+
+/**
+ * Return the number of bytes in RB. */
+extern size_t gand_rbuf_size(gand_rbuf_t rb);
+
+
+/* stream goodness */
+#define GAND_STRM_AGAIN	(-2)
+
+/**
+ * Obtain a stream whose data is produced on demand, i.e. whenever the
+ * socket can take more, and sent with chunked transfer encoding.
+ * PROD is called with CLO and a gbuf to write to (gand_gbuf_write())
+ * and returns the number of bytes written, 0 at the end of the stream
+ * or -1 on error.
+ * PROD may also return GAND_STRM_AGAIN, without having written anything,
+ * if it has nothing to offer yet, the stream is then put to rest until
+ * gand_strm_wake() is called on it.
+ * FIN, if non-NULL, is called with CLO once the stream is done with. */
+extern gand_strm_t
+make_gand_strm(
+	ssize_t(*prod)(void *clo, gand_gbuf_t),
+	void(*fin)(void *clo), void *clo);
+
+/**
+ * Free a stream that hasn't been handed to the httpd. */
+extern void free_gand_strm(gand_strm_t);
+
+/**
+ * Have PROD of stream S called again after it returned GAND_STRM_AGAIN.
+ * This may be called from any thread but must not race the stream's
+ * FIN callback, i.e. callers have to make sure S is still alive. */
+extern void gand_strm_wake(gand_strm_t s);
+
 #endif	/* INCLUDED_httpd_h_ */
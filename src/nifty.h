@@ -37,6 +37,9 @@
 #if !defined INCLUDED_nifty_h_
 #define INCLUDED_nifty_h_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #if !defined LIKELY
 # define LIKELY(_x)	__builtin_expect((_x), 1)
 #endif	/* !LIKELY */
@@ -88,4 +91,19 @@ deconst(const void *cp)
 	return tmp.p;
 }
 
+/* 64-bit fnv-1a of Z bytes at P, continuing from hash H */
+#define FNV1A_BASIS	(0xcbf29ce484222325ULL)
+
+static __inline uint64_t
+fnv1a(uint64_t h, const void *p, size_t z)
+{
+	const uint8_t *bp = p;
+
+	for (size_t i = 0U; i < z; i++) {
+		h ^= bp[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
 #endif	/* INCLUDED_nifty_h_ */
@@ -0,0 +1,110 @@
+/*** arrow-enc.c -- encode series lines as arrow stream
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Encode the series lines on stdin as arrow stream on stdout,
+ * NROW rows per record batch (default 3) so that dictionaries
+ * have to be amended along the way. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "gand-arrow.h"
+#include "gand-rln.h"
+#include "nifty.h"
+
+static int
+flush(gand_arrow_t a, int fin)
+{
+	const void *buf;
+	size_t z;
+
+	if ((buf = gand_arrow_flush(a, &z, fin)) == NULL) {
+		fputs("cannot encode record batch\n", stderr);
+		return -1;
+	} else if (fwrite(buf, 1U, z, stdout) < z) {
+		perror("cannot write stream");
+		return -1;
+	}
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const size_t nrow = argc > 1 ? strtoul(argv[1], NULL, 10) : 3U;
+	char *ln = NULL;
+	size_t lz = 0U;
+	ssize_t nrd;
+	gand_arrow_t a;
+	int rc = 0;
+
+	if ((a = make_gand_arrow()) == NULL) {
+		fputs("cannot obtain arrow encoder\n", stderr);
+		return 1;
+	} else if (gand_arrow_meta(a, "gandalf:errors", "NOPE1 NOPE2") < 0) {
+		fputs("cannot attach metadata\n", stderr);
+		rc = 1;
+		goto out;
+	}
+	while ((nrd = getline(&ln, &lz, stdin)) > 0) {
+		struct rln_s r;
+
+		nrd -= ln[nrd - 1] == '\n';
+		if ((r = snarf_rln(ln, nrd)).sym.s == NULL) {
+			continue;
+		} else if (gand_arrow_add(a, r) < 0) {
+			fputs("cannot add row\n", stderr);
+			rc = 1;
+			goto out;
+		} else if (gand_arrow_nrow(a) >= nrow && flush(a, 0) < 0) {
+			rc = 1;
+			goto out;
+		}
+	}
+	if (flush(a, 1) < 0) {
+		rc = 1;
+	}
+out:
+	free(ln);
+	free_gand_arrow(a);
+	return rc;
+}
+
+/* arrow-enc.c ends here */
@@ -0,0 +1,29 @@
+#!/bin/sh
+## read what arrow-enc makes of arrow.series with pyarrow
+## and compare to arrow.exp, skip if there's no pyarrow
+
+PYTHON="${PYTHON:-python3}"
+srcdir="${srcdir:-.}"
+
+"${PYTHON}" -c 'import pyarrow' 2>/dev/null || exit 77
+
+./arrow-enc < "${srcdir}/arrow.series" > arrow.tmp || exit 1
+
+"${PYTHON}" - arrow.tmp <<'EOP' | diff -u "${srcdir}/arrow.exp" - || exit 1
+import sys
+import pyarrow as pa
+import pyarrow.ipc as ipc
+
+with open(sys.argv[1], "rb") as f:
+    r = ipc.open_stream(f)
+    b = list(r)
+t = pa.Table.from_batches(b, r.schema)
+m = t.schema.metadata or {}
+print("#", len(b), "batches")
+print("#", "\t".join("%s:%s" % (f.name, f.type) for f in t.schema))
+print("#", m.get(b"gandalf:errors", b"").decode())
+def fmt(x):
+    return "NA" if x is None else str(x)
+for row in t.to_pylist():
+    print("\t".join(fmt(row[k]) for k in t.schema.names))
+EOP
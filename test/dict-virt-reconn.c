@@ -0,0 +1,278 @@
+/*** dict-virt-reconn.c -- test the virtuoso dict across server restarts
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Have the stub server behind the virtuoso dict restart and go down
+ * while symbols are being looked up.  Lookups must survive restarts,
+ * fail fast while the server is away, and recover once it's back. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "gand-dict.h"
+#include "gand-dict-cache.h"
+#include "fakeodbc.h"
+#include "logger.h"
+#include "nifty.h"
+
+#define NSYMS	(600U)
+#define NTHR	(4U)
+
+static char syms[NSYMS][32U];
+static const char *symp[NSYMS];
+static dict_t d;
+
+
+static long int
+now_ms(void)
+{
+	struct timespec tsp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return tsp.tv_sec * 1000L + tsp.tv_nsec / 1000000L;
+}
+
+static void
+mk_syms(void)
+{
+	for (size_t i = 0U; i < NSYMS; i++) {
+		snprintf(syms[i], sizeof(syms[i]),
+			 i % 5U == 2U ? "SYM%zu x" : "SYM%zu", i + 1U);
+		symp[i] = syms[i];
+	}
+	return;
+}
+
+static size_t
+lookup(size_t *nmiss)
+{
+/* resolve all symbols, in batches and singly, return the number of
+ * wrong results and count the failed lookups in NMISS, a symbol that's
+ * there but comes back as not found is a wrong result */
+	dict_oid_t oids[NSYMS];
+	size_t nbad = 0U;
+
+	(void)dict_get_syms(d, oids, symp, NSYMS);
+	for (size_t i = 0U; i < NSYMS; i++) {
+		const dict_oid_t exp = fake_odbc_oid(syms[i]);
+		dict_oid_t x;
+
+		*nmiss += oids[i] == ERR_OID;
+		nbad += oids[i] != ERR_OID && oids[i] != exp;
+		if (i % 10U == 0U) {
+			x = dict_get_sym(d, syms[i]);
+			*nmiss += x == ERR_OID;
+			nbad += x != ERR_OID && x != exp;
+		}
+	}
+	return nbad;
+}
+
+static int
+test_restart(void)
+{
+/* one retry on a fresh connection is all a restart may cost,
+ * restarts are further apart than the queries of a batch */
+	size_t nmiss = 0U;
+	size_t nbad;
+	int rc = 0;
+
+	fake_odbc.restart = 97U;
+	for (size_t i = 0U; i < 10U; i++) {
+		nbad = lookup(&nmiss);
+		if (nbad || nmiss) {
+			fprintf(stderr, "restarts: %zu wrong, %zu unresolved\n",
+				nbad, nmiss);
+			rc = -1;
+			break;
+		}
+	}
+	fake_odbc.restart = 0U;
+	if (!fake_odbc.nfailexec) {
+		fputs("restarts: no query ever failed\n", stderr);
+		rc = -1;
+	}
+	return rc;
+}
+
+static void*
+work(void *UNUSED(clo))
+{
+	size_t nmiss = 0U;
+	size_t nbad = 0U;
+
+	for (size_t i = 0U; i < 5U; i++) {
+		nbad += lookup(&nmiss);
+	}
+	return (void*)nbad;
+}
+
+static int
+test_restart_mt(void)
+{
+/* concurrent lookups may lose out on a restart, but never mix up */
+	pthread_t thr[NTHR];
+	int rc = 0;
+
+	fake_odbc.restart = 101U;
+	fake_odbc.lat = 100U;
+	for (size_t i = 0U; i < NTHR; i++) {
+		pthread_create(thr + i, NULL, work, NULL);
+	}
+	for (size_t i = 0U; i < NTHR; i++) {
+		void *nbad;
+
+		pthread_join(thr[i], &nbad);
+		if (nbad != NULL) {
+			fprintf(stderr, "restarts: %zu wrong results\n",
+				(size_t)nbad);
+			rc = -1;
+		}
+	}
+	fake_odbc.restart = 0U;
+	fake_odbc.lat = 0U;
+	if (fake_odbc.maxopen > 8U) {
+		fprintf(stderr, "%zu connections at once\n", fake_odbc.maxopen);
+		rc = -1;
+	}
+	return rc;
+}
+
+static int
+test_down(void)
+{
+/* while the server's away lookups fail fast, and say so rather than
+ * claim symbols aren't there, and the server is left alone for a while,
+ * once back it's found again */
+	const size_t nconn = fake_odbc.nfailconn;
+	dict_oid_t oids[NSYMS];
+	long int t;
+	int rc = 0;
+
+	fake_odbc.down = true;
+	t = now_ms();
+	for (size_t i = 0U; i < 100U; i++) {
+		if (dict_get_sym(d, "SYM1") != ERR_OID) {
+			fputs("down: lookup didn't fail\n", stderr);
+			rc = -1;
+			break;
+		}
+	}
+	if (dict_get_syms(d, oids, symp, NSYMS)) {
+		fputs("down: batch lookup succeeded\n", stderr);
+		rc = -1;
+	}
+	for (size_t i = 0U; i < NSYMS; i++) {
+		if (oids[i] != ERR_OID) {
+			fprintf(stderr, "down: batch lookup of %s didn't fail\n",
+				syms[i]);
+			rc = -1;
+			break;
+		}
+	}
+	/* and failures mustn't stick */
+	dict_cache_put("SYM1", ERR_OID, dict_cache_tag());
+	if (dict_cache_get("SYM1") != DICT_CACHE_NONE) {
+		fputs("down: failed lookup cached\n", stderr);
+		rc = -1;
+	}
+	if ((t = now_ms() - t) > 500L) {
+		fprintf(stderr, "down: 100 lookups took %ldms\n", t);
+		rc = -1;
+	}
+	if (fake_odbc.nfailconn - nconn > 2U) {
+		fprintf(stderr, "down: %zu connection attempts\n",
+			fake_odbc.nfailconn - nconn);
+		rc = -1;
+	}
+
+	fake_odbc.down = false;
+	t = now_ms();
+	while (dict_get_sym(d, "SYM1") != 1U) {
+		static const struct timespec pause = {0, 100000000L};
+
+		if (now_ms() - t > 5000L) {
+			fputs("up: server not found again\n", stderr);
+			return -1;
+		}
+		nanosleep(&pause, NULL);
+	}
+	return rc;
+}
+
+
+int
+main(void)
+{
+	int rc = 0;
+
+	gand_log = gand_errlog;
+	mk_syms();
+
+	/* no server, no dict */
+	fake_odbc.down = true;
+	if ((d = open_dict(DICT_DEFAULT, 0)) != NULL) {
+		fputs("dict opened without a server\n", stderr);
+		close_dict(d);
+		return 1;
+	}
+	fake_odbc.down = false;
+	if ((d = open_dict(DICT_DEFAULT, 0)) == NULL) {
+		fputs("cannot open dict\n", stderr);
+		return 1;
+	}
+
+	dict_cache_init(64U, 0U);
+	rc |= test_restart();
+	rc |= test_restart_mt();
+	rc |= test_down();
+	/* and after all that it's business as usual */
+	rc |= test_restart();
+
+	dict_cache_fini();
+	close_dict(d);
+	if (fake_odbc.nopen) {
+		fprintf(stderr, "%zu connections left open\n", fake_odbc.nopen);
+		rc = -1;
+	}
+	return rc ? 1 : 0;
+}
+
+/* dict-virt-reconn.c ends here */
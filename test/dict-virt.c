@@ -0,0 +1,204 @@
+/*** dict-virt.c -- test the virtuoso dict against a stub driver
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Resolve symbols through the virtuoso dict against a stub driver,
+ * one by one, in batches and from several threads at once. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "gand-dict.h"
+#include "fakeodbc.h"
+#include "logger.h"
+#include "nifty.h"
+
+/* more than one batch's worth */
+#define NSYMS	(700U)
+#define NTHR	(16U)
+
+static char syms[NSYMS][32U];
+static const char *symp[NSYMS];
+static dict_t d;
+
+
+static void
+mk_syms(void)
+{
+/* mostly found symbols, with some unknown, some that don't fit into
+ * an iri and some duplicates thrown in */
+	for (size_t i = 0U; i < NSYMS; i++) {
+		if (i % 7U == 3U) {
+			snprintf(syms[i], sizeof(syms[i]), "NOPE%zu", i + 1U);
+		} else if (i % 11U == 5U) {
+			snprintf(syms[i], sizeof(syms[i]), "SYM%zu x", i + 1U);
+		} else if (i % 13U == 12U) {
+			memcpy(syms[i], syms[i - 1U], sizeof(syms[i]));
+		} else {
+			snprintf(syms[i], sizeof(syms[i]), "SYM%zu", i + 1U);
+		}
+		symp[i] = syms[i];
+	}
+	return;
+}
+
+static size_t
+check_syms(const char *const *s, size_t n, size_t *nfnd)
+{
+/* resolve S in one go and one by one, return the number of mismatches */
+	dict_oid_t oids[NSYMS];
+	size_t nbad = 0U;
+	size_t nexp = 0U;
+
+	*nfnd = dict_get_syms(d, oids, s, n);
+	for (size_t i = 0U; i < n; i++) {
+		const dict_oid_t exp = fake_odbc_oid(s[i]);
+
+		nexp += exp != NUL_OID;
+		if (oids[i] != exp) {
+			fprintf(stderr, "batch: `%s' got %u expected %u\n",
+				s[i], oids[i], exp);
+			nbad++;
+		}
+		if (dict_get_sym(d, s[i]) != exp) {
+			fprintf(stderr, "single: `%s' mismatch\n", s[i]);
+			nbad++;
+		}
+	}
+	if (*nfnd != nexp) {
+		fprintf(stderr, "found %zu expected %zu\n", *nfnd, nexp);
+		nbad++;
+	}
+	return nbad;
+}
+
+static int
+check_src(const char *src)
+{
+/* list SRC, the stub lists 3 symbols per source */
+	size_t n = 0U;
+	int rc = 0;
+
+	for (dict_si_t si; (si = dict_src_iter(d, src)).sid; n++) {
+		char exp[128U];
+
+		snprintf(exp, sizeof(exp),
+			 "http://data.ga-group.nl/rolf/series/%s%zu", src, n);
+		if (strcmp(si.sym, exp)) {
+			fprintf(stderr, "source %s: got `%s'\n", src, si.sym);
+			rc = -1;
+		}
+	}
+	if (n != 3U) {
+		fprintf(stderr, "source %s: %zu symbols\n", src, n);
+		rc = -1;
+	}
+	return rc;
+}
+
+static void*
+work(void *clo)
+{
+	const size_t k = (size_t)clo;
+	size_t nfnd;
+	size_t nbad;
+
+	/* each thread its own window of symbols */
+	nbad = check_syms(symp + k * 20U, NSYMS - k * 20U, &nfnd);
+	return (void*)nbad;
+}
+
+
+int
+main(void)
+{
+	pthread_t thr[NTHR];
+	size_t nfnd;
+	int rc = 0;
+
+	gand_log = gand_errlog;
+	mk_syms();
+
+	if ((d = open_dict(DICT_DEFAULT, 0)) == NULL) {
+		fputs("cannot open dict\n", stderr);
+		return 1;
+	} else if (fake_odbc.nopen != 1U) {
+		fprintf(stderr, "%zu connections after opening\n",
+			fake_odbc.nopen);
+		rc = 1;
+	}
+
+	if (check_syms(symp, NSYMS, &nfnd)) {
+		rc = 1;
+	}
+	if (check_src("XNAS") < 0 || check_src("XLON") < 0) {
+		rc = 1;
+	}
+
+	/* the pool mustn't grow beyond its limit, nor share connections */
+	fake_odbc.lat = 100U;
+	for (size_t i = 0U; i < NTHR; i++) {
+		pthread_create(thr + i, NULL, work, (void*)i);
+	}
+	for (size_t i = 0U; i < NTHR; i++) {
+		void *nbad;
+
+		pthread_join(thr[i], &nbad);
+		if (nbad != NULL) {
+			rc = 1;
+		}
+	}
+	if (fake_odbc.maxopen > 8U) {
+		fprintf(stderr, "%zu connections at once\n", fake_odbc.maxopen);
+		rc = 1;
+	} else if (fake_odbc.nclash) {
+		fprintf(stderr, "%zu queries on busy connections\n",
+			fake_odbc.nclash);
+		rc = 1;
+	}
+
+	close_dict(d);
+	if (fake_odbc.nopen) {
+		fprintf(stderr, "%zu connections left open\n", fake_odbc.nopen);
+		rc = 1;
+	}
+	return rc;
+}
+
+/* dict-virt.c ends here */
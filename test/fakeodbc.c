@@ -0,0 +1,421 @@
+/*** fakeodbc.c -- stub odbc driver for tests
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sql.h>
+#include <sqlext.h>
+#include "fakeodbc.h"
+#include "nifty.h"
+
+/* rows a statement can hold, the dict batches no more than that */
+#define NROWS	(256U)
+#define ROWZ	(128U)
+
+static const char iri_pre[] = "http://data.ga-group.nl/rolf/series/";
+
+/* environments, connections and statements alike */
+struct fake_h_s {
+	SQLSMALLINT type;
+	/* the connection of a statement, a connection's is itself */
+	struct fake_h_s *dbc;
+	/* server generation when connected, 0 if not connected */
+	size_t gen;
+	bool deadp;
+	int busy;
+	/* sqlstate of the last error, if any */
+	const char *err;
+	char *qry;
+
+	/* bound parameter and columns */
+	SQLCHAR *par;
+	SQLLEN *parz;
+	struct {
+		SQLPOINTER p;
+		SQLLEN z;
+		SQLLEN *ind;
+	} col[2U];
+
+	/* result rows, columns are tab separated */
+	size_t nrow;
+	size_t irow;
+	char rows[NROWS][ROWZ];
+};
+
+struct fake_odbc_s fake_odbc;
+/* bumped by restarts, connections of earlier generations are dead */
+static size_t srv_gen = 1U;
+
+
+static void
+upmax(size_t *m, size_t v)
+{
+	for (size_t o; v > (o = *m);) {
+		if (__sync_bool_compare_and_swap(m, o, v)) {
+			break;
+		}
+	}
+	return;
+}
+
+static bool
+query_beg(struct fake_h_s *h)
+{
+/* account for a query on H, return false if its connection is gone */
+	struct fake_h_s *d = h->dbc;
+	const size_t n = __sync_add_and_fetch(&fake_odbc.nexec, 1U);
+
+	h->nrow = h->irow = 0U;
+	if (fake_odbc.down || d->gen != srv_gen) {
+		__sync_fetch_and_add(&fake_odbc.nfailexec, 1U);
+		d->deadp = true;
+		h->err = "08S01";
+		return false;
+	} else if (__sync_lock_test_and_set(&d->busy, 1)) {
+		__sync_fetch_and_add(&fake_odbc.nclash, 1U);
+	}
+	if (fake_odbc.lat) {
+		usleep(fake_odbc.lat);
+	}
+	if (fake_odbc.restart && n % fake_odbc.restart == 0U) {
+		/* served this one still */
+		fake_odbc_restart();
+	}
+	return true;
+}
+
+static void
+query_end(struct fake_h_s *h)
+{
+	__sync_lock_release(&h->dbc->busy);
+	return;
+}
+
+static __attribute__((format(printf, 2, 3))) void
+add_row(struct fake_h_s *h, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (h->nrow < NROWS) {
+		va_start(ap, fmt);
+		vsnprintf(h->rows[h->nrow++], ROWZ, fmt, ap);
+		va_end(ap);
+	}
+	return;
+}
+
+
+void
+fake_odbc_restart(void)
+{
+	__sync_fetch_and_add(&srv_gen, 1U);
+	return;
+}
+
+unsigned int
+fake_odbc_oid(const char *sym)
+{
+	if (strncmp(sym, "SYM", 3U)) {
+		return 0U;
+	}
+	return strtoul(sym + 3U, NULL, 10);
+}
+
+
+/* the driver api, as far as the dict uses it */
+SQLRETURN
+SQLAllocHandle(SQLSMALLINT type, SQLHANDLE in, SQLHANDLE *out)
+{
+	struct fake_h_s *h;
+
+	if ((h = calloc(1U, sizeof(*h))) == NULL) {
+		return SQL_ERROR;
+	}
+	h->type = type;
+	h->dbc = type == SQL_HANDLE_STMT ? in : h;
+	*out = h;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLFreeHandle(SQLSMALLINT UNUSED(type), SQLHANDLE x)
+{
+	struct fake_h_s *h = x;
+
+	free(h->qry);
+	free(h);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLSetEnvAttr(
+	SQLHENV UNUSED(e), SQLINTEGER UNUSED(attr),
+	SQLPOINTER UNUSED(v), SQLINTEGER UNUSED(z))
+{
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLDriverConnect(
+	SQLHDBC x, SQLHWND UNUSED(w),
+	SQLCHAR *UNUSED(in), SQLSMALLINT UNUSED(inz),
+	SQLCHAR *UNUSED(out), SQLSMALLINT UNUSED(outz), SQLSMALLINT *outzp,
+	SQLUSMALLINT UNUSED(compl))
+{
+	struct fake_h_s *h = x;
+
+	if (fake_odbc.down) {
+		__sync_fetch_and_add(&fake_odbc.nfailconn, 1U);
+		h->err = "08001";
+		return SQL_ERROR;
+	}
+	h->gen = srv_gen;
+	*outzp = 0;
+	__sync_fetch_and_add(&fake_odbc.nconn, 1U);
+	upmax(&fake_odbc.maxopen,
+	      __sync_add_and_fetch(&fake_odbc.nopen, 1U));
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLDisconnect(SQLHDBC x)
+{
+	struct fake_h_s *h = x;
+
+	if (h->gen) {
+		__sync_fetch_and_sub(&fake_odbc.nopen, 1U);
+	}
+	h->gen = 0U;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLGetConnectAttr(
+	SQLHDBC x, SQLINTEGER attr,
+	SQLPOINTER v, SQLINTEGER UNUSED(z), SQLINTEGER *UNUSED(zp))
+{
+	struct fake_h_s *h = x;
+
+	if (attr != SQL_ATTR_CONNECTION_DEAD) {
+		return SQL_ERROR;
+	}
+	/* like the real thing this only knows what happened on H */
+	*(SQLUINTEGER*)v = h->deadp ? SQL_CD_TRUE : SQL_CD_FALSE;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLError(
+	SQLHENV e, SQLHDBC d, SQLHSTMT s,
+	SQLCHAR *sta, SQLINTEGER *UNUSED(nat),
+	SQLCHAR *msg, SQLSMALLINT msgz, SQLSMALLINT *UNUSED(msgzp))
+{
+	struct fake_h_s *h = s ?: d ?: e;
+
+	if (h == NULL || h->err == NULL) {
+		return SQL_NO_DATA_FOUND;
+	}
+	snprintf((char*)sta, 6U, "%s", h->err);
+	snprintf((char*)msg, msgz, "[fakeodbc] error %s", h->err);
+	h->err = NULL;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLPrepare(SQLHSTMT x, SQLCHAR *q, SQLINTEGER qz)
+{
+	struct fake_h_s *h = x;
+
+	free(h->qry);
+	h->qry = strndup((const char*)q, qz);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLBindParameter(
+	SQLHSTMT x, SQLUSMALLINT i, SQLSMALLINT UNUSED(io),
+	SQLSMALLINT UNUSED(ctyp), SQLSMALLINT UNUSED(styp),
+	SQLULEN UNUSED(cz), SQLSMALLINT UNUSED(dec),
+	SQLPOINTER v, SQLLEN UNUSED(vz), SQLLEN *vzp)
+{
+	struct fake_h_s *h = x;
+
+	if (i != 1U) {
+		return SQL_ERROR;
+	}
+	h->par = v;
+	h->parz = vzp;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLBindCol(
+	SQLHSTMT x, SQLUSMALLINT i, SQLSMALLINT UNUSED(ctyp),
+	SQLPOINTER v, SQLLEN vz, SQLLEN *ind)
+{
+	struct fake_h_s *h = x;
+
+	if (i < 1U || i > countof(h->col)) {
+		return SQL_ERROR;
+	}
+	h->col[i - 1U].p = v;
+	h->col[i - 1U].z = vz;
+	h->col[i - 1U].ind = ind;
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLExecute(SQLHSTMT x)
+{
+	struct fake_h_s *h = x;
+	char par[256U];
+	size_t z;
+
+	if (h->qry == NULL || h->par == NULL) {
+		return SQL_ERROR;
+	} else if (!query_beg(h)) {
+		return SQL_ERROR;
+	}
+	z = *h->parz == SQL_NTS ? strlen((char*)h->par) : (size_t)*h->parz;
+	z = z < sizeof(par) ? z : sizeof(par) - 1U;
+	memcpy(par, h->par, z);
+	par[z] = '\0';
+
+	if (strstr(h->qry, "gas:rolfid")) {
+		const unsigned int oid = fake_odbc_oid(par);
+
+		if (oid) {
+			add_row(h, "%u", oid);
+		}
+	} else if (strstr(h->qry, "gas:listedOn")) {
+		for (unsigned int i = 0U; i < 3U; i++) {
+			add_row(h, "%s%s%u", iri_pre, par, i);
+		}
+	}
+	query_end(h);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLExecDirect(SQLHSTMT x, SQLCHAR *q, SQLINTEGER qz)
+{
+/* only the dict's batches come through here */
+	struct fake_h_s *h = x;
+	const char *syms[NROWS];
+	size_t nsyms = 0U;
+	char *qry;
+
+	if (!query_beg(h)) {
+		return SQL_ERROR;
+	} else if ((qry = strndup((const char*)q, qz)) == NULL) {
+		query_end(h);
+		return SQL_ERROR;
+	} else if (strstr(qry, "VALUES ?sym {") == NULL ||
+		   strstr(qry, "gas:rolfid") == NULL) {
+		free(qry);
+		query_end(h);
+		h->err = "42000";
+		return SQL_ERROR;
+	}
+	for (char *p = qry, *eoi;
+	     (p = strchr(p, '<')) != NULL &&
+		     (eoi = strchr(p, '>')) != NULL; p = eoi + 1U) {
+		*eoi = '\0';
+		if (!strncmp(++p, iri_pre, sizeof(iri_pre) - 1U) &&
+		    nsyms < countof(syms)) {
+			syms[nsyms++] = p + sizeof(iri_pre) - 1U;
+		}
+	}
+	/* answer in reverse, the order of results isn't guaranteed */
+	while (nsyms-- > 0U) {
+		const unsigned int oid = fake_odbc_oid(syms[nsyms]);
+
+		if (oid) {
+			add_row(h, "%s%s\t%u", iri_pre, syms[nsyms], oid);
+		}
+	}
+	free(qry);
+	query_end(h);
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLFetch(SQLHSTMT x)
+{
+	struct fake_h_s *h = x;
+	const char *r;
+
+	if (h->irow >= h->nrow) {
+		return SQL_NO_DATA_FOUND;
+	}
+	r = h->rows[h->irow++];
+	for (size_t i = 0U; i < countof(h->col); i++) {
+		const char *eoc = strchr(r, '\t') ?: r + strlen(r);
+
+		if (h->col[i].p != NULL) {
+			snprintf(h->col[i].p, h->col[i].z,
+				 "%.*s", (int)(eoc - r), r);
+			*h->col[i].ind = eoc - r;
+		}
+		r = *eoc ? eoc + 1U : eoc;
+	}
+	return SQL_SUCCESS;
+}
+
+SQLRETURN
+SQLMoreResults(SQLHSTMT UNUSED(x))
+{
+	return SQL_NO_DATA_FOUND;
+}
+
+SQLRETURN
+SQLFreeStmt(SQLHSTMT x, SQLUSMALLINT opt)
+{
+	struct fake_h_s *h = x;
+
+	if (opt == SQL_CLOSE) {
+		h->nrow = h->irow = 0U;
+	}
+	return SQL_SUCCESS;
+}
+
+/* fakeodbc.c ends here */
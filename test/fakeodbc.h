@@ -0,0 +1,82 @@
+/*** fakeodbc.h -- stub odbc driver for tests
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * A stand-in for the odbc driver manager, just good enough to answer
+ * the queries of gand-dict-virt.c without a triplestore.
+ * SYMn resolves to n, sources list three symbols each.  The server
+ * can be taken down and restarted under the dict's feet. */
+#if !defined INCLUDED_fakeodbc_h_
+#define INCLUDED_fakeodbc_h_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct fake_odbc_s {
+	/** knobs, to be set by the test */
+	/* server is down, connects and queries fail */
+	volatile bool down;
+	/* server restarts after every RESTART-th query, 0 for never,
+	 * connections made before a restart die on their next query */
+	volatile size_t restart;
+	/* time each query takes, in microseconds */
+	volatile unsigned int lat;
+
+	/** counters, to be read by the test */
+	size_t nconn;
+	size_t nfailconn;
+	size_t nexec;
+	size_t nfailexec;
+	/* connections open now and at most */
+	size_t nopen;
+	size_t maxopen;
+	/* queries on a connection that was busy with another one */
+	size_t nclash;
+};
+
+/**
+ * The one instance of the stub server. */
+extern struct fake_odbc_s fake_odbc;
+
+/**
+ * Have the server restart right now. */
+extern void fake_odbc_restart(void);
+
+/**
+ * Return the oid a stub server would assign to SYM. */
+extern unsigned int fake_odbc_oid(const char *sym);
+
+#endif	/* INCLUDED_fakeodbc_h_ */
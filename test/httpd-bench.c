@@ -0,0 +1,546 @@
+/*** httpd-bench.c -- benchmark the http daemon
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Benchmarks for the http daemon, not run by make check.
+ *
+ *   httpd-bench conns [N [M]]
+ *     memory the server needs per idle connection, N connections with
+ *     one request each held open, and M connect/request/close cycles
+ *     for the cost of setting up and tearing down connections
+ *
+ *   httpd-bench gzip [NCLI [MB [SECS]]]
+ *     NCLI clients download MB megabytes of series data, gzipped,
+ *     over and over for SECS seconds while small requests are timed,
+ *     reports the latency of the small requests and the server's
+ *     cpu time per megabyte of raw data
+ *
+ * The server runs in a child with one worker, the client here. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "httpd.h"
+#include "nifty.h"
+
+static short unsigned int port;
+static pid_t srv;
+
+/* raw data of the big responses */
+static char *big;
+static size_t bigz;
+
+
+/* server side */
+static gand_httpd_res_t
+work(gand_httpd_req_t req)
+{
+	gand_gbuf_t gb;
+
+	if (strcmp(req.path, "/big")) {
+		return (gand_httpd_res_t){
+			.rc = 200U,
+			.ctyp = "text/plain",
+			.clen = 3U,
+			.rd = {DTYP_DATA, GAND_RES_DATA(data) = "ok\n"},
+		};
+	} else if ((gb = make_gand_gbuf(bigz)) == NULL) {
+		return (gand_httpd_res_t){.rc = 503U, .rd = {DTYP_NONE}};
+	}
+	gand_gbuf_write(gb, big, bigz);
+	return (gand_httpd_res_t){
+		.rc = 200U,
+		.ctyp = "text/plain",
+		.clen = CLEN_UNKNOWN,
+		.rd = {DTYP_GBUF, GAND_RES_DATA(gbuf) = gb},
+	};
+}
+
+static pid_t
+serve(void)
+{
+	gand_httpd_t h;
+	pid_t p;
+
+	switch ((p = fork())) {
+	case 0:
+		break;
+	default:
+		return p;
+	}
+#define make_gand_httpd(p...)	make_gand_httpd((gand_httpd_param_t){p})
+	h = make_gand_httpd(.port = port, .www_dir = ".", .workf = work);
+#undef make_gand_httpd
+	if (h == NULL) {
+		_exit(1);
+	}
+	gand_httpd_run(h);
+	free_gand_httpd(h);
+	_exit(0);
+}
+
+static void
+mk_big(size_t mb)
+{
+/* series-like lines, as compressible as the real thing */
+	unsigned int x = 1U;
+	size_t n = 0U;
+
+	bigz = mb << 20U;
+	if ((big = malloc(bigz + 64U)) == NULL) {
+		bigz = 0U;
+		return;
+	}
+	while (n < bigz) {
+		x = x * 1103515245U + 12345U;
+		n += snprintf(big + n, 64U,
+			      "2014-%02u-%02u\tSYM%u\tclose\t%u.%02u\n",
+			      1U + (x >> 8U) % 12U, 1U + (x >> 12U) % 28U,
+			      (x >> 16U) % 1000U,
+			      100U + (x >> 4U) % 50U, (x >> 20U) % 100U);
+	}
+	return;
+}
+
+
+/* client side */
+static long int
+now_us(void)
+{
+	struct timespec tsp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return tsp.tv_sec * 1000000L + tsp.tv_nsec / 1000L;
+}
+
+static size_t
+srv_rss(void)
+{
+/* resident set size of the server in bytes */
+	char fn[64U];
+	char ln[256U];
+	size_t rss = 0U;
+	FILE *f;
+
+	snprintf(fn, sizeof(fn), "/proc/%d/status", (int)srv);
+	if ((f = fopen(fn, "r")) == NULL) {
+		return 0U;
+	}
+	while (fgets(ln, sizeof(ln), f) != NULL) {
+		if (!strncmp(ln, "VmRSS:", 6U)) {
+			rss = strtoul(ln + 6U, NULL, 10) * 1024U;
+			break;
+		}
+	}
+	fclose(f);
+	return rss;
+}
+
+static long int
+srv_cpu(void)
+{
+/* user and system time of the server in milliseconds */
+	char fn[64U];
+	char ln[1024U];
+	unsigned long int ut = 0U, st = 0U;
+	const long int hz = sysconf(_SC_CLK_TCK);
+	const char *p;
+	FILE *f;
+
+	snprintf(fn, sizeof(fn), "/proc/%d/stat", (int)srv);
+	if ((f = fopen(fn, "r")) == NULL) {
+		return 0L;
+	} else if (fgets(ln, sizeof(ln), f) != NULL &&
+		   (p = strrchr(ln, ')')) != NULL) {
+		sscanf(p + 2U, "%*c %*d %*d %*d %*d %*d %*u "
+		       "%*u %*u %*u %*u %lu %lu", &ut, &st);
+	}
+	fclose(f);
+	return (long int)(ut + st) * 1000L / hz;
+}
+
+struct rd_s {
+	int fd;
+	size_t o;
+	size_t n;
+	char buf[16384U];
+};
+
+static int
+xconn(struct rd_s *r)
+{
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	const int one = 1;
+
+	/* the server might not be up yet */
+	for (size_t i = 0U; i < 200U; i++) {
+		if ((r->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+			return -1;
+		}
+		setsockopt(r->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (connect(r->fd, (void*)&sa, sizeof(sa)) == 0) {
+			r->o = r->n = 0U;
+			return 0;
+		}
+		close(r->fd);
+		usleep(10000);
+	}
+	return -1;
+}
+
+static void
+xclose(struct rd_s *r)
+{
+/* close without lingering in TIME_WAIT, we'd run out of ports */
+	const struct linger l = {1, 0};
+
+	setsockopt(r->fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+	close(r->fd);
+	return;
+}
+
+static const char*
+rd_upto(struct rd_s *r, const char *delim, size_t dz)
+{
+/* return what's buffered up to and including DELIM, reading as needed */
+	const char *p;
+	const char *eod;
+	ssize_t nrd;
+
+	while ((eod = memmem(p = r->buf + r->o, r->n - r->o, delim, dz)) == NULL) {
+		memmove(r->buf, r->buf + r->o, r->n -= r->o);
+		r->o = 0U;
+		if ((nrd = read(r->fd, r->buf + r->n,
+				sizeof(r->buf) - 1U - r->n)) <= 0) {
+			return NULL;
+		}
+		r->n += nrd;
+		r->buf[r->n] = '\0';
+	}
+	r->o = eod + dz - r->buf;
+	return p;
+}
+
+static int
+rd_skip(struct rd_s *r, size_t z)
+{
+/* consume Z bytes */
+	ssize_t nrd;
+
+	if (z <= r->n - r->o) {
+		r->o += z;
+		return 0;
+	}
+	z -= r->n - r->o;
+	r->o = r->n = 0U;
+	for (; z > 0U; z -= nrd) {
+		const size_t m = z < sizeof(r->buf) ? z : sizeof(r->buf);
+
+		if ((nrd = read(r->fd, r->buf, m)) <= 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static ssize_t
+xreq(struct rd_s *r, const char *req)
+{
+/* send REQ and read the whole response, return the body's size */
+	static const char cl[] = "\r\nContent-Length: ";
+	const char *hdr;
+	const char *eoh;
+	const char *p;
+	size_t body = 0U;
+
+	if (write(r->fd, req, strlen(req)) < 0) {
+		return -1;
+	} else if ((hdr = rd_upto(r, "\r\n\r\n", 4U)) == NULL) {
+		return -1;
+	}
+	eoh = r->buf + r->o;
+	if ((p = memmem(hdr, eoh - hdr, cl, sizeof(cl) - 1U)) != NULL) {
+		body = strtoul(p + sizeof(cl) - 1U, NULL, 10);
+		return rd_skip(r, body) < 0 ? -1 : (ssize_t)body;
+	}
+	/* chunked then */
+	for (size_t z;; body += z) {
+		if ((p = rd_upto(r, "\r\n", 2U)) == NULL) {
+			return -1;
+		} else if (!(z = strtoul(p, NULL, 16))) {
+			/* last chunk, there's no trailers */
+			break;
+		} else if (rd_skip(r, z + 2U) < 0) {
+			return -1;
+		}
+	}
+	return rd_upto(r, "\r\n", 2U) ? (ssize_t)body : -1;
+}
+
+static int
+bench_conns(size_t n, size_t m)
+{
+	static const char req[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\
+Accept: */*\r\n\r\n";
+	struct rlimit lim;
+	size_t rss0, rss1;
+	long int t;
+	struct rd_s *rs;
+	struct rd_s r;
+
+	getrlimit(RLIMIT_NOFILE, &lim);
+	lim.rlim_cur = lim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &lim);
+	if (n + 64U > lim.rlim_cur) {
+		n = lim.rlim_cur - 64U;
+		fprintf(stderr, "limited to %zu connections\n", n);
+	}
+	if ((srv = serve()) < 0) {
+		return -1;
+	} else if ((rs = calloc(n, sizeof(*rs))) == NULL) {
+		return -1;
+	}
+
+	/* have the server settle first */
+	if (xconn(&r) < 0 || xreq(&r, req) < 0) {
+		return -1;
+	}
+	xclose(&r);
+	usleep(100000);
+	rss0 = srv_rss();
+	for (size_t i = 0U; i < n; i++) {
+		if (xconn(rs + i) < 0 || xreq(rs + i, req) < 0) {
+			perror("cannot connect");
+			return -1;
+		}
+	}
+	rss1 = srv_rss();
+	for (size_t i = 0U; i < n; i++) {
+		xclose(rs + i);
+	}
+	free(rs);
+	printf("idle connections\t%zu\tserver rss +%zu kB\t%zu bytes each\n",
+	       n, (rss1 - rss0) / 1024U, (rss1 - rss0) / n);
+
+	t = now_us();
+	for (size_t i = 0U; i < m; i++) {
+		if (xconn(&r) < 0 || xreq(&r, req) < 0) {
+			perror("cannot connect");
+			return -1;
+		}
+		xclose(&r);
+	}
+	t = now_us() - t;
+	printf("connection churn\t%zu\t%.1f us each\n",
+	       m, (double)t / (double)m);
+	return 0;
+}
+
+
+struct cli_s {
+	pthread_t thr;
+	size_t nrsp;
+	size_t nraw;
+	size_t ncmp;
+	int rc;
+};
+
+static volatile bool stop;
+
+static void*
+cli_big(void *clo)
+{
+	static const char req[] = "GET /big HTTP/1.1\r\nHost: localhost\r\n\
+Accept-Encoding: gzip\r\n\r\n";
+	struct cli_s *c = clo;
+	struct rd_s *r;
+
+	if ((r = malloc(sizeof(*r))) == NULL || xconn(r) < 0) {
+		c->rc = -1;
+		return NULL;
+	}
+	while (!stop) {
+		ssize_t z;
+
+		if ((z = xreq(r, req)) < 0) {
+			c->rc = -1;
+			break;
+		}
+		c->nrsp++;
+		c->nraw += bigz;
+		c->ncmp += z;
+	}
+	xclose(r);
+	free(r);
+	return NULL;
+}
+
+static int
+lcmp(const void *x, const void *y)
+{
+	const long int *a = x;
+	const long int *b = y;
+	return (*a > *b) - (*a < *b);
+}
+
+static int
+bench_gzip(size_t ncli, size_t mb, unsigned int secs)
+{
+	static const char req[] = "GET /small HTTP/1.1\r\nHost: localhost\r\n\
+Accept: */*\r\n\r\n";
+	/* at most one small request every 10ms */
+	const size_t mlat = secs * 100U;
+	size_t nlat = 0U;
+	long int t0;
+	struct cli_s *cli;
+	size_t nraw = 0U, ncmp = 0U, nrsp = 0U;
+	long int *lat;
+	long int cpu;
+	struct rd_s r;
+	int rc = 0;
+
+	if (mk_big(mb), !bigz) {
+		return -1;
+	} else if ((srv = serve()) < 0) {
+		return -1;
+	} else if (xconn(&r) < 0 || xreq(&r, req) < 0) {
+		return -1;
+	} else if ((cli = calloc(ncli, sizeof(*cli))) == NULL) {
+		return -1;
+	} else if ((lat = calloc(mlat, sizeof(*lat))) == NULL) {
+		free(cli);
+		return -1;
+	}
+
+	cpu = srv_cpu();
+	for (size_t i = 0U; i < ncli; i++) {
+		pthread_create(&cli[i].thr, NULL, cli_big, cli + i);
+	}
+	t0 = now_us();
+	for (; nlat < mlat && now_us() - t0 < secs * 1000000L; nlat++) {
+		const long int t = now_us();
+
+		if (xreq(&r, req) < 0) {
+			rc = -1;
+			break;
+		}
+		lat[nlat] = now_us() - t;
+		if (lat[nlat] < 10000L) {
+			usleep(10000L - lat[nlat]);
+		}
+	}
+	stop = true;
+	for (size_t i = 0U; i < ncli; i++) {
+		pthread_join(cli[i].thr, NULL);
+		rc |= cli[i].rc;
+		nrsp += cli[i].nrsp;
+		nraw += cli[i].nraw;
+		ncmp += cli[i].ncmp;
+	}
+	cpu = srv_cpu() - cpu;
+	xclose(&r);
+
+	if (!nlat) {
+		free(lat);
+		free(cli);
+		return -1;
+	}
+	qsort(lat, nlat, sizeof(*lat), lcmp);
+	printf("big responses\t%zu\t%zu MB raw\t%zu MB sent\n",
+	       nrsp, nraw >> 20U, ncmp >> 20U);
+	printf("server cpu\t%ld ms\t%ld us per MB raw\n",
+	       cpu, nraw ? cpu * 1000L / (long int)(nraw >> 20U) : 0L);
+	printf("small requests\t%zu\tp50 %ld us\tp99 %ld us\tmax %ld us\n",
+	       nlat, lat[nlat / 2U], lat[nlat * 99U / 100U], lat[nlat - 1U]);
+	free(lat);
+	free(cli);
+	free(big);
+	return rc;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	int rc;
+
+	signal(SIGPIPE, SIG_IGN);
+	port = (short unsigned int)(20000 + getpid() % 20000);
+
+	if (argc > 1 && !strcmp(argv[1], "conns")) {
+		const size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 4096U;
+		const size_t m = argc > 3 ? strtoul(argv[3], NULL, 10) : 20000U;
+
+		rc = bench_conns(n ?: 1U, m ?: 1U);
+	} else if (argc > 1 && !strcmp(argv[1], "gzip")) {
+		const size_t ncli = argc > 2 ? strtoul(argv[2], NULL, 10) : 4U;
+		const size_t mb = argc > 3 ? strtoul(argv[3], NULL, 10) : 20U;
+		const unsigned int secs =
+			argc > 4 ? strtoul(argv[4], NULL, 10) : 10U;
+
+		rc = bench_gzip(ncli, mb ?: 1U, secs ?: 1U);
+	} else {
+		fputs("Usage: httpd-bench conns [N [M]]\n\
+       httpd-bench gzip [NCLI [MB [SECS]]]\n", stderr);
+		return 1;
+	}
+
+	if (srv > 0) {
+		kill(srv, SIGTERM);
+		waitpid(srv, NULL, 0);
+	}
+	return rc ? 1 : 0;
+}
+
+/* httpd-bench.c ends here */
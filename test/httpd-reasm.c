@@ -0,0 +1,390 @@
+/*** httpd-reasm.c -- request reassembly
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Have a server echo what it made of requests that arrive in bits and
+ * pieces: split at every byte, dribbled in byte by byte, or pipelined
+ * several at a time.  The server runs in a child, the client here. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "httpd.h"
+#include "nifty.h"
+
+struct conn_s {
+	int fd;
+	size_t n;
+	char buf[65536U];
+};
+
+static short unsigned int port;
+
+
+/* server side */
+static gand_httpd_res_t
+work(gand_httpd_req_t req)
+{
+/* echo verb, path, query and body */
+	gand_gbuf_t gb;
+	char hdr[256U];
+	int z;
+
+	if ((gb = make_gand_gbuf(256U)) == NULL) {
+		return (gand_httpd_res_t){.rc = 503U, .rd = {DTYP_NONE}};
+	}
+	z = snprintf(hdr, sizeof(hdr), "%u %s?%s %zu:",
+		     req.verb, req.path, req.query ?: "", req.data.len);
+	gand_gbuf_write(gb, hdr, z);
+	gand_gbuf_write(gb, req.data.str, req.data.len);
+	return (gand_httpd_res_t){
+		.rc = 200U,
+		.ctyp = "text/plain",
+		.clen = CLEN_UNKNOWN,
+		.rd = {DTYP_GBUF, GAND_RES_DATA(gbuf) = gb},
+	};
+}
+
+static pid_t
+serve(void)
+{
+	gand_httpd_t h;
+	pid_t p;
+
+	switch ((p = fork())) {
+	case 0:
+		break;
+	default:
+		return p;
+	}
+#define make_gand_httpd(p...)	make_gand_httpd((gand_httpd_param_t){p})
+	h = make_gand_httpd(.port = port, .www_dir = ".", .workf = work);
+#undef make_gand_httpd
+	if (h == NULL) {
+		_exit(77);
+	}
+	gand_httpd_run(h);
+	free_gand_httpd(h);
+	_exit(0);
+}
+
+
+/* client side */
+static int
+xconn(struct conn_s *c)
+{
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	/* a request that's been lost shall fail the test, not hang it */
+	const struct timeval tmo = {5, 0};
+	const int one = 1;
+
+	/* the server might not be up yet */
+	for (size_t i = 0U; i < 200U; i++) {
+		if ((c->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+			return -1;
+		}
+		setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo));
+		if (connect(c->fd, (void*)&sa, sizeof(sa)) == 0) {
+			c->n = 0U;
+			return 0;
+		}
+		close(c->fd);
+		usleep(10000);
+	}
+	return -1;
+}
+
+static int
+xsend(struct conn_s *c, const char *s, size_t z)
+{
+	for (ssize_t nwr; z > 0U; s += nwr, z -= nwr) {
+		if ((nwr = write(c->fd, s, z)) <= 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+xsend_pause(struct conn_s *c, const char *s, size_t z)
+{
+/* send S and give the server time to read it on its own */
+	static const struct timespec pause = {0, 2000000L};
+
+	if (xsend(c, s, z) < 0) {
+		return -1;
+	}
+	nanosleep(&pause, NULL);
+	return 0;
+}
+
+static ssize_t
+xresp(struct conn_s *c, char *restrict body, size_t bsz)
+{
+/* read one response into BODY, return its length */
+	static const char cl[] = "\r\nContent-Length: ";
+	char *eoh, *p;
+	size_t hz, z;
+	ssize_t nrd;
+
+	while ((eoh = memmem(c->buf, c->n, "\r\n\r\n", 4U)) == NULL) {
+		if ((nrd = read(c->fd, c->buf + c->n,
+				sizeof(c->buf) - c->n)) <= 0) {
+			return -1;
+		}
+		c->n += nrd;
+	}
+	hz = eoh + 4U - c->buf;
+	if (memcmp(c->buf, "HTTP/1.1 200 ", 13U)) {
+		return -1;
+	} else if ((p = memmem(c->buf, hz, cl, sizeof(cl) - 1U)) == NULL) {
+		return -1;
+	}
+	z = strtoul(p + sizeof(cl) - 1U, NULL, 10);
+	while (c->n < hz + z) {
+		if ((nrd = read(c->fd, c->buf + c->n,
+				sizeof(c->buf) - c->n)) <= 0) {
+			return -1;
+		}
+		c->n += nrd;
+	}
+	if (z >= bsz) {
+		return -1;
+	}
+	memcpy(body, c->buf + hz, z);
+	body[z] = '\0';
+	memmove(c->buf, c->buf + hz + z, c->n -= hz + z);
+	return z;
+}
+
+static int
+xcheck(struct conn_s *c, const char *exp, const char *what, size_t k)
+{
+	char body[1024U];
+
+	if (xresp(c, body, sizeof(body)) < 0) {
+		fprintf(stderr, "%s, split at %zu: no response\n", what, k);
+		return -1;
+	} else if (strcmp(body, exp)) {
+		fprintf(stderr, "%s, split at %zu: got `%s' expected `%s'\n",
+			what, k, body, exp);
+		return -1;
+	}
+	return 0;
+}
+
+
+static const char get[] = "\
+GET /echo?x=1&y=22 HTTP/1.1\r\n\
+Host: localhost\r\n\
+Accept: */*\r\n\
+\r\n";
+static char get_exp[64U];
+
+static const char post[] = "\
+POST /echo HTTP/1.1\r\n\
+Host: localhost\r\n\
+Content-Type: application/x-www-form-urlencoded\r\n\
+Content-Length: 26\r\n\
+\r\n\
+sym=SYM1&sym=SYM2&sym=SYM3";
+static char post_exp[64U];
+
+static int
+test_split(
+	struct conn_s *c, const char *what,
+	const char *req, size_t z, const char *exp)
+{
+/* send REQ in two halves, split at every byte */
+	for (size_t k = 1U; k < z; k++) {
+		if (xsend_pause(c, req, k) < 0 ||
+		    xsend(c, req + k, z - k) < 0) {
+			return -1;
+		} else if (xcheck(c, exp, what, k) < 0) {
+			/* the connection's out of step now */
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+test_dribble(struct conn_s *c, const char *req, size_t z, const char *exp)
+{
+/* send REQ byte by byte */
+	for (size_t k = 0U; k < z; k++) {
+		if (xsend_pause(c, req + k, 1U) < 0) {
+			return -1;
+		}
+	}
+	return xcheck(c, exp, "dribble", z);
+}
+
+static int
+test_pipeline(struct conn_s *c, size_t n)
+{
+/* N alternating requests in one go, and again with the last one cut */
+	static char buf[32768U];
+	size_t z = 0U;
+
+	for (size_t i = 0U; i < n; i++) {
+		const char *r = i % 2U ? post : get;
+		const size_t rz = i % 2U ? sizeof(post) - 1U : sizeof(get) - 1U;
+
+		if (z + rz > sizeof(buf)) {
+			return -1;
+		}
+		memcpy(buf + z, r, rz);
+		z += rz;
+	}
+	if (xsend(c, buf, z) < 0) {
+		return -1;
+	}
+	for (size_t i = 0U; i < n; i++) {
+		if (xcheck(c, i % 2U ? post_exp : get_exp, "pipeline", i) < 0) {
+			return -1;
+		}
+	}
+	if (xsend_pause(c, buf, z - 7U) < 0 || xsend(c, buf + z - 7U, 7U) < 0) {
+		return -1;
+	}
+	for (size_t i = 0U; i < n; i++) {
+		const char *exp = i % 2U ? post_exp : get_exp;
+
+		if (xcheck(c, exp, "pipeline cut", i) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+test_oversize(void)
+{
+/* headers beyond the limit get the connection closed */
+	struct conn_s c;
+	char buf[512U];
+	int rc = -1;
+
+	if (xconn(&c) < 0) {
+		return -1;
+	}
+	memset(buf, 'x', sizeof(buf));
+	memcpy(buf, "GET / HTTP/1.1\r\nX-Pad: ", 23U);
+	for (size_t i = 0U; i < 32U; i++) {
+		if (xsend(&c, buf, sizeof(buf)) < 0) {
+			/* closed on us already */
+			rc = 0;
+			break;
+		}
+	}
+	if (rc < 0 && read(c.fd, buf, sizeof(buf)) <= 0) {
+		rc = 0;
+	}
+	close(c.fd);
+	if (rc < 0) {
+		fputs("oversized headers: connection still open\n", stderr);
+	}
+	return rc;
+}
+
+
+int
+main(void)
+{
+	struct conn_s c;
+	pid_t srv;
+	int st;
+	int rc = 0;
+
+	signal(SIGPIPE, SIG_IGN);
+	port = (short unsigned int)(20000 + getpid() % 20000);
+	snprintf(get_exp, sizeof(get_exp), "%u /echo?x=1&y=22 0:", VERB_GET);
+	snprintf(post_exp, sizeof(post_exp),
+		 "%u /echo? 26:sym=SYM1&sym=SYM2&sym=SYM3", VERB_POST);
+
+	if ((srv = serve()) < 0) {
+		perror("cannot fork server");
+		return 1;
+	} else if (xconn(&c) < 0) {
+		perror("cannot connect to server");
+		rc = 1;
+		goto kill;
+	}
+
+	if (test_split(&c, "GET", get, sizeof(get) - 1U, get_exp) < 0 ||
+	    test_split(&c, "POST", post, sizeof(post) - 1U, post_exp) < 0 ||
+	    test_dribble(&c, post, sizeof(post) - 1U, post_exp) < 0 ||
+	    test_pipeline(&c, 2U) < 0 ||
+	    /* beyond the write queue's capacity */
+	    test_pipeline(&c, 100U) < 0) {
+		rc = 1;
+	}
+	close(c.fd);
+	if (test_oversize() < 0) {
+		rc = 1;
+	}
+
+kill:
+	kill(srv, SIGTERM);
+	if (waitpid(srv, &st, 0) < 0) {
+		rc = 1;
+	} else if (WIFEXITED(st) && WEXITSTATUS(st) == 77) {
+		/* server didn't come up, skip */
+		return 77;
+	}
+	return rc;
+}
+
+/* httpd-reasm.c ends here */
@@ -0,0 +1,302 @@
+/*** httpd-strm.c -- many streams at once
+ *
+ * Copyright (C) 2014 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of gandalf.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+/***
+ * Have a server keep more streams open at once than it has pooled
+ * buffers, none of the streams is allowed to finish before the last
+ * one's been requested.  A few more streams never get going, the
+ * server is shut down with them parked and has to close their
+ * connections and free them.  The server runs in a child, the client
+ * here. */
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "httpd.h"
+#include "nifty.h"
+
+/* more than the 256 gbufs a worker pools */
+#define NSTRM	(300U)
+/* streams left parked at shutdown */
+#define NPARK	(4U)
+
+struct strm_s {
+	gand_strm_t s;
+	bool done;
+};
+
+static short unsigned int port;
+static struct strm_s strms[NSTRM + NPARK];
+static size_t nstrm;
+static size_t npark;
+static size_t nfin;
+
+
+/* server side */
+static ssize_t
+prod(void *clo, gand_gbuf_t gb)
+{
+	struct strm_s *x = clo;
+	char buf[64U];
+	int z;
+
+	if ((size_t)(x - strms) >= NSTRM) {
+		/* never going anywhere, pull the plug once all are here */
+		if (!x->done && (x->done = true, ++npark == NPARK)) {
+			raise(SIGTERM);
+		}
+		return GAND_STRM_AGAIN;
+	} else if (nstrm < NSTRM) {
+		/* wait for the others */
+		return GAND_STRM_AGAIN;
+	} else if (x->done) {
+		return 0;
+	}
+	z = snprintf(buf, sizeof(buf), "stream %zu", (size_t)(x - strms));
+	x->done = true;
+	return gand_gbuf_write(gb, buf, z);
+}
+
+static void
+fin(void *UNUSED(clo))
+{
+	nfin++;
+	return;
+}
+
+static gand_httpd_res_t
+work(gand_httpd_req_t UNUSED(req))
+{
+	struct strm_s *x;
+
+	if (nstrm >= NSTRM + NPARK) {
+		return (gand_httpd_res_t){.rc = 400U, .rd = {DTYP_NONE}};
+	}
+	x = strms + nstrm;
+	if ((x->s = make_gand_strm(prod, fin, x)) == NULL) {
+		return (gand_httpd_res_t){.rc = 503U, .rd = {DTYP_NONE}};
+	} else if (++nstrm == NSTRM) {
+		/* that's all of them, let them go */
+		for (size_t i = 0U; i < NSTRM - 1U; i++) {
+			gand_strm_wake(strms[i].s);
+		}
+	}
+	return (gand_httpd_res_t){
+		.rc = 200U,
+		.ctyp = "text/plain",
+		.rd = {DTYP_STRM, GAND_RES_DATA(strm) = x->s},
+	};
+}
+
+static pid_t
+serve(void)
+{
+	gand_httpd_t h;
+	pid_t p;
+	int rc;
+
+	switch ((p = fork())) {
+	case 0:
+		break;
+	default:
+		return p;
+	}
+#define make_gand_httpd(p...)	make_gand_httpd((gand_httpd_param_t){p})
+	h = make_gand_httpd(.port = port, .www_dir = ".", .workf = work);
+#undef make_gand_httpd
+	if (h == NULL) {
+		_exit(77);
+	}
+	gand_httpd_run(h);
+	/* every stream is done with and every connection gone */
+	rc = nfin != NSTRM + NPARK || gand_httpd_nconns(h, NULL);
+	if (rc) {
+		fprintf(stderr, "%zu streams left, %zu connections\n",
+			NSTRM + NPARK - nfin, gand_httpd_nconns(h, NULL));
+	}
+	free_gand_httpd(h);
+	_exit(rc);
+}
+
+
+/* client side */
+static int
+xconn(void)
+{
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	/* a stream that's been lost shall fail the test, not hang it */
+	const struct timeval tmo = {5, 0};
+	int fd;
+
+	/* the server might not be up yet */
+	for (size_t i = 0U; i < 200U; i++) {
+		if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+			return -1;
+		}
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo));
+		if (connect(fd, (void*)&sa, sizeof(sa)) == 0) {
+			return fd;
+		}
+		close(fd);
+		usleep(10000);
+	}
+	return -1;
+}
+
+static long int
+xresp(int fd)
+{
+/* read a whole chunked response, return the number of its stream */
+	char buf[4096U];
+	size_t n = 0U;
+	ssize_t nrd;
+	const char *p;
+
+	do {
+		if ((nrd = read(fd, buf + n, sizeof(buf) - 1U - n)) <= 0) {
+			fputs("incomplete response\n", stderr);
+			return -1;
+		}
+		buf[n += nrd] = '\0';
+	} while (strstr(buf, "\r\n0\r\n\r\n") == NULL &&
+		 strncmp(buf, "HTTP/1.1 200 ", 13U) == 0);
+	if (strncmp(buf, "HTTP/1.1 200 ", 13U)) {
+		fprintf(stderr, "got %.12s\n", buf);
+		return -1;
+	} else if ((p = strstr(buf, "\r\nstream ")) == NULL) {
+		fputs("wrong data\n", stderr);
+		return -1;
+	}
+	return strtol(p + 9U, NULL, 10);
+}
+
+
+int
+main(void)
+{
+	static const char req[] = "GET /strm HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	static int fds[NSTRM + NPARK];
+	static bool seen[NSTRM];
+	pid_t srv;
+	int st;
+	int rc = 0;
+
+	signal(SIGPIPE, SIG_IGN);
+	port = (short unsigned int)(20000 + getpid() % 20000);
+
+	if ((srv = serve()) < 0) {
+		perror("cannot fork server");
+		return 1;
+	}
+	for (size_t i = 0U; i < NSTRM; i++) {
+		if ((fds[i] = xconn()) < 0) {
+			perror("cannot connect to server");
+			rc = 1;
+			goto kill;
+		} else if (write(fds[i], req, sizeof(req) - 1U) < 0) {
+			perror("cannot send request");
+			rc = 1;
+			goto kill;
+		}
+	}
+	/* every stream must have come through exactly once */
+	for (size_t i = 0U; i < NSTRM; i++) {
+		const long int k = xresp(fds[i]);
+
+		if (k < 0 || (size_t)k >= NSTRM || seen[k]) {
+			rc = 1;
+		} else {
+			seen[k] = true;
+		}
+		close(fds[i]);
+	}
+	/* these park, then the server goes down and must hang up on us */
+	for (size_t i = NSTRM; i < NSTRM + NPARK; i++) {
+		if ((fds[i] = xconn()) < 0) {
+			perror("cannot connect to server");
+			rc = 1;
+			goto kill;
+		} else if (write(fds[i], req, sizeof(req) - 1U) < 0) {
+			perror("cannot send request");
+			rc = 1;
+			goto kill;
+		}
+	}
+	for (size_t i = NSTRM; i < NSTRM + NPARK; i++) {
+		char buf[4096U];
+		ssize_t nrd;
+
+		while ((nrd = read(fds[i], buf, sizeof(buf))) > 0);
+		if (nrd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			fputs("parked stream's connection left open\n", stderr);
+			rc = 1;
+			goto kill;
+		}
+		close(fds[i]);
+	}
+	goto wait;
+
+kill:
+	kill(srv, SIGTERM);
+wait:
+	if (waitpid(srv, &st, 0) < 0) {
+		rc = 1;
+	} else if (WIFEXITED(st) && WEXITSTATUS(st) == 77) {
+		/* server didn't come up, skip */
+		return 77;
+	} else if (!WIFEXITED(st) || WEXITSTATUS(st)) {
+		rc = 1;
+	}
+	return rc;
+}
+
+/* httpd-strm.c ends here */